@@ -0,0 +1,149 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include "harness.h"
+
+#include "corpus.capnp.h"
+
+#include <capnp/message.h>
+#include <capnp/serialize.h>
+
+namespace {
+
+    namespace cp = hope::bench::cp;
+
+    void build(cp::SmallRecord::Builder out, const hope::bench::small_record& value) {
+        out.setId(value.id);
+        out.setKind(value.kind);
+        out.setDelta(value.delta);
+        out.setPrice(value.price);
+        out.setFlags(value.flags);
+        out.setActive(value.active);
+    }
+
+    void build(cp::TreeNode::Builder out, const hope::bench::tree_node& value) {
+        out.setValue(value.value);
+        out.setLabel(value.label);
+        auto children = out.initChildren(static_cast<unsigned>(value.children.size()));
+        for (unsigned i = 0; i < value.children.size(); ++i) {
+            build(children[i], value.children[i]);
+        }
+    }
+
+    void build(cp::StringRecord::Builder out, const hope::bench::string_record& value) {
+        out.setName(value.name);
+        out.setEmail(value.email);
+        out.setAddress(value.address);
+        out.setDescription(value.description);
+        auto tags = out.initTags(static_cast<unsigned>(value.tags.size()));
+        for (unsigned i = 0; i < value.tags.size(); ++i) {
+            tags.set(i, value.tags[i]);
+        }
+    }
+
+    template <typename List, typename T>
+    void build_list(List list, const std::vector<T>& values) {
+        for (unsigned i = 0; i < values.size(); ++i) {
+            list.set(i, values[i]);
+        }
+    }
+
+    void build(cp::NumericBlock::Builder out, const hope::bench::numeric_block& value) {
+        build_list(out.initSamples(static_cast<unsigned>(value.samples.size())), value.samples);
+        build_list(out.initIds(static_cast<unsigned>(value.ids.size())), value.ids);
+        build_list(out.initTimestamps(static_cast<unsigned>(value.timestamps.size())), value.timestamps);
+    }
+
+    template <typename T, typename List>
+    void unpack_list(List list, std::vector<T>& out) {
+        out.assign(list.begin(), list.end());
+    }
+
+    void unpack(cp::SmallRecord::Reader in, hope::bench::small_record& out) {
+        out = { in.getId(), in.getKind(), in.getDelta(), in.getPrice(), in.getFlags(), in.getActive() };
+    }
+
+    void unpack(cp::TreeNode::Reader in, hope::bench::tree_node& out) {
+        out.value = in.getValue();
+        out.label.assign(in.getLabel().cStr(), in.getLabel().size());
+        auto children = in.getChildren();
+        out.children.resize(children.size());
+        for (unsigned i = 0; i < children.size(); ++i) {
+            unpack(children[i], out.children[i]);
+        }
+    }
+
+    void unpack(cp::StringRecord::Reader in, hope::bench::string_record& out) {
+        out.name.assign(in.getName().cStr(), in.getName().size());
+        out.email.assign(in.getEmail().cStr(), in.getEmail().size());
+        out.address.assign(in.getAddress().cStr(), in.getAddress().size());
+        out.description.assign(in.getDescription().cStr(), in.getDescription().size());
+        auto tags = in.getTags();
+        out.tags.resize(tags.size());
+        for (unsigned i = 0; i < tags.size(); ++i) {
+            out.tags[i].assign(tags[i].cStr(), tags[i].size());
+        }
+    }
+
+    void unpack(cp::NumericBlock::Reader in, hope::bench::numeric_block& out) {
+        unpack_list(in.getSamples(), out.samples);
+        unpack_list(in.getIds(), out.ids);
+        unpack_list(in.getTimestamps(), out.timestamps);
+    }
+
+    template <typename Schema>
+    struct message_for;
+
+    template <>
+    struct message_for<hope::bench::small_record> {
+        using type = cp::SmallRecord;
+    };
+
+    template <>
+    struct message_for<hope::bench::tree_node> {
+        using type = cp::TreeNode;
+    };
+
+    template <>
+    struct message_for<hope::bench::string_record> {
+        using type = cp::StringRecord;
+    };
+
+    template <>
+    struct message_for<hope::bench::numeric_block> {
+        using type = cp::NumericBlock;
+    };
+
+    /**
+     * Encoding builds a fresh message and flattens it into one segment array; decoding reads the flat
+     * array in place and copies into the plain struct.
+     */
+    template <typename Schema>
+    struct capnp_codec final {
+        using object_type = Schema;
+        using buffer_type = kj::Array<::capnp::word>;
+        using message_type = typename message_for<Schema>::type;
+
+        static object_type make(const Schema& value) { return value; }
+
+        static void encode(const object_type& value, buffer_type& buffer) {
+            ::capnp::MallocMessageBuilder message;
+            build(message.initRoot<message_type>(), value);
+            buffer = ::capnp::messageToFlatArray(message);
+        }
+
+        static std::span<const std::uint8_t> bytes(const buffer_type& buffer) {
+            return { reinterpret_cast<const std::uint8_t*>(buffer.begin()), buffer.size() * sizeof(::capnp::word) };
+        }
+
+        static void decode(std::span<const std::uint8_t> bytes, object_type& value) {
+            ::capnp::FlatArrayMessageReader message(kj::ArrayPtr<const ::capnp::word>(
+                reinterpret_cast<const ::capnp::word*>(bytes.data()), bytes.size() / sizeof(::capnp::word)));
+            unpack(message.getRoot<message_type>(), value);
+        }
+    };
+
+    [[maybe_unused]] const bool registered = hope::bench::register_codec<capnp_codec>("capnproto");
+
+}
@@ -0,0 +1,87 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include "harness.h"
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <tuple>
+#include <vector>
+
+namespace hope::bench {
+
+    template <typename Archive, typename Record>
+        requires requires(Record& record) { Record::fields(record); }
+    void serialize(Archive& archive, Record& record) {
+        std::apply([&](auto&... field) { archive(field...); }, Record::fields(record));
+    }
+
+}
+
+namespace {
+
+    /**
+     * cereal only talks to iostreams; these stream buffers keep the archive on a reusable vector and on
+     * the encoded bytes so stringstream allocations are not billed to the library.
+     */
+    class vector_streambuf final : public std::streambuf {
+    public:
+        std::vector<char> data;
+
+    protected:
+        std::streamsize xsputn(const char* bytes, std::streamsize size) override {
+            data.insert(data.end(), bytes, bytes + size);
+            return size;
+        }
+
+        int_type overflow(int_type c) override {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                data.push_back(traits_type::to_char_type(c));
+            }
+            return traits_type::not_eof(c);
+        }
+    };
+
+    class span_streambuf final : public std::streambuf {
+    public:
+        explicit span_streambuf(std::span<const std::uint8_t> bytes) {
+            auto* begin = const_cast<char*>(reinterpret_cast<const char*>(bytes.data()));
+            setg(begin, begin, begin + bytes.size());
+        }
+    };
+
+    template <typename Schema>
+    struct cereal_codec final {
+        using object_type = Schema;
+        using buffer_type = vector_streambuf;
+
+        static object_type make(const Schema& value) { return value; }
+
+        static void encode(const object_type& value, buffer_type& buffer) {
+            buffer.data.clear();
+            std::ostream stream(&buffer);
+            cereal::BinaryOutputArchive archive(stream);
+            archive(value);
+        }
+
+        static std::span<const std::uint8_t> bytes(const buffer_type& buffer) {
+            return { reinterpret_cast<const std::uint8_t*>(buffer.data.data()), buffer.data.size() };
+        }
+
+        static void decode(std::span<const std::uint8_t> bytes, object_type& value) {
+            span_streambuf buffer(bytes);
+            std::istream stream(&buffer);
+            cereal::BinaryInputArchive archive(stream);
+            archive(value);
+        }
+    };
+
+    [[maybe_unused]] const bool registered = hope::bench::register_codec<cereal_codec>("cereal");
+
+}
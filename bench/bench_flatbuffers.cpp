@@ -0,0 +1,136 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include "harness.h"
+
+#include "corpus_generated.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    namespace fb = hope::bench::fb;
+
+    flatbuffers::Offset<fb::SmallRecord> build(flatbuffers::FlatBufferBuilder& builder, const hope::bench::small_record& value) {
+        return fb::CreateSmallRecord(builder, value.id, value.kind, value.delta, value.price, value.flags, value.active);
+    }
+
+    flatbuffers::Offset<fb::TreeNode> build(flatbuffers::FlatBufferBuilder& builder, const hope::bench::tree_node& value) {
+        std::vector<flatbuffers::Offset<fb::TreeNode>> children;
+        children.reserve(value.children.size());
+        for (const auto& child : value.children) {
+            children.push_back(build(builder, child));
+        }
+        const auto label = builder.CreateString(value.label);
+        return fb::CreateTreeNode(builder, value.value, label, builder.CreateVector(children));
+    }
+
+    flatbuffers::Offset<fb::StringRecord> build(flatbuffers::FlatBufferBuilder& builder, const hope::bench::string_record& value) {
+        const auto name = builder.CreateString(value.name);
+        const auto email = builder.CreateString(value.email);
+        const auto address = builder.CreateString(value.address);
+        const auto description = builder.CreateString(value.description);
+        const auto tags = builder.CreateVectorOfStrings(value.tags);
+        return fb::CreateStringRecord(builder, name, email, address, description, tags);
+    }
+
+    flatbuffers::Offset<fb::NumericBlock> build(flatbuffers::FlatBufferBuilder& builder, const hope::bench::numeric_block& value) {
+        const auto samples = builder.CreateVector(value.samples);
+        const auto ids = builder.CreateVector(value.ids);
+        const auto timestamps = builder.CreateVector(value.timestamps);
+        return fb::CreateNumericBlock(builder, samples, ids, timestamps);
+    }
+
+    template <typename Schema>
+    struct table_for;
+
+    template <>
+    struct table_for<hope::bench::small_record> {
+        using type = fb::SmallRecord;
+    };
+
+    template <>
+    struct table_for<hope::bench::tree_node> {
+        using type = fb::TreeNode;
+    };
+
+    template <>
+    struct table_for<hope::bench::string_record> {
+        using type = fb::StringRecord;
+    };
+
+    template <>
+    struct table_for<hope::bench::numeric_block> {
+        using type = fb::NumericBlock;
+    };
+
+    template <typename T, typename Vector>
+    void assign(std::vector<T>& out, const Vector* in) {
+        out.assign(in->begin(), in->end());
+    }
+
+    void unpack(const fb::SmallRecord& in, hope::bench::small_record& out) {
+        out = { in.id(), in.kind(), in.delta(), in.price(), in.flags(), in.active() };
+    }
+
+    void unpack(const fb::TreeNode& in, hope::bench::tree_node& out) {
+        out.value = in.value();
+        out.label.assign(in.label()->c_str(), in.label()->size());
+        out.children.resize(in.children()->size());
+        for (flatbuffers::uoffset_t i = 0; i < in.children()->size(); ++i) {
+            unpack(*in.children()->Get(i), out.children[i]);
+        }
+    }
+
+    void unpack(const fb::StringRecord& in, hope::bench::string_record& out) {
+        out.name.assign(in.name()->c_str(), in.name()->size());
+        out.email.assign(in.email()->c_str(), in.email()->size());
+        out.address.assign(in.address()->c_str(), in.address()->size());
+        out.description.assign(in.description()->c_str(), in.description()->size());
+        out.tags.resize(in.tags()->size());
+        for (flatbuffers::uoffset_t i = 0; i < in.tags()->size(); ++i) {
+            out.tags[i].assign(in.tags()->Get(i)->c_str(), in.tags()->Get(i)->size());
+        }
+    }
+
+    void unpack(const fb::NumericBlock& in, hope::bench::numeric_block& out) {
+        assign(out.samples, in.samples());
+        assign(out.ids, in.ids());
+        assign(out.timestamps, in.timestamps());
+    }
+
+    /**
+     * Decoding verifies the buffer and copies it into the plain struct, the same work every other codec
+     * does; reading fields straight from the buffer is what the lazy accessors are compared against.
+     */
+    template <typename Schema>
+    struct flatbuffers_codec final {
+        using object_type = Schema;
+        using buffer_type = flatbuffers::FlatBufferBuilder;
+
+        static object_type make(const Schema& value) { return value; }
+
+        static void encode(const object_type& value, buffer_type& builder) {
+            builder.Clear();
+            builder.Finish(build(builder, value));
+        }
+
+        static std::span<const std::uint8_t> bytes(const buffer_type& builder) {
+            return { builder.GetBufferPointer(), builder.GetSize() };
+        }
+
+        static void decode(std::span<const std::uint8_t> bytes, object_type& value) {
+            using table = typename table_for<Schema>::type;
+            flatbuffers::Verifier verifier(bytes.data(), bytes.size());
+            if (!verifier.VerifyBuffer<table>(nullptr)) {
+                throw std::runtime_error("flatbuffers: verification failed");
+            }
+            unpack(*flatbuffers::GetRoot<table>(bytes.data()), value);
+        }
+    };
+
+    [[maybe_unused]] const bool registered = hope::bench::register_codec<flatbuffers_codec>("flatbuffers");
+
+}
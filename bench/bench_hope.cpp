@@ -0,0 +1,39 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include "harness.h"
+
+#include "hope/serialization/serialization.h"
+
+namespace {
+
+    namespace hs = hope::serialization;
+
+    template <hs::format Format>
+    struct hope_codec final {
+        template <typename Schema>
+        struct type final {
+            using object_type = Schema;
+            using buffer_type = hs::output_buffer;
+
+            static object_type make(const Schema& value) { return value; }
+
+            static void encode(const object_type& value, buffer_type& buffer) {
+                buffer.clear();
+                hs::writer<hs::output_buffer, Format>(buffer).write(value);
+            }
+
+            static std::span<const std::uint8_t> bytes(const buffer_type& buffer) { return buffer.view(); }
+
+            static void decode(std::span<const std::uint8_t> bytes, object_type& value) {
+                hs::input_buffer input(bytes);
+                hs::reader<hs::input_buffer, Format>(input).read(value);
+            }
+        };
+    };
+
+    [[maybe_unused]] const bool fixed_registered = hope::bench::register_codec<hope_codec<hs::fixed_format>::type>("hope_fixed");
+    [[maybe_unused]] const bool varint_registered = hope::bench::register_codec<hope_codec<hs::varint_format>::type>("hope_varint");
+
+}
@@ -0,0 +1,81 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include "harness.h"
+
+#include <msgpack.hpp>
+
+#include <tuple>
+
+namespace hope::bench {
+
+    template <typename Record>
+    concept corpus_record = requires(Record& record) { Record::fields(record); };
+
+}
+
+namespace msgpack {
+MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
+namespace adaptor {
+
+    /**
+     * Records are packed as msgpack arrays of their fields, the layout MSGPACK_DEFINE would produce.
+     */
+    template <hope::bench::corpus_record Record>
+    struct pack<Record> {
+        template <typename Stream>
+        packer<Stream>& operator()(packer<Stream>& out, const Record& record) const {
+            const auto fields = Record::fields(record);
+            out.pack_array(std::tuple_size_v<decltype(fields)>);
+            std::apply([&](const auto&... field) { (out.pack(field), ...); }, fields);
+            return out;
+        }
+    };
+
+    template <hope::bench::corpus_record Record>
+    struct convert<Record> {
+        const msgpack::object& operator()(const msgpack::object& in, Record& record) const {
+            auto fields = Record::fields(record);
+            if (in.type != msgpack::type::ARRAY || in.via.array.size != std::tuple_size_v<decltype(fields)>) {
+                throw msgpack::type_error();
+            }
+            std::apply([&](auto&... field) {
+                std::size_t index = 0;
+                (in.via.array.ptr[index++].convert(field), ...);
+            }, fields);
+            return in;
+        }
+    };
+
+}
+}
+}
+
+namespace {
+
+    template <typename Schema>
+    struct msgpack_codec final {
+        using object_type = Schema;
+        using buffer_type = msgpack::sbuffer;
+
+        static object_type make(const Schema& value) { return value; }
+
+        static void encode(const object_type& value, buffer_type& buffer) {
+            buffer.clear();
+            msgpack::pack(buffer, value);
+        }
+
+        static std::span<const std::uint8_t> bytes(const buffer_type& buffer) {
+            return { reinterpret_cast<const std::uint8_t*>(buffer.data()), buffer.size() };
+        }
+
+        static void decode(std::span<const std::uint8_t> bytes, object_type& value) {
+            const auto handle = msgpack::unpack(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            handle.get().convert(value);
+        }
+    };
+
+    [[maybe_unused]] const bool registered = hope::bench::register_codec<msgpack_codec>("msgpack");
+
+}
@@ -0,0 +1,89 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include "harness.h"
+
+#include "corpus.pb.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    namespace pb = hope::bench::pb;
+
+    pb::SmallRecord to_message(const hope::bench::small_record& value) {
+        pb::SmallRecord message;
+        message.set_id(value.id);
+        message.set_kind(value.kind);
+        message.set_delta(value.delta);
+        message.set_price(value.price);
+        message.set_flags(value.flags);
+        message.set_active(value.active);
+        return message;
+    }
+
+    void fill(const hope::bench::tree_node& value, pb::TreeNode& message) {
+        message.set_value(value.value);
+        message.set_label(value.label);
+        for (const auto& child : value.children) {
+            fill(child, *message.add_children());
+        }
+    }
+
+    pb::TreeNode to_message(const hope::bench::tree_node& value) {
+        pb::TreeNode message;
+        fill(value, message);
+        return message;
+    }
+
+    pb::StringRecord to_message(const hope::bench::string_record& value) {
+        pb::StringRecord message;
+        message.set_name(value.name);
+        message.set_email(value.email);
+        message.set_address(value.address);
+        message.set_description(value.description);
+        for (const auto& tag : value.tags) {
+            message.add_tags(tag);
+        }
+        return message;
+    }
+
+    pb::NumericBlock to_message(const hope::bench::numeric_block& value) {
+        pb::NumericBlock message;
+        message.mutable_samples()->Assign(value.samples.begin(), value.samples.end());
+        message.mutable_ids()->Assign(value.ids.begin(), value.ids.end());
+        message.mutable_timestamps()->Assign(value.timestamps.begin(), value.timestamps.end());
+        return message;
+    }
+
+    /**
+     * Decodes into the generated message, protobuf's own object model; the message is reused so its
+     * repeated fields and strings keep their capacity between iterations.
+     */
+    template <typename Schema>
+    struct protobuf_codec final {
+        using object_type = decltype(to_message(std::declval<const Schema&>()));
+        using buffer_type = std::string;
+
+        static object_type make(const Schema& value) { return to_message(value); }
+
+        static void encode(const object_type& message, buffer_type& buffer) {
+            message.SerializeToString(&buffer);
+        }
+
+        static std::span<const std::uint8_t> bytes(const buffer_type& buffer) {
+            return { reinterpret_cast<const std::uint8_t*>(buffer.data()), buffer.size() };
+        }
+
+        static void decode(std::span<const std::uint8_t> bytes, object_type& message) {
+            if (!message.ParseFromArray(bytes.data(), static_cast<int>(bytes.size()))) {
+                throw std::runtime_error("protobuf: parse failed");
+            }
+        }
+    };
+
+    [[maybe_unused]] const bool registered = hope::bench::register_codec<protobuf_codec>("protobuf");
+
+}
@@ -0,0 +1,127 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * Fixed corpus shared by every codec. Values are generated from a fixed seed so encoded sizes are
+ * comparable between runs and between libraries. hope-serialization reflects the structs directly;
+ * fields() lists the members for libraries that need them spelled out.
+ */
+namespace hope::bench {
+
+    struct small_record final {
+        std::uint64_t id;
+        std::uint32_t kind;
+        std::int32_t delta;
+        double price;
+        std::uint32_t flags;
+        bool active;
+
+        static constexpr const char* schema = "small_flat";
+
+        template <typename Self>
+        static auto fields(Self& self) {
+            return std::tie(self.id, self.kind, self.delta, self.price, self.flags, self.active);
+        }
+
+        static small_record make() {
+            return { 1'234'567, 3, -42, 101.25, 0x11, true };
+        }
+    };
+
+    struct tree_node final {
+        std::uint32_t value;
+        std::string label;
+        std::vector<tree_node> children;
+
+        static constexpr const char* schema = "deep_nesting";
+
+        template <typename Self>
+        static auto fields(Self& self) {
+            return std::tie(self.value, self.label, self.children);
+        }
+
+        static tree_node make() {
+            std::uint32_t counter = 0;
+            return make(counter, 7);
+        }
+
+    private:
+        static tree_node make(std::uint32_t& counter, int depth) {
+            tree_node node{ counter++, "node" + std::to_string(counter), {} };
+            if (depth > 0) {
+                for (int i = 0; i < 2; ++i) {
+                    node.children.push_back(make(counter, depth - 1));
+                }
+            }
+            return node;
+        }
+    };
+
+    struct string_record final {
+        std::string name;
+        std::string email;
+        std::string address;
+        std::string description;
+        std::vector<std::string> tags;
+
+        static constexpr const char* schema = "string_heavy";
+
+        template <typename Self>
+        static auto fields(Self& self) {
+            return std::tie(self.name, self.email, self.address, self.description, self.tags);
+        }
+
+        static string_record make() {
+            std::mt19937 random(7);
+            auto text = [&](std::size_t size) {
+                std::string value(size, ' ');
+                for (auto& c : value) {
+                    c = static_cast<char>('a' + random() % 26);
+                }
+                return value;
+            };
+            string_record record{ text(24), text(32), text(96), text(480), {} };
+            for (int i = 0; i < 16; ++i) {
+                record.tags.push_back(text(8 + random() % 16));
+            }
+            return record;
+        }
+    };
+
+    struct numeric_block final {
+        std::vector<double> samples;
+        std::vector<std::uint32_t> ids;
+        std::vector<std::int64_t> timestamps;
+
+        static constexpr const char* schema = "numeric_arrays";
+
+        template <typename Self>
+        static auto fields(Self& self) {
+            return std::tie(self.samples, self.ids, self.timestamps);
+        }
+
+        static numeric_block make() {
+            std::mt19937_64 random(11);
+            numeric_block block;
+            constexpr std::size_t size = 16 * 1024;
+            std::int64_t timestamp = 1'700'000'000'000'000;
+            for (std::size_t i = 0; i < size; ++i) {
+                block.samples.push_back(static_cast<double>(random() % 100'000) / 100.0);
+                block.ids.push_back(static_cast<std::uint32_t>(random() % 50'000));
+                timestamp += static_cast<std::int64_t>(random() % 1'000);
+                block.timestamps.push_back(timestamp);
+            }
+            return block;
+        }
+    };
+
+}
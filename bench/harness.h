@@ -0,0 +1,90 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "corpus.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <tuple>
+
+namespace hope::bench {
+
+    /**
+     * Number of global operator new calls so far, counted by the replacement in main.cpp.
+     */
+    std::uint64_t allocation_count() noexcept;
+
+    using schemas = std::tuple<small_record, tree_node, string_record, numeric_block>;
+
+    /**
+     * Adapts one library to the corpus. Codec<Schema> provides
+     *     using object_type, buffer_type;
+     *     static object_type make(const Schema&);                          // outside the timed loop
+     *     static void encode(const object_type&, buffer_type&);
+     *     static std::span<const std::uint8_t> bytes(const buffer_type&);
+     *     static void decode(std::span<const std::uint8_t>, object_type&);
+     * Encoding and decoding reuse the same buffer/object across iterations, as a long-lived connection would.
+     */
+    template <template <typename> class Codec, typename Schema>
+    void encode_benchmark(benchmark::State& state) {
+        using codec = Codec<Schema>;
+        const auto object = codec::make(Schema::make());
+        typename codec::buffer_type buffer{};
+        codec::encode(object, buffer);
+        const std::size_t encoded_size = codec::bytes(buffer).size();
+
+        const auto allocations = allocation_count();
+        for (auto _ : state) {
+            codec::encode(object, buffer);
+            benchmark::DoNotOptimize(codec::bytes(buffer).data());
+            benchmark::ClobberMemory();
+        }
+        const auto iterations = static_cast<double>(state.iterations());
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(static_cast<std::int64_t>(encoded_size) * state.iterations());
+        state.counters["encoded_size"] = static_cast<double>(encoded_size);
+        state.counters["allocs_per_msg"] = static_cast<double>(allocation_count() - allocations) / iterations;
+    }
+
+    template <template <typename> class Codec, typename Schema>
+    void decode_benchmark(benchmark::State& state) {
+        using codec = Codec<Schema>;
+        const auto source = codec::make(Schema::make());
+        typename codec::buffer_type buffer{};
+        codec::encode(source, buffer);
+        const auto bytes = codec::bytes(buffer);
+        auto object = codec::make(Schema::make());
+
+        const auto allocations = allocation_count();
+        for (auto _ : state) {
+            codec::decode(bytes, object);
+            benchmark::DoNotOptimize(&object);
+            benchmark::ClobberMemory();
+        }
+        const auto iterations = static_cast<double>(state.iterations());
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(static_cast<std::int64_t>(bytes.size()) * state.iterations());
+        state.counters["encoded_size"] = static_cast<double>(bytes.size());
+        state.counters["allocs_per_msg"] = static_cast<double>(allocation_count() - allocations) / iterations;
+    }
+
+    /**
+     * Registers encode/<library>/<schema> and decode/<library>/<schema> for every schema of the corpus.
+     */
+    template <template <typename> class Codec>
+    bool register_codec(const std::string& library) {
+        std::apply([&]<typename... Schema>(const Schema&...) {
+            (benchmark::RegisterBenchmark(("encode/" + library + "/" + Schema::schema).c_str(), &encode_benchmark<Codec, Schema>), ...);
+            (benchmark::RegisterBenchmark(("decode/" + library + "/" + Schema::schema).c_str(), &decode_benchmark<Codec, Schema>), ...);
+        }, schemas{});
+        return true;
+    }
+
+}
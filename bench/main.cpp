@@ -0,0 +1,75 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include "harness.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+    std::atomic<std::uint64_t> allocations{ 0 };
+
+}
+
+std::uint64_t hope::bench::allocation_count() noexcept {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+/**
+ * Results go to hope_serialization_bench.json unless --benchmark_out is given explicitly.
+ */
+int main(int argc, char** argv) {
+    std::vector<char*> arguments(argv, argv + argc);
+    bool has_output = false;
+    for (int i = 1; i < argc; ++i) {
+        has_output = has_output || std::string_view(argv[i]).starts_with("--benchmark_out=");
+    }
+    char default_output[] = "--benchmark_out=hope_serialization_bench.json";
+    char default_format[] = "--benchmark_out_format=json";
+    if (!has_output) {
+        arguments.push_back(default_output);
+        arguments.push_back(default_format);
+    }
+    int count = static_cast<int>(arguments.size());
+    benchmark::Initialize(&count, arguments.data());
+    if (benchmark::ReportUnrecognizedArguments(count, arguments.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,331 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/byte_swap.h"
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/reader.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/writer.h"
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hope::serialization {
+
+    /**
+     * Archive file layout, all integers little endian:
+     *     header   "HOPA", revision, three zero bytes
+     *     records  encoded back to back, each starting at a multiple of archive_alignment
+     *     index    u64 end offset of every record; record i starts at the aligned end of record i - 1
+     *     trailer  u64 index offset, u64 record count, "HOPA", revision, three zero bytes
+     * The trailer sits at a fixed distance from the end of the file, so record i is found with two loads.
+     */
+    inline constexpr std::array<std::uint8_t, 4> archive_magic{ 'H', 'O', 'P', 'A' };
+    inline constexpr std::uint8_t archive_revision = 1;
+
+    /**
+     * Records are aligned so views of 8 byte elements into a mapped archive are aligned as well.
+     */
+    inline constexpr std::size_t archive_alignment = 8;
+
+    namespace detail {
+
+        inline constexpr std::size_t archive_header_size = 8;
+        inline constexpr std::size_t archive_trailer_size = 24;
+
+        /**
+         * Encoded records are collected in memory and written in chunks of about this size.
+         */
+        inline constexpr std::size_t archive_flush_size = std::size_t{ 1 } << 20;
+
+        [[nodiscard]] constexpr std::uint64_t align_record(std::uint64_t offset) noexcept {
+            return (offset + archive_alignment - 1) / archive_alignment * archive_alignment;
+        }
+
+        inline void store_u64(std::uint8_t* out, std::uint64_t value) noexcept {
+            value = little_endian(value);
+            std::memcpy(out, &value, sizeof(value));
+        }
+
+        [[nodiscard]] inline std::uint64_t load_u64(const std::uint8_t* in) noexcept {
+            std::uint64_t value;
+            std::memcpy(&value, in, sizeof(value));
+            return little_endian(value);
+        }
+
+        [[nodiscard]] inline std::array<std::uint8_t, 8> archive_signature() noexcept {
+            return { archive_magic[0], archive_magic[1], archive_magic[2], archive_magic[3], archive_revision, 0, 0, 0 };
+        }
+
+        [[noreturn]] inline void throw_file_error(const char* what, const std::string& path) {
+            throw error(std::string("hope::serialization: ") + what + " " + path + ": " + std::strerror(errno));
+        }
+
+    }
+
+    /**
+     * Appends records to an archive file and writes the index when finished.
+     *
+     *     hope::serialization::archive_writer archive("capture.hope");
+     *     for (const auto& message : messages) {
+     *         archive.append<hope::serialization::varint_format>(message);
+     *     }
+     *     archive.finish();
+     *
+     * The destructor finishes an archive that was not finished explicitly, swallowing errors; call finish()
+     * to see them.
+     */
+    class archive_writer final {
+    public:
+        explicit archive_writer(const std::string& path)
+            : path_(path)
+            , fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) {
+            if (fd_ < 0) {
+                detail::throw_file_error("cannot create", path_);
+            }
+            const auto header = detail::archive_signature();
+            buffer_.write(header.data(), header.size());
+        }
+
+        archive_writer(const archive_writer&) = delete;
+        archive_writer& operator=(const archive_writer&) = delete;
+
+        ~archive_writer() {
+            if (fd_ >= 0) {
+                try {
+                    finish();
+                } catch (...) {
+                    ::close(fd_);
+                }
+            }
+        }
+
+        /**
+         * Encodes value as the next record and returns its index.
+         */
+        template <format Format = format{}, typename T>
+        std::size_t append(const T& value) {
+            begin_record();
+            buffer_.reserve(buffer_.size() + serialized_size<Format>(value) + detail::max_prepare_size);
+            writer<output_buffer, Format>(buffer_).write(value);
+            return end_record();
+        }
+
+        /**
+         * Appends an already encoded record, e.g. a message taken from a frame.
+         */
+        std::size_t append_bytes(std::span<const std::uint8_t> record) {
+            begin_record();
+            buffer_.write(record.data(), record.size());
+            return end_record();
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept { return ends_.size(); }
+
+        /**
+         * Writes the remaining records, the index and the trailer, and closes the file.
+         */
+        void finish() {
+            if (fd_ < 0) {
+                return;
+            }
+            std::array<std::uint8_t, 8> entry;
+            for (const std::uint64_t end : ends_) {
+                detail::store_u64(entry.data(), end);
+                buffer_.write(entry.data(), entry.size());
+                flush_if_full();
+            }
+            std::array<std::uint8_t, detail::archive_trailer_size> trailer;
+            detail::store_u64(trailer.data(), index_offset_);
+            detail::store_u64(trailer.data() + 8, ends_.size());
+            const auto signature = detail::archive_signature();
+            std::memcpy(trailer.data() + 16, signature.data(), signature.size());
+            buffer_.write(trailer.data(), trailer.size());
+            flush();
+            if (::close(std::exchange(fd_, -1)) != 0) {
+                detail::throw_file_error("cannot close", path_);
+            }
+        }
+
+    private:
+        void begin_record() {
+            if (fd_ < 0) [[unlikely]] {
+                throw error("hope::serialization: archive is already finished");
+            }
+            static constexpr std::array<std::uint8_t, archive_alignment> zeros{};
+            const std::uint64_t start = detail::align_record(position_ + buffer_.size());
+            buffer_.write(zeros.data(), static_cast<std::size_t>(start - position_ - buffer_.size()));
+        }
+
+        std::size_t end_record() {
+            ends_.push_back(position_ + buffer_.size());
+            index_offset_ = ends_.back();
+            flush_if_full();
+            return ends_.size() - 1;
+        }
+
+        void flush_if_full() {
+            if (buffer_.size() >= detail::archive_flush_size) {
+                flush();
+            }
+        }
+
+        void flush() {
+            const std::uint8_t* data = buffer_.data();
+            std::size_t left = buffer_.size();
+            while (left != 0) {
+                const ::ssize_t written = ::write(fd_, data, left);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    detail::throw_file_error("cannot write", path_);
+                }
+                data += written;
+                left -= static_cast<std::size_t>(written);
+            }
+            position_ += buffer_.size();
+            buffer_.clear();
+        }
+
+        std::string path_;
+        int fd_;
+        output_buffer buffer_;
+        std::uint64_t position_{ 0 };
+        std::uint64_t index_offset_{ detail::archive_header_size };
+        std::vector<std::uint64_t> ends_;
+    };
+
+    /**
+     * Read-only memory mapping of an archive. Opening checks the header and trailer only; record i is
+     * located through the index in O(1) and decoded straight from the mapping, so string views, spans and
+     * array views read from it point into the file and nothing else of it is touched.
+     */
+    class mapped_archive final {
+    public:
+        explicit mapped_archive(const std::string& path) {
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                detail::throw_file_error("cannot open", path);
+            }
+            struct ::stat status;
+            if (::fstat(fd, &status) != 0) {
+                ::close(fd);
+                detail::throw_file_error("cannot stat", path);
+            }
+            size_ = static_cast<std::size_t>(status.st_size);
+            if (size_ < detail::archive_header_size + detail::archive_trailer_size) [[unlikely]] {
+                ::close(fd);
+                throw error("hope::serialization: " + path + " is not an archive");
+            }
+            void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED) {
+                detail::throw_file_error("cannot map", path);
+            }
+            data_ = static_cast<const std::uint8_t*>(mapping);
+            // lookups jump around; read-ahead would only pull in records nobody asked for
+            (void)::madvise(mapping, size_, MADV_RANDOM);
+            try {
+                validate();
+            } catch (...) {
+                ::munmap(mapping, size_);
+                throw;
+            }
+        }
+
+        mapped_archive(mapped_archive&& other) noexcept
+            : data_(std::exchange(other.data_, nullptr))
+            , size_(std::exchange(other.size_, 0))
+            , index_(std::exchange(other.index_, nullptr))
+            , count_(std::exchange(other.count_, 0)) {}
+
+        mapped_archive& operator=(mapped_archive other) noexcept {
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            std::swap(index_, other.index_);
+            std::swap(count_, other.count_);
+            return *this;
+        }
+
+        ~mapped_archive() {
+            if (data_ != nullptr) {
+                ::munmap(const_cast<std::uint8_t*>(data_), size_);
+            }
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept { return count_; }
+        [[nodiscard]] bool empty() const noexcept { return count_ == 0; }
+
+        /**
+         * Encoded bytes of record index, inside the mapping.
+         */
+        [[nodiscard]] std::span<const std::uint8_t> record(std::size_t index) const {
+            if (index >= count_) [[unlikely]] {
+                throw error("hope::serialization: archive record index out of range");
+            }
+            const std::uint64_t start = index == 0 ? detail::archive_header_size
+                                                   : detail::align_record(detail::load_u64(index_ + 8 * (index - 1)));
+            const std::uint64_t end = detail::load_u64(index_ + 8 * index);
+            if (start > end || end > static_cast<std::uint64_t>(index_ - data_)) [[unlikely]] {
+                throw error("hope::serialization: malformed archive index");
+            }
+            return { data_ + start, static_cast<std::size_t>(end - start) };
+        }
+
+        template <typename T, format Format = format{}>
+        [[nodiscard]] T read(std::size_t index, std::pmr::memory_resource* resource = nullptr) const {
+            input_buffer input(record(index));
+            return reader<input_buffer, Format>(input, resource).template read<T>();
+        }
+
+        template <format Format = format{}, typename T>
+        void read(std::size_t index, T& value, std::pmr::memory_resource* resource = nullptr) const {
+            input_buffer input(record(index));
+            reader<input_buffer, Format>(input, resource).read(value);
+        }
+
+    private:
+        void validate() {
+            const auto signature = detail::archive_signature();
+            const std::uint8_t* trailer = data_ + size_ - detail::archive_trailer_size;
+            if (std::memcmp(data_, signature.data(), signature.size()) != 0
+                || std::memcmp(trailer + 16, signature.data(), signature.size()) != 0) [[unlikely]] {
+                throw error("hope::serialization: not an archive or unsupported archive revision");
+            }
+            const std::uint64_t index_offset = detail::load_u64(trailer);
+            const std::uint64_t count = detail::load_u64(trailer + 8);
+            const std::uint64_t index_limit = size_ - detail::archive_trailer_size;
+            if (index_offset < detail::archive_header_size || index_offset > index_limit
+                || count != (index_limit - index_offset) / 8 || (index_limit - index_offset) % 8 != 0) [[unlikely]] {
+                throw error("hope::serialization: malformed archive trailer");
+            }
+            index_ = data_ + index_offset;
+            count_ = static_cast<std::size_t>(count);
+        }
+
+        const std::uint8_t* data_{ nullptr };
+        std::size_t size_{ 0 };
+        const std::uint8_t* index_{ nullptr };
+        std::size_t count_{ 0 };
+    };
+
+}
@@ -0,0 +1,118 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+
+namespace hope::serialization {
+
+    /**
+     * Bump allocator for decoded messages. Allocation is a pointer increment, deallocation does nothing and
+     * reset() drops everything at once. Unlike std::pmr::monotonic_buffer_resource, reset() keeps the memory:
+     * blocks allocated during a cycle are merged into one block sized for the whole cycle, so once warmed up
+     * a decode/reset loop never returns to the upstream resource.
+     */
+    class arena final : public std::pmr::memory_resource {
+    public:
+        explicit arena(std::size_t initial_size = 4096,
+            std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) noexcept
+            : upstream_(upstream)
+            , next_size_(std::max(initial_size, std::size_t{ 64 })) {}
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        ~arena() override {
+            release();
+        }
+
+        /**
+         * Invalidates everything allocated so far. Objects living in the arena are not destroyed.
+         */
+        void reset() {
+            if (head_ == nullptr) {
+                return;
+            }
+            if (head_->next != nullptr) {
+                std::size_t total = 0;
+                for (auto* block = head_; block != nullptr; block = block->next) {
+                    total += block->size;
+                }
+                release();
+                push_block(total);
+            }
+            cursor_ = head_->data();
+            end_ = cursor_ + head_->size;
+        }
+
+        /**
+         * Returns all memory to the upstream resource.
+         */
+        void release() noexcept {
+            while (head_ != nullptr) {
+                auto* next = head_->next;
+                upstream_->deallocate(head_, sizeof(block) + head_->size, alignof(block));
+                head_ = next;
+            }
+            cursor_ = nullptr;
+            end_ = nullptr;
+        }
+
+        [[nodiscard]] std::size_t capacity() const noexcept {
+            std::size_t total = 0;
+            for (auto* block = head_; block != nullptr; block = block->next) {
+                total += block->size;
+            }
+            return total;
+        }
+
+    private:
+        struct alignas(std::max_align_t) block final {
+            block* next;
+            std::size_t size;
+
+            std::byte* data() noexcept { return reinterpret_cast<std::byte*>(this + 1); }
+        };
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            void* position = cursor_;
+            std::size_t space = static_cast<std::size_t>(end_ - cursor_);
+            if (cursor_ == nullptr || std::align(alignment, bytes, position, space) == nullptr) [[unlikely]] {
+                push_block(std::max(next_size_, bytes + alignment));
+                next_size_ *= 2;
+                position = cursor_;
+                space = static_cast<std::size_t>(end_ - cursor_);
+                std::align(alignment, bytes, position, space);
+            }
+            cursor_ = static_cast<std::byte*>(position) + bytes;
+            return position;
+        }
+
+        void do_deallocate(void*, std::size_t, std::size_t) noexcept override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        void push_block(std::size_t size) {
+            auto* fresh = ::new (upstream_->allocate(sizeof(block) + size, alignof(block))) block{ head_, size };
+            head_ = fresh;
+            cursor_ = fresh->data();
+            end_ = cursor_ + size;
+        }
+
+        std::pmr::memory_resource* upstream_;
+        std::size_t next_size_;
+        block* head_{ nullptr };
+        std::byte* cursor_{ nullptr };
+        std::byte* end_{ nullptr };
+    };
+
+}
@@ -0,0 +1,406 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/task.h"
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/incremental_reader.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/writer.h"
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Coroutine based non-blocking I/O (Linux). A connection is served by a coroutine that suspends whenever
+ * its socket would block, so a thread can hold as many mostly idle connections as it has file descriptors:
+ *
+ *     hope::serialization::task serve(hope::serialization::event_loop& loop, int fd) {
+ *         hope::serialization::async_stream<hope::serialization::varint_format> connection(loop, fd);
+ *         for (request message;;) {
+ *             co_await connection.read(message);
+ *             if (connection.closed()) co_return;
+ *             co_await connection.write(handle(message));
+ *         }
+ *     }
+ *
+ *     loop.spawn(serve(loop, accepted_fd));
+ *     loop.run();
+ */
+namespace hope::serialization {
+
+    /**
+     * Coroutine type for code running on an event_loop: lazily started, awaitable, exceptions propagate
+     * to the awaiter.
+     */
+    using task = detail::task;
+
+    namespace detail {
+
+        [[noreturn]] inline void throw_io_error(const char* what) {
+            throw error(std::string("hope::serialization: ") + what + ": " + std::strerror(errno));
+        }
+
+    }
+
+    /**
+     * Single threaded epoll executor. Runs spawned tasks and resumes the ones waiting for a descriptor when
+     * it becomes ready. Descriptors are registered edge-triggered the first time they are waited on and stay
+     * registered until forget(), so waiting costs no system call; a coroutine only waits after the operation
+     * it tried returned EAGAIN, which guarantees another edge.
+     */
+    class event_loop final : public detail::frame_owner {
+    public:
+        event_loop()
+            : epoll_(::epoll_create1(EPOLL_CLOEXEC)) {
+            if (epoll_ < 0) {
+                detail::throw_io_error("cannot create epoll instance");
+            }
+            wake_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            if (wake_ < 0) {
+                ::close(epoll_);
+                detail::throw_io_error("cannot create eventfd");
+            }
+            ::epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = wake_;
+            if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &event) != 0) {
+                ::close(wake_);
+                ::close(epoll_);
+                detail::throw_io_error("cannot watch eventfd");
+            }
+        }
+
+        event_loop(const event_loop&) = delete;
+        event_loop& operator=(const event_loop&) = delete;
+
+        ~event_loop() {
+            tasks_.clear();
+            ::close(wake_);
+            ::close(epoll_);
+        }
+
+        /**
+         * Hands a task to the loop; it starts on the next turn of run() and is destroyed when it finishes.
+         */
+        void spawn(task work) {
+            const auto slot = tasks_.emplace(tasks_.end());
+            *slot = supervise(std::move(work), slot);
+            ready_.push_back(slot->handle());
+        }
+
+        /**
+         * Runs until every spawned task has finished or stop() is called. The first exception that escapes
+         * a spawned task stops the loop and is rethrown here.
+         */
+        void run() {
+            std::array<::epoll_event, 256> events;
+            stopping_.store(false, std::memory_order_relaxed);
+            for (;;) {
+                while (!ready_.empty()) {
+                    const auto handle = ready_.front();
+                    ready_.pop_front();
+                    handle.resume();
+                }
+                for (const auto slot : finished_) {
+                    tasks_.erase(slot);
+                }
+                finished_.clear();
+                if (failure_) {
+                    std::rethrow_exception(std::exchange(failure_, nullptr));
+                }
+                if (tasks_.empty() || stopping_.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                const int count = ::epoll_wait(epoll_, events.data(), static_cast<int>(events.size()), -1);
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    detail::throw_io_error("epoll_wait failed");
+                }
+                for (int i = 0; i < count; ++i) {
+                    dispatch(events[static_cast<std::size_t>(i)]);
+                }
+            }
+        }
+
+        /**
+         * Makes run() return after the current turn; may be called from any thread.
+         */
+        void stop() noexcept {
+            stopping_.store(true, std::memory_order_relaxed);
+            const std::uint64_t one = 1;
+            (void)!::write(wake_, &one, sizeof(one));
+        }
+
+        /**
+         * Awaitables resuming the awaiting coroutine once fd can be read from (written to), or has failed.
+         * At most one coroutine may wait for each direction of a descriptor.
+         */
+        [[nodiscard]] auto readable(int fd) noexcept { return io_awaiter{ *this, fd, false }; }
+        [[nodiscard]] auto writable(int fd) noexcept { return io_awaiter{ *this, fd, true }; }
+
+        /**
+         * Unregisters fd; call before closing it, with nothing waiting on it.
+         */
+        void forget(int fd) noexcept {
+            if (static_cast<std::size_t>(fd) < watches_.size() && watches_[static_cast<std::size_t>(fd)].added) {
+                (void)::epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+                watches_[static_cast<std::size_t>(fd)] = watch{};
+            }
+        }
+
+    private:
+        struct watch final {
+            std::coroutine_handle<> reader;
+            std::coroutine_handle<> writer;
+            bool added{ false };
+        };
+
+        struct io_awaiter final {
+            event_loop& loop;
+            int fd;
+            bool output;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) { loop.wait(fd, output, handle); }
+
+            void await_resume() const noexcept {}
+        };
+
+        void wait(int fd, bool output, std::coroutine_handle<> handle) {
+            const auto index = static_cast<std::size_t>(fd);
+            if (index >= watches_.size()) {
+                watches_.resize(index + 1);
+            }
+            watch& entry = watches_[index];
+            if (!entry.added) {
+                ::epoll_event event{};
+                event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                event.data.fd = fd;
+                if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                    detail::throw_io_error("cannot watch descriptor");
+                }
+                entry.added = true;
+            }
+            (output ? entry.writer : entry.reader) = handle;
+        }
+
+        void dispatch(const ::epoll_event& event) {
+            if (event.data.fd == wake_) {
+                std::uint64_t count;
+                (void)!::read(wake_, &count, sizeof(count));
+                return;
+            }
+            watch& entry = watches_[static_cast<std::size_t>(event.data.fd)];
+            constexpr std::uint32_t failed = EPOLLERR | EPOLLHUP;
+            // a waiter woken by an error retries its call and sees the error itself
+            if ((event.events & (EPOLLIN | EPOLLRDHUP | failed)) != 0 && entry.reader) {
+                ready_.push_back(std::exchange(entry.reader, nullptr));
+            }
+            if ((event.events & (EPOLLOUT | failed)) != 0 && entry.writer) {
+                ready_.push_back(std::exchange(entry.writer, nullptr));
+            }
+        }
+
+        task supervise(task work, std::list<task>::iterator slot) {
+            try {
+                co_await work;
+            } catch (...) {
+                if (!failure_) {
+                    failure_ = std::current_exception();
+                }
+            }
+            // the frame cannot destroy itself while running; run() erases it after this turn
+            finished_.push_back(slot);
+        }
+
+        int epoll_;
+        int wake_;
+        std::atomic<bool> stopping_{ false };
+        std::vector<watch> watches_;
+        std::deque<std::coroutine_handle<>> ready_;
+        std::list<task> tasks_;
+        std::vector<std::list<task>::iterator> finished_;
+        std::exception_ptr failure_;
+    };
+
+    /**
+     * Message stream over a non-blocking descriptor (socket, pipe) driven by an event_loop. Messages are
+     * plain encodings as written by writer<Stream, Format>, back to back; decoding goes through an
+     * incremental_reader per message type, reused from message to message, so a warmed up stream reads and
+     * writes without allocating. One read and one write may be in flight at a time.
+     */
+    template <format Format = format{}>
+    class async_stream final : public detail::frame_owner {
+    public:
+        /**
+         * Switches fd to non-blocking mode; the caller keeps ownership and closes it after the stream is gone.
+         * buffer_size bounds the bytes taken from the descriptor per read call.
+         */
+        async_stream(event_loop& loop, int fd, std::pmr::memory_resource* resource = nullptr, std::size_t buffer_size = 4096)
+            : loop_(loop)
+            , fd_(fd)
+            , resource_(resource)
+            , input_(buffer_size) {
+            const int flags = ::fcntl(fd, F_GETFL);
+            if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+                detail::throw_io_error("cannot make descriptor non-blocking");
+            }
+        }
+
+        async_stream(const async_stream&) = delete;
+        async_stream& operator=(const async_stream&) = delete;
+
+        ~async_stream() { loop_.forget(fd_); }
+
+        /**
+         * Decodes the next message into value, suspending while input is missing. If the peer closes the
+         * connection before the message starts, completes with closed() set and value untouched; closing
+         * in the middle of a message throws error.
+         */
+        template <typename T>
+        task read(T& value) {
+            auto& decoder = decoder_for(value);
+            bool started = false;
+            for (;;) {
+                if (begin_ != end_) {
+                    started = true;
+                    begin_ += decoder.feed({ input_.data() + begin_, end_ - begin_ });
+                    if (decoder.done()) {
+                        co_return;
+                    }
+                }
+                begin_ = end_ = 0;
+                const ::ssize_t size = ::read(fd_, input_.data(), input_.size());
+                if (size > 0) {
+                    end_ = static_cast<std::size_t>(size);
+                } else if (size == 0) {
+                    if (started) [[unlikely]] {
+                        throw error("hope::serialization: connection closed in the middle of a message");
+                    }
+                    closed_ = true;
+                    co_return;
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    co_await loop_.readable(fd_);
+                } else if (errno != EINTR) {
+                    detail::throw_io_error("cannot read");
+                }
+            }
+        }
+
+        /**
+         * Encodes value and sends it, suspending while the descriptor is full.
+         */
+        template <typename T>
+        task write(const T& value) {
+            queue(value);
+            return flush();
+        }
+
+        /**
+         * Encodes value behind the messages already queued; flush() sends them together.
+         */
+        template <typename T>
+        void queue(const T& value) {
+            writer<output_buffer, Format>(output_).write(value);
+        }
+
+        task flush() {
+            std::size_t sent = 0;
+            while (sent < output_.size()) {
+                const ::ssize_t size = send(output_.data() + sent, output_.size() - sent);
+                if (size >= 0) {
+                    sent += static_cast<std::size_t>(size);
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    co_await loop_.writable(fd_);
+                } else if (errno != EINTR) {
+                    detail::throw_io_error("cannot write");
+                }
+            }
+            output_.clear();
+        }
+
+        /**
+         * True once the peer has closed the connection at a message boundary.
+         */
+        [[nodiscard]] bool closed() const noexcept { return closed_; }
+
+        [[nodiscard]] int descriptor() const noexcept { return fd_; }
+
+    private:
+        /**
+         * Sockets are written with MSG_NOSIGNAL, so a vanished peer is an error instead of SIGPIPE.
+         */
+        ::ssize_t send(const std::uint8_t* data, std::size_t size) {
+            if (socket_) {
+                const ::ssize_t sent = ::send(fd_, data, size, MSG_NOSIGNAL);
+                if (sent >= 0 || errno != ENOTSOCK) {
+                    return sent;
+                }
+                socket_ = false;
+            }
+            return ::write(fd_, data, size);
+        }
+
+        template <typename T>
+        static constexpr char decoder_key = 0;
+
+        struct cached_decoder final {
+            const void* key;
+            std::unique_ptr<void, void (*)(void*)> decoder;
+        };
+
+        template <typename T>
+        incremental_reader<T, Format>& decoder_for(T& value) {
+            using decoder_type = incremental_reader<T, Format>;
+            for (auto& cached : decoders_) {
+                if (cached.key == &decoder_key<T>) {
+                    auto& decoder = *static_cast<decoder_type*>(cached.decoder.get());
+                    decoder.restart(value);
+                    return decoder;
+                }
+            }
+            auto& cached = decoders_.emplace_back(cached_decoder{ &decoder_key<T>,
+                { new decoder_type(value, resource_), [](void* decoder) { delete static_cast<decoder_type*>(decoder); } } });
+            return *static_cast<decoder_type*>(cached.decoder.get());
+        }
+
+        event_loop& loop_;
+        int fd_;
+        std::pmr::memory_resource* resource_;
+        std::vector<std::uint8_t> input_;
+        std::size_t begin_{ 0 };
+        std::size_t end_{ 0 };
+        output_buffer output_;
+        std::vector<cached_decoder> decoders_;
+        bool closed_{ false };
+        bool socket_{ true };
+    };
+
+}
@@ -0,0 +1,146 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace hope::serialization {
+
+    /**
+     * An integer known to lie in [Min, Max]. It is written as its offset from Min in just enough bits for
+     * the range; neighbouring bit fields of a record share bytes, arrays are packed back to back.
+     * Writing a value outside the range throws error, as does reading an offset past Max.
+     *
+     *     struct order { hope::serialization::bounded<std::uint32_t, 0, 1000> quantity; side direction; bool urgent; };
+     */
+    template <std::integral T, T Min, T Max>
+        requires (Min <= Max)
+    class bounded final {
+    public:
+        using value_type = T;
+        static constexpr T min = Min;
+        static constexpr T max = Max;
+
+        constexpr bounded() noexcept
+            : value_(Min) {}
+
+        constexpr bounded(T value) noexcept
+            : value_(value) {}
+
+        constexpr operator T() const noexcept { return value_; }
+
+        [[nodiscard]] constexpr T value() const noexcept { return value_; }
+
+        friend constexpr bool operator==(const bounded&, const bounded&) noexcept = default;
+
+    private:
+        T value_;
+    };
+
+    /**
+     * Specialize with the smallest and largest enumerator to pack an enum like a bounded integer:
+     *
+     *     template <> struct hope::serialization::enum_range<side> {
+     *         static constexpr side min = side::buy;
+     *         static constexpr side max = side::sell;
+     *     };
+     */
+    template <typename Enum>
+    struct enum_range;
+
+    namespace detail {
+
+        /**
+         * Range of a bit field type: span is the largest offset, encode() checks and maps a value to its
+         * offset, decode() checks an offset and maps it back.
+         */
+        template <typename T>
+        struct bit_range;
+
+        template <typename T, T Min, T Max>
+        struct bit_range<bounded<T, Min, Max>> {
+            static constexpr std::uint64_t span = static_cast<std::uint64_t>(Max) - static_cast<std::uint64_t>(Min);
+
+            static std::uint64_t encode(const bounded<T, Min, Max>& value) {
+                if (value.value() < Min || value.value() > Max) [[unlikely]] {
+                    throw error("hope::serialization: value outside its declared range");
+                }
+                return static_cast<std::uint64_t>(value.value()) - static_cast<std::uint64_t>(Min);
+            }
+
+            static void decode(std::uint64_t offset, bounded<T, Min, Max>& value) {
+                if (offset > span) [[unlikely]] {
+                    throw error("hope::serialization: value outside its declared range");
+                }
+                value = static_cast<T>(static_cast<std::uint64_t>(Min) + offset);
+            }
+        };
+
+        template <typename Enum>
+            requires std::is_enum_v<Enum> && requires { enum_range<Enum>::min; enum_range<Enum>::max; }
+        struct bit_range<Enum> {
+            using underlying = std::underlying_type_t<Enum>;
+            using range = bit_range<bounded<underlying, static_cast<underlying>(enum_range<Enum>::min),
+                static_cast<underlying>(enum_range<Enum>::max)>>;
+
+            static constexpr std::uint64_t span = range::span;
+
+            static std::uint64_t encode(Enum value) { return range::encode(static_cast<underlying>(value)); }
+
+            static void decode(std::uint64_t offset, Enum& value) {
+                bounded<underlying, static_cast<underlying>(enum_range<Enum>::min), static_cast<underlying>(enum_range<Enum>::max)> bits;
+                range::decode(offset, bits);
+                value = static_cast<Enum>(bits.value());
+            }
+        };
+
+        template <>
+        struct bit_range<bool> {
+            static constexpr std::uint64_t span = 1;
+
+            static std::uint64_t encode(bool value) noexcept { return value ? 1 : 0; }
+
+            static void decode(std::uint64_t offset, bool& value) {
+                if (offset > 1) [[unlikely]] {
+                    throw error("hope::serialization: malformed bool");
+                }
+                value = offset != 0;
+            }
+        };
+
+        /**
+         * Bounded integers and enums with an enum_range, whatever the format.
+         */
+        template <typename T>
+        concept ranged = !std::is_same_v<T, bool> && requires { bit_range<T>::span; };
+
+        /**
+         * Values the format writes in a fixed number of bits: ranged types, and bools with bool_encoding::bit.
+         */
+        template <typename T, format Format>
+        concept bit_field = ranged<T> || (std::is_same_v<T, bool> && Format.bools == bool_encoding::bit);
+
+        /**
+         * At least one bit even for a single value range, so a count of bit fields is bounded by the input.
+         */
+        template <typename T>
+        inline constexpr unsigned bit_width_v = bit_range<T>::span == 0 ? 1 : static_cast<unsigned>(std::bit_width(bit_range<T>::span));
+
+        /**
+         * Bytes taken by a bit field that is not packed with neighbours.
+         */
+        template <typename T>
+        inline constexpr std::size_t bit_field_bytes_v = (bit_width_v<T> + 7) / 8;
+
+    }
+
+}
@@ -0,0 +1,167 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/format.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/writer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace hope::serialization {
+
+    /**
+     * Bounds on what every thread keeps cached: at most max_buffers free buffers, none with more capacity
+     * than max_capacity. A buffer released beyond either bound is freed.
+     */
+    struct buffer_pool_limits final {
+        std::size_t max_buffers = 16;
+        std::size_t max_capacity = std::size_t{ 1 } << 20;
+    };
+
+    class pooled_buffer;
+
+    /**
+     * Per-thread free lists of output buffers. acquire() takes a buffer from the calling thread's list, its
+     * handle gives it back to the list of the thread that destroys it. No locks are taken; once every thread
+     * has warmed up, encoding messages no larger than max_capacity allocates nothing.
+     *
+     *     auto buffer = hope::serialization::buffer_pool::acquire();
+     *     hope::serialization::serialize<hope::serialization::varint_format>(message, *buffer);
+     *     socket.send(buffer->view());
+     *     // back to the pool here
+     */
+    class buffer_pool final {
+    public:
+        buffer_pool() = delete;
+
+        [[nodiscard]] static pooled_buffer acquire();
+
+        /**
+         * Caches buffer on the calling thread, emptied, unless the limits say otherwise.
+         */
+        static void release(output_buffer buffer) noexcept {
+            const auto current = limits();
+            auto& list = free_list();
+            if (buffer.capacity() == 0 || buffer.capacity() > current.max_capacity || list.size() >= current.max_buffers) {
+                return;
+            }
+            buffer.clear();
+            try {
+                list.push_back(std::move(buffer));
+            } catch (...) {
+                // the list could not grow; the buffer is simply freed
+            }
+        }
+
+        /**
+         * Applies to every thread from its next release on; buffers already cached stay until trim().
+         */
+        static void set_limits(buffer_pool_limits limits) noexcept {
+            max_buffers_.store(limits.max_buffers, std::memory_order_relaxed);
+            max_capacity_.store(limits.max_capacity, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] static buffer_pool_limits limits() noexcept {
+            return { max_buffers_.load(std::memory_order_relaxed), max_capacity_.load(std::memory_order_relaxed) };
+        }
+
+        /**
+         * Free buffers cached by the calling thread.
+         */
+        [[nodiscard]] static std::size_t cached() noexcept { return free_list().size(); }
+
+        /**
+         * Frees the buffers cached by the calling thread.
+         */
+        static void trim() noexcept {
+            auto& list = free_list();
+            list.clear();
+            list.shrink_to_fit();
+        }
+
+    private:
+        friend class pooled_buffer;
+
+        static std::vector<output_buffer>& free_list() noexcept {
+            thread_local std::vector<output_buffer> list;
+            return list;
+        }
+
+        static output_buffer take() noexcept {
+            auto& list = free_list();
+            if (list.empty()) {
+                return output_buffer();
+            }
+            output_buffer buffer = std::move(list.back());
+            list.pop_back();
+            return buffer;
+        }
+
+        static inline std::atomic<std::size_t> max_buffers_{ buffer_pool_limits{}.max_buffers };
+        static inline std::atomic<std::size_t> max_capacity_{ buffer_pool_limits{}.max_capacity };
+    };
+
+    /**
+     * An output buffer on loan from buffer_pool, returned when the handle is destroyed.
+     */
+    class pooled_buffer final {
+    public:
+        pooled_buffer() noexcept = default;
+
+        pooled_buffer(pooled_buffer&& other) noexcept
+            : buffer_(std::exchange(other.buffer_, output_buffer())) {}
+
+        pooled_buffer& operator=(pooled_buffer&& other) noexcept {
+            if (this != &other) {
+                buffer_pool::release(std::exchange(buffer_, std::exchange(other.buffer_, output_buffer())));
+            }
+            return *this;
+        }
+
+        ~pooled_buffer() { buffer_pool::release(std::move(buffer_)); }
+
+        [[nodiscard]] output_buffer& operator*() noexcept { return buffer_; }
+        [[nodiscard]] const output_buffer& operator*() const noexcept { return buffer_; }
+        [[nodiscard]] output_buffer* operator->() noexcept { return &buffer_; }
+        [[nodiscard]] const output_buffer* operator->() const noexcept { return &buffer_; }
+
+        [[nodiscard]] std::span<const std::uint8_t> view() const noexcept { return buffer_.view(); }
+
+        /**
+         * Takes the buffer out of the pool's reach, e.g. to hand its bytes to a consumer that keeps them.
+         */
+        [[nodiscard]] output_buffer detach() noexcept { return std::exchange(buffer_, output_buffer()); }
+
+    private:
+        friend class buffer_pool;
+
+        explicit pooled_buffer(output_buffer buffer) noexcept
+            : buffer_(std::move(buffer)) {}
+
+        output_buffer buffer_;
+    };
+
+    inline pooled_buffer buffer_pool::acquire() {
+        return pooled_buffer(take());
+    }
+
+    /**
+     * Encodes value into a buffer from the calling thread's pool.
+     */
+    template <format Format = format{}, typename T>
+    [[nodiscard]] pooled_buffer serialize_pooled(const T& value) {
+        auto buffer = buffer_pool::acquire();
+        buffer->reserve(serialized_size<Format>(value) + detail::max_prepare_size);
+        writer<output_buffer, Format>(*buffer).write(value);
+        return buffer;
+    }
+
+}
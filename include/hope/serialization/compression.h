@@ -0,0 +1,317 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/framing.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/varint.h"
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(HOPE_SERIALIZATION_LZ4)
+#include <lz4.h>
+#endif
+
+#if defined(HOPE_SERIALIZATION_ZSTD)
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+/**
+ * Optional compression stage for frames. A compressed frame travels in an envelope:
+ *
+ *     varint envelope length (bytes after this prefix)
+ *     1 byte method
+ *     varint frame size, unless the method is none
+ *     the frame, compressed with method
+ *
+ * The envelope starts with a length prefix like a frame does, so frame_size() finds its end as well.
+ * Codecs are compiled in with HOPE_SERIALIZATION_LZ4 and HOPE_SERIALIZATION_ZSTD, which the CMake options
+ * of the same names define together with linking the libraries.
+ */
+namespace hope::serialization {
+
+    enum class compression : std::uint8_t {
+        none = 0,
+        lz4 = 1,
+        zstd = 2,
+    };
+
+    /**
+     * A block compressor. compress() returns the compressed size, or 0 when the output did not fit into
+     * capacity (at least bound(size)); decompress() must produce exactly original bytes or throw.
+     */
+    template <typename Codec>
+    concept frame_codec = requires(Codec& codec, const std::uint8_t* in, std::uint8_t* out, std::size_t size) {
+        { Codec::method } -> std::convertible_to<compression>;
+        { codec.bound(size) } -> std::same_as<std::size_t>;
+        { codec.compress(in, size, out, size) } -> std::same_as<std::size_t>;
+        codec.decompress(in, size, out, size);
+    };
+
+    /**
+     * Frames shorter than this go out stored: small frames barely compress without a dictionary, and the
+     * codec call would cost more than the bytes saved.
+     */
+    inline constexpr std::size_t default_compression_threshold = 256;
+
+    /**
+     * Largest frame size an envelope may announce; keeps a corrupt or hostile size from allocating.
+     */
+    inline constexpr std::size_t max_decompressed_frame_size = std::size_t{ 1 } << 28;
+
+    /**
+     * Wraps frames into envelopes, compressing those of at least threshold bytes unless the result would not
+     * be smaller. Frames above max_decompressed_frame_size go out stored, since no receiver would inflate
+     * them. Buffers are reused, so one compressor per connection allocates only while warming up; sending
+     * and receiving use separate buffers and may be interleaved.
+     *
+     *     frame_compressor<zstd_codec> compressor(zstd_codec(dictionary));
+     *     compressor.flush(frame, socket_stream);         // sender, frame is a frame_writer
+     *     auto bytes = compressor.decompress(envelope);   // receiver, then frame_view(bytes)
+     */
+    template <frame_codec Codec>
+    class frame_compressor final {
+    public:
+        explicit frame_compressor(Codec codec = Codec{}, std::size_t threshold = default_compression_threshold)
+            : codec_(std::move(codec))
+            , threshold_(threshold) {}
+
+        /**
+         * Writes the envelope of an encoded frame.
+         */
+        template <output_stream Stream>
+        void write(Stream& stream, std::span<const std::uint8_t> frame) {
+            compression method = compression::none;
+            std::span<const std::uint8_t> payload = frame;
+            if (frame.size() >= threshold_ && frame.size() <= max_decompressed_frame_size) {
+                compressed_.clear();
+                std::uint8_t* out = compressed_.prepare(codec_.bound(frame.size()));
+                const std::size_t size = codec_.compress(frame.data(), frame.size(), out, codec_.bound(frame.size()));
+                if (size != 0 && size < frame.size()) {
+                    compressed_.commit(size);
+                    method = Codec::method;
+                    payload = compressed_.view();
+                }
+            }
+            std::array<std::uint8_t, 2 * max_varint_size + 1> header;
+            const std::size_t size_field = method == compression::none ? 0 : varint_size(frame.size());
+            std::size_t used = encode_varint(1 + size_field + payload.size(), header.data());
+            header[used++] = static_cast<std::uint8_t>(method);
+            if (method != compression::none) {
+                used += encode_varint(frame.size(), header.data() + used);
+            }
+            stream.write(header.data(), used);
+            stream.write(payload.data(), payload.size());
+        }
+
+        /**
+         * Flushes the frame being built by frames as one envelope.
+         */
+        template <format Format, output_stream Stream>
+        void flush(frame_writer<Format>& frames, Stream& stream) {
+            if (frames.empty()) {
+                return;
+            }
+            staging_.clear();
+            frames.flush(staging_);
+            write(stream, staging_.view());
+        }
+
+        /**
+         * Returns the frame held by the envelope at the start of bytes (see frame_size). Stored frames are
+         * returned in place; decompressed ones live in the compressor until the next decompress().
+         */
+        [[nodiscard]] std::span<const std::uint8_t> decompress(std::span<const std::uint8_t> envelope) {
+            std::uint64_t length;
+            std::size_t used = decode_varint(envelope.data(), envelope.data() + envelope.size(), length);
+            if (used == 0 || length == 0 || length > envelope.size() - used) [[unlikely]] {
+                throw error("hope::serialization: incomplete compressed frame");
+            }
+            const std::uint8_t* cursor = envelope.data() + used;
+            const std::uint8_t* end = cursor + length;
+            const auto method = static_cast<compression>(*cursor++);
+            if (method == compression::none) {
+                return { cursor, end };
+            }
+            if (method != Codec::method) [[unlikely]] {
+                throw error("hope::serialization: frame was compressed with another method");
+            }
+            std::uint64_t original;
+            used = decode_varint(cursor, end, original);
+            if (used == 0 || original > max_decompressed_frame_size) [[unlikely]] {
+                throw error("hope::serialization: malformed compressed frame size");
+            }
+            cursor += used;
+            decompressed_.clear();
+            const auto size = static_cast<std::size_t>(original);
+            codec_.decompress(cursor, static_cast<std::size_t>(end - cursor), decompressed_.prepare(size), size);
+            decompressed_.commit(size);
+            return decompressed_.view();
+        }
+
+        [[nodiscard]] Codec& codec() noexcept { return codec_; }
+        [[nodiscard]] std::size_t threshold() const noexcept { return threshold_; }
+
+    private:
+        Codec codec_;
+        std::size_t threshold_;
+        output_buffer staging_;
+        output_buffer compressed_;
+        output_buffer decompressed_;
+    };
+
+#if defined(HOPE_SERIALIZATION_LZ4)
+
+    /**
+     * LZ4 block compression, for links where latency matters more than bytes.
+     */
+    class lz4_codec final {
+    public:
+        static constexpr compression method = compression::lz4;
+
+        explicit lz4_codec(int acceleration = 1)
+            : acceleration_(acceleration)
+            , state_(std::make_unique<std::max_align_t[]>(
+                  (static_cast<std::size_t>(LZ4_sizeofState()) + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t))) {}
+
+        [[nodiscard]] std::size_t bound(std::size_t size) const {
+            return static_cast<std::size_t>(LZ4_compressBound(checked_size(size)));
+        }
+
+        [[nodiscard]] std::size_t compress(const std::uint8_t* in, std::size_t size, std::uint8_t* out, std::size_t capacity) {
+            const int written = LZ4_compress_fast_extState(state_.get(), reinterpret_cast<const char*>(in),
+                reinterpret_cast<char*>(out), checked_size(size), checked_size(capacity), acceleration_);
+            return written > 0 ? static_cast<std::size_t>(written) : 0;
+        }
+
+        void decompress(const std::uint8_t* in, std::size_t size, std::uint8_t* out, std::size_t original) {
+            const int written = LZ4_decompress_safe(reinterpret_cast<const char*>(in), reinterpret_cast<char*>(out),
+                checked_size(size), checked_size(original));
+            if (written < 0 || static_cast<std::size_t>(written) != original) [[unlikely]] {
+                throw error("hope::serialization: corrupt lz4 frame");
+            }
+        }
+
+    private:
+        static int checked_size(std::size_t size) {
+            if (size > LZ4_MAX_INPUT_SIZE) [[unlikely]] {
+                throw error("hope::serialization: frame too large for lz4");
+            }
+            return static_cast<int>(size);
+        }
+
+        int acceleration_;
+        std::unique_ptr<std::max_align_t[]> state_;
+    };
+
+#endif
+
+#if defined(HOPE_SERIALIZATION_ZSTD)
+
+    /**
+     * Trains a zstd dictionary from sample messages or frames, typically a few thousand captured from
+     * production. samples is a range of contiguous byte ranges; the result is at most capacity bytes and is
+     * meant to be stored and shipped to both peers.
+     */
+    template <typename Samples>
+    [[nodiscard]] std::vector<std::uint8_t> train_zstd_dictionary(const Samples& samples, std::size_t capacity = 16 * 1024) {
+        std::vector<std::uint8_t> joined;
+        std::vector<std::size_t> sizes;
+        for (const auto& sample : samples) {
+            joined.insert(joined.end(), std::ranges::begin(sample), std::ranges::end(sample));
+            sizes.push_back(std::ranges::size(sample));
+        }
+        std::vector<std::uint8_t> dictionary(capacity);
+        const std::size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), joined.data(), sizes.data(),
+            static_cast<unsigned>(sizes.size()));
+        if (ZDICT_isError(size)) [[unlikely]] {
+            throw error(std::string("hope::serialization: zstd dictionary training failed: ") + ZDICT_getErrorName(size));
+        }
+        dictionary.resize(size);
+        return dictionary;
+    }
+
+    /**
+     * zstd compression, optionally with a dictionary. The dictionary is digested once at construction;
+     * both peers must use the same one. Frames omit zstd's own content size, the envelope carries it.
+     */
+    class zstd_codec final {
+    public:
+        static constexpr compression method = compression::zstd;
+
+        explicit zstd_codec(int level = 3)
+            : zstd_codec({}, level) {}
+
+        explicit zstd_codec(std::span<const std::uint8_t> dictionary, int level = 3)
+            : compressor_(ZSTD_createCCtx())
+            , decompressor_(ZSTD_createDCtx()) {
+            if (!compressor_ || !decompressor_) [[unlikely]] {
+                throw std::bad_alloc();
+            }
+            if (!dictionary.empty()) {
+                compression_dictionary_.reset(ZSTD_createCDict(dictionary.data(), dictionary.size(), level));
+                decompression_dictionary_.reset(ZSTD_createDDict(dictionary.data(), dictionary.size()));
+                if (!compression_dictionary_ || !decompression_dictionary_) [[unlikely]] {
+                    throw error("hope::serialization: invalid zstd dictionary");
+                }
+                check(ZSTD_CCtx_refCDict(compressor_.get(), compression_dictionary_.get()));
+            } else {
+                check(ZSTD_CCtx_setParameter(compressor_.get(), ZSTD_c_compressionLevel, level));
+            }
+            check(ZSTD_CCtx_setParameter(compressor_.get(), ZSTD_c_contentSizeFlag, 0));
+        }
+
+        [[nodiscard]] std::size_t bound(std::size_t size) const noexcept { return ZSTD_compressBound(size); }
+
+        [[nodiscard]] std::size_t compress(const std::uint8_t* in, std::size_t size, std::uint8_t* out, std::size_t capacity) {
+            const std::size_t written = ZSTD_compress2(compressor_.get(), out, capacity, in, size);
+            return ZSTD_isError(written) ? 0 : written;
+        }
+
+        void decompress(const std::uint8_t* in, std::size_t size, std::uint8_t* out, std::size_t original) {
+            const std::size_t written = ZSTD_decompress_usingDDict(decompressor_.get(), out, original, in, size,
+                decompression_dictionary_.get());
+            if (ZSTD_isError(written) || written != original) [[unlikely]] {
+                throw error("hope::serialization: corrupt zstd frame");
+            }
+        }
+
+    private:
+        static void check(std::size_t result) {
+            if (ZSTD_isError(result)) [[unlikely]] {
+                throw error(std::string("hope::serialization: zstd: ") + ZSTD_getErrorName(result));
+            }
+        }
+
+        struct deleter final {
+            void operator()(ZSTD_CCtx* context) const noexcept { ZSTD_freeCCtx(context); }
+            void operator()(ZSTD_DCtx* context) const noexcept { ZSTD_freeDCtx(context); }
+            void operator()(ZSTD_CDict* dictionary) const noexcept { ZSTD_freeCDict(dictionary); }
+            void operator()(ZSTD_DDict* dictionary) const noexcept { ZSTD_freeDDict(dictionary); }
+        };
+
+        // Dictionaries are declared first so the contexts referencing them are destroyed before them.
+        std::unique_ptr<ZSTD_CDict, deleter> compression_dictionary_;
+        std::unique_ptr<ZSTD_DDict, deleter> decompression_dictionary_;
+        std::unique_ptr<ZSTD_CCtx, deleter> compressor_;
+        std::unique_ptr<ZSTD_DCtx, deleter> decompressor_;
+    };
+
+#endif
+
+}
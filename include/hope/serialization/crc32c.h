@@ -0,0 +1,32 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/crc32c.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace hope::serialization {
+
+    /**
+     * CRC-32C of bytes, computed with the crc32 instruction of SSE4.2 or ARMv8 when the target has it.
+     * Passing the CRC of the preceding bytes continues it: crc32c(b, crc32c(a)) is the CRC of a then b.
+     */
+    [[nodiscard]] inline std::uint32_t crc32c(std::span<const std::uint8_t> bytes, std::uint32_t crc = 0) noexcept {
+        return ~detail::crc32c_update(~crc, bytes.data(), bytes.size());
+    }
+
+    /**
+     * CRC-32C of a then b from the CRCs of both parts and the size of b, in time logarithmic in that size.
+     * Parts checksummed independently (segments, chunks encoded on different threads) merge without
+     * reading their bytes again.
+     */
+    [[nodiscard]] constexpr std::uint32_t crc32c_combine(std::uint32_t first, std::uint32_t second, std::uint64_t second_size) noexcept {
+        return detail::crc32c_multiply(detail::crc32c_shift(second_size), first) ^ second;
+    }
+
+}
@@ -0,0 +1,63 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/bounded.h"
+#include "hope/serialization/detail/bit_pack.h"
+#include "hope/serialization/traits.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+/**
+ * Moving bit fields between values and packed bytes, shared by the writer and both readers.
+ */
+namespace hope::serialization::detail {
+
+    /**
+     * Packs fields [I, End) of a run starting at bit position; out must be zeroed and padded.
+     */
+    template <std::size_t I, std::size_t End, typename Fields>
+    void pack_bit_fields(const Fields& fields, std::uint8_t* out, std::size_t position = 0) {
+        if constexpr (I < End) {
+            using field_type = field_t<Fields, I>;
+            bit_pack::put(out, position, bit_range<field_type>::encode(std::get<I>(fields)), bit_width_v<field_type>);
+            pack_bit_fields<I + 1, End>(fields, out, position + bit_width_v<field_type>);
+        }
+    }
+
+    /**
+     * Unpacks and range checks fields [I, End); in must be padded.
+     */
+    template <std::size_t I, std::size_t End, typename Fields>
+    void unpack_bit_fields(const Fields& fields, const std::uint8_t* in, std::size_t position = 0) {
+        if constexpr (I < End) {
+            using field_type = field_t<Fields, I>;
+            bit_range<field_type>::decode(bit_pack::get(in, position, bit_width_v<field_type>), std::get<I>(fields));
+            unpack_bit_fields<I + 1, End>(fields, in, position + bit_width_v<field_type>);
+        }
+    }
+
+    /**
+     * Unpacks and range checks count values of at most bit_pack::block_size; in must be padded.
+     */
+    template <typename T>
+    void unpack_bit_array(const std::uint8_t* in, std::size_t count, T* values) {
+        if constexpr (std::is_same_v<T, bool>) {
+            bit_pack::unpack_bools(in, count, values);
+        } else {
+            std::array<std::uint64_t, bit_pack::block_size> offsets;
+            bit_pack::unpack(in, count, bit_width_v<T>, offsets.data());
+            for (std::size_t i = 0; i < count; ++i) {
+                bit_range<T>::decode(offsets[i], values[i]);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,186 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/byte_swap.h"
+#include "hope/serialization/detail/simd.h"
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Fixed width bit packing: count values of bits each, least significant bit first, byte after byte, whatever
+ * the host's byte order.
+ * Used for blocks of small residuals whose width is stored once per block, and for bit fields.
+ */
+namespace hope::serialization::detail::bit_pack {
+
+    /**
+     * Values per block; one width byte per block is cheap enough, and a block of 64 bit values still fits
+     * comfortably into a stack buffer.
+     */
+    inline constexpr std::size_t block_size = 128;
+
+    /**
+     * Unpacking loads 16 bytes at a time; buffers holding packed bytes are padded by this much.
+     */
+    inline constexpr std::size_t padding = 16;
+
+    inline constexpr std::size_t max_block_bytes = block_size * 8;
+
+    template <std::unsigned_integral T>
+    [[nodiscard]] unsigned width(const T* values, std::size_t count) noexcept {
+        T bits = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            bits |= values[i];
+        }
+        return static_cast<unsigned>(std::bit_width(bits));
+    }
+
+    [[nodiscard]] constexpr std::size_t packed_size(std::size_t count, unsigned bits) noexcept {
+        return (count * bits + 7) / 8;
+    }
+
+    /**
+     * Writes packed_size(count, bits) bytes; every value must fit into bits.
+     */
+    template <std::unsigned_integral T>
+    void pack(const T* values, std::size_t count, unsigned bits, std::uint8_t* out) noexcept {
+        if (bits == 0) {
+            return;
+        }
+        std::uint64_t buffer = 0;
+        unsigned filled = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::uint64_t value = values[i];
+            buffer |= value << filled;
+            if (filled + bits >= 64) {
+                const std::uint64_t word = little_endian(buffer);
+                std::memcpy(out, &word, sizeof(word));
+                out += sizeof(buffer);
+                buffer = filled == 0 ? 0 : value >> (64 - filled);
+                filled = filled + bits - 64;
+            } else {
+                filled += bits;
+            }
+        }
+        buffer = little_endian(buffer);
+        std::memcpy(out, &buffer, (filled + 7) / 8);
+    }
+
+    /**
+     * Reads count values of bits each; in must be readable for padding bytes past the packed data.
+     */
+    template <std::unsigned_integral T>
+    void unpack(const std::uint8_t* in, std::size_t count, unsigned bits, T* out) noexcept {
+        if (bits == 0) {
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = 0;
+            }
+            return;
+        }
+        const std::uint64_t mask = bits == 64 ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << bits) - 1;
+        std::size_t position = 0;
+        for (std::size_t i = 0; i < count; ++i, position += bits) {
+            const std::uint8_t* byte = in + position / 8;
+            const unsigned shift = position % 8;
+            std::uint64_t word;
+            std::memcpy(&word, byte, sizeof(word));
+            word = little_endian(word) >> shift;
+            if (bits + shift > 64) {
+                word |= static_cast<std::uint64_t>(byte[8]) << (64 - shift);
+            }
+            out[i] = static_cast<T>(word & mask);
+        }
+    }
+
+    /**
+     * Adds a value of bits at a bit position; out must be zeroed there and writable for padding bytes past it.
+     */
+    inline void put(std::uint8_t* out, std::size_t position, std::uint64_t value, unsigned bits) noexcept {
+        std::uint8_t* byte = out + position / 8;
+        const unsigned shift = position % 8;
+        std::uint64_t word;
+        std::memcpy(&word, byte, sizeof(word));
+        word = little_endian(little_endian(word) | value << shift);
+        std::memcpy(byte, &word, sizeof(word));
+        if (bits + shift > 64) {
+            byte[8] = static_cast<std::uint8_t>(byte[8] | (value >> (64 - shift)));
+        }
+    }
+
+    /**
+     * Reads the value of bits at a bit position; in must be readable for padding bytes past it.
+     */
+    [[nodiscard]] inline std::uint64_t get(const std::uint8_t* in, std::size_t position, unsigned bits) noexcept {
+        const std::uint8_t* byte = in + position / 8;
+        const unsigned shift = position % 8;
+        std::uint64_t word;
+        std::memcpy(&word, byte, sizeof(word));
+        word = little_endian(word) >> shift;
+        if (bits + shift > 64) {
+            word |= static_cast<std::uint64_t>(byte[8]) << (64 - shift);
+        }
+        return bits == 64 ? word : word & ((std::uint64_t{ 1 } << bits) - 1);
+    }
+
+    /**
+     * pack() for bools, one bit each: 16 (32 with AVX2) bools become a movemask of their low bits.
+     */
+    inline void pack_bools(const bool* values, std::size_t count, std::uint8_t* out) noexcept {
+        const auto* bytes = reinterpret_cast<const std::uint8_t*>(values);
+        std::size_t i = 0;
+#if defined(HOPE_SERIALIZATION_AVX2)
+        for (; i + 32 <= count; i += 32) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+            const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi64(x, 7)));
+            std::memcpy(out + i / 8, &mask, sizeof(mask));
+        }
+#endif
+#if defined(HOPE_SERIALIZATION_SSE2)
+        for (; i + 16 <= count; i += 16) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+            const auto mask = static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_slli_epi64(x, 7)));
+            std::memcpy(out + i / 8, &mask, sizeof(mask));
+        }
+#endif
+        for (; i < count; i += 8) {
+            std::uint8_t byte = 0;
+            for (std::size_t j = 0; j < 8 && i + j < count; ++j) {
+                byte = static_cast<std::uint8_t>(byte | (bytes[i + j] << j));
+            }
+            out[i / 8] = byte;
+        }
+    }
+
+    /**
+     * unpack() for bools: every mask byte is broadcast over eight lanes and tested against one bit per lane.
+     * Bits past count in the last byte are ignored.
+     */
+    inline void unpack_bools(const std::uint8_t* in, std::size_t count, bool* values) noexcept {
+        auto* bytes = reinterpret_cast<std::uint8_t*>(values);
+        std::size_t i = 0;
+#if defined(HOPE_SERIALIZATION_SSE2)
+        const __m128i lanes = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+        for (; i + 16 <= count; i += 16) {
+            std::uint16_t mask;
+            std::memcpy(&mask, in + i / 8, sizeof(mask));
+            __m128i x = _mm_set1_epi16(static_cast<short>(mask));
+            x = _mm_unpacklo_epi8(x, x);
+            x = _mm_unpacklo_epi16(x, x);
+            x = _mm_unpacklo_epi32(x, x);
+            x = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(x, lanes), lanes), _mm_set1_epi8(1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i), x);
+        }
+#endif
+        for (; i < count; ++i) {
+            bytes[i] = static_cast<std::uint8_t>((in[i / 8] >> (i % 8)) & 1);
+        }
+    }
+
+}
@@ -0,0 +1,144 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/simd.h"
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#include <cstdlib>
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * Byte order conversion for peers of the other endianness. Arrays are reversed a vector at a time:
+ * pshufb (32 bytes with AVX2), SSE2 word shuffles and shifts without SSSE3, vrev on NEON.
+ */
+namespace hope::serialization::detail {
+
+    template <typename T>
+    concept swappable = (std::is_arithmetic_v<T> || std::is_enum_v<T>) && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+    template <std::size_t Size>
+    using swap_word_t = std::conditional_t<Size == 2, std::uint16_t, std::conditional_t<Size == 4, std::uint32_t, std::uint64_t>>;
+
+    template <swappable T>
+    [[nodiscard]] T byte_swap(T value) noexcept {
+        using word_type = swap_word_t<sizeof(T)>;
+        auto word = std::bit_cast<word_type>(value);
+#if defined(__cpp_lib_byteswap)
+        word = std::byteswap(word);
+#elif defined(_MSC_VER)
+        if constexpr (sizeof(T) == 2) {
+            word = _byteswap_ushort(word);
+        } else if constexpr (sizeof(T) == 4) {
+            word = static_cast<word_type>(_byteswap_ulong(word));
+        } else {
+            word = _byteswap_uint64(word);
+        }
+#elif defined(__GNUC__) || defined(__clang__)
+        if constexpr (sizeof(T) == 2) {
+            word = static_cast<word_type>(__builtin_bswap16(word));
+        } else if constexpr (sizeof(T) == 4) {
+            word = __builtin_bswap32(word);
+        } else {
+            word = __builtin_bswap64(word);
+        }
+#else
+        word_type swapped = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i, word >>= 8) {
+            swapped = static_cast<word_type>(swapped << 8 | (word & 0xff));
+        }
+        word = swapped;
+#endif
+        return std::bit_cast<T>(word);
+    }
+
+    /**
+     * Little endian words regardless of the host, for bit streams defined byte after byte.
+     */
+    [[nodiscard]] inline std::uint64_t little_endian(std::uint64_t word) noexcept {
+        if constexpr (std::endian::native == std::endian::big) {
+            return byte_swap(word);
+        } else {
+            return word;
+        }
+    }
+
+    [[nodiscard]] inline std::uint32_t little_endian(std::uint32_t word) noexcept {
+        if constexpr (std::endian::native == std::endian::big) {
+            return byte_swap(word);
+        } else {
+            return word;
+        }
+    }
+
+    /**
+     * Copies count values of Size bytes from in to out reversing the bytes of each; in may equal out.
+     */
+    template <std::size_t Size>
+    void byte_swap_copy(const void* in, void* out, std::size_t count) noexcept {
+        const auto* source = static_cast<const std::uint8_t*>(in);
+        auto* target = static_cast<std::uint8_t*>(out);
+        const std::size_t bytes = count * Size;
+        std::size_t i = 0;
+#if defined(HOPE_SERIALIZATION_SSE41)
+        // reverses every Size byte group of a 16 byte lane
+        const __m128i reverse = Size == 2 ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+            : Size == 4 ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+                        : _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+#if defined(HOPE_SERIALIZATION_AVX2)
+        const __m256i reverse256 = _mm256_broadcastsi128_si256(reverse);
+        for (; i + 32 <= bytes; i += 32) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), _mm256_shuffle_epi8(x, reverse256));
+        }
+#endif
+        for (; i + 16 <= bytes; i += 16) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_shuffle_epi8(x, reverse));
+        }
+#elif defined(HOPE_SERIALIZATION_SSE2)
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+            if constexpr (Size == 4) {
+                x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+            } else if constexpr (Size == 8) {
+                x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0x1b), 0x1b);
+            }
+            x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), x);
+        }
+#elif defined(__ARM_NEON)
+        for (; i + 16 <= bytes; i += 16) {
+            const uint8x16_t x = vld1q_u8(source + i);
+            if constexpr (Size == 2) {
+                vst1q_u8(target + i, vrev16q_u8(x));
+            } else if constexpr (Size == 4) {
+                vst1q_u8(target + i, vrev32q_u8(x));
+            } else {
+                vst1q_u8(target + i, vrev64q_u8(x));
+            }
+        }
+#endif
+        using word_type = swap_word_t<Size>;
+        for (; i < bytes; i += Size) {
+            word_type word;
+            std::memcpy(&word, source + i, Size);
+            word = byte_swap(word);
+            std::memcpy(target + i, &word, Size);
+        }
+    }
+
+}
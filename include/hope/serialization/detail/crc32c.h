@@ -0,0 +1,158 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/simd.h"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * CRC-32C (Castagnoli) kernels on the raw CRC register, i.e. without the initial and final inversion. The
+ * crc32 instruction of SSE4.2 and ARMv8 does eight bytes per call; long inputs run three independent
+ * streams at once to hide its latency and merge them by multiplying with powers of x modulo the
+ * polynomial. Without the instruction, slicing-by-8 tables give the same result.
+ */
+namespace hope::serialization::detail {
+
+    /**
+     * The Castagnoli polynomial, bit reflected: x^0 is the most significant bit.
+     */
+    inline constexpr std::uint32_t crc32c_polynomial = 0x82f63b78;
+
+    /**
+     * a * b modulo the polynomial, both bit reflected.
+     */
+    [[nodiscard]] constexpr std::uint32_t crc32c_multiply(std::uint32_t a, std::uint32_t b) noexcept {
+        std::uint32_t product = 0;
+        for (int bit = 31; bit >= 0; --bit) {
+            product ^= b & (0u - ((a >> bit) & 1));
+            b = (b >> 1) ^ (crc32c_polynomial & (0u - (b & 1)));
+        }
+        return product;
+    }
+
+    /**
+     * x^(2^k) modulo the polynomial; the powers repeat with a period dividing 2^32 - 1, so 32 suffice.
+     */
+    inline constexpr auto crc32c_powers = [] {
+        std::array<std::uint32_t, 32> powers{};
+        std::uint32_t power = std::uint32_t{ 1 } << 30; // x^1
+        for (auto& entry : powers) {
+            entry = power;
+            power = crc32c_multiply(power, power);
+        }
+        return powers;
+    }();
+
+    /**
+     * x^(8 * bytes) modulo the polynomial: multiplying a CRC register by it appends that many zero bytes.
+     */
+    [[nodiscard]] constexpr std::uint32_t crc32c_shift(std::uint64_t bytes) noexcept {
+        std::uint32_t power = std::uint32_t{ 1 } << 31; // x^0
+        for (std::size_t k = 3; bytes != 0; bytes >>= 1, ++k) {
+            if (bytes & 1) {
+                power = crc32c_multiply(crc32c_powers[k & 31], power);
+            }
+        }
+        return power;
+    }
+
+#if defined(HOPE_SERIALIZATION_SSE42) || defined(HOPE_SERIALIZATION_ARM_CRC32)
+
+    /**
+     * Bytes per stream and round of the three stream loop; large enough that the two multiplications
+     * merging a round cost a few percent of it.
+     */
+    inline constexpr std::size_t crc32c_lane_size = 4096;
+
+    [[nodiscard]] inline std::uint32_t crc32c_word(std::uint32_t crc, const std::uint8_t* data) noexcept {
+        std::uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+#if defined(HOPE_SERIALIZATION_ARM_CRC32)
+        return __crc32cd(crc, word);
+#elif defined(__x86_64__) || defined(_M_X64)
+        return static_cast<std::uint32_t>(_mm_crc32_u64(crc, word));
+#else
+        crc = _mm_crc32_u32(crc, static_cast<std::uint32_t>(word));
+        return _mm_crc32_u32(crc, static_cast<std::uint32_t>(word >> 32));
+#endif
+    }
+
+    [[nodiscard]] inline std::uint32_t crc32c_byte(std::uint32_t crc, std::uint8_t byte) noexcept {
+#if defined(HOPE_SERIALIZATION_ARM_CRC32)
+        return __crc32cb(crc, byte);
+#else
+        return _mm_crc32_u8(crc, byte);
+#endif
+    }
+
+    [[nodiscard]] inline std::uint32_t crc32c_update(std::uint32_t crc, const std::uint8_t* data, std::size_t size) noexcept {
+        static_assert(std::endian::native == std::endian::little, "hope::serialization: crc32 words are loaded little endian");
+        if (size >= 3 * crc32c_lane_size) {
+            constexpr std::uint32_t shift_one = crc32c_shift(crc32c_lane_size);
+            constexpr std::uint32_t shift_two = crc32c_shift(2 * crc32c_lane_size);
+            do {
+                std::uint32_t second = 0;
+                std::uint32_t third = 0;
+                for (std::size_t i = 0; i < crc32c_lane_size; i += 8) {
+                    crc = crc32c_word(crc, data + i);
+                    second = crc32c_word(second, data + crc32c_lane_size + i);
+                    third = crc32c_word(third, data + 2 * crc32c_lane_size + i);
+                }
+                crc = crc32c_multiply(shift_two, crc) ^ crc32c_multiply(shift_one, second) ^ third;
+                data += 3 * crc32c_lane_size;
+                size -= 3 * crc32c_lane_size;
+            } while (size >= 3 * crc32c_lane_size);
+        }
+        for (; size >= 8; data += 8, size -= 8) {
+            crc = crc32c_word(crc, data);
+        }
+        for (; size != 0; ++data, --size) {
+            crc = crc32c_byte(crc, *data);
+        }
+        return crc;
+    }
+
+#else
+
+    inline constexpr auto crc32c_tables = [] {
+        std::array<std::array<std::uint32_t, 256>, 8> tables{};
+        for (std::uint32_t byte = 0; byte < 256; ++byte) {
+            std::uint32_t crc = byte;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (crc32c_polynomial & (0u - (crc & 1)));
+            }
+            tables[0][byte] = crc;
+        }
+        for (std::size_t slice = 1; slice < tables.size(); ++slice) {
+            for (std::size_t byte = 0; byte < 256; ++byte) {
+                const std::uint32_t previous = tables[slice - 1][byte];
+                tables[slice][byte] = (previous >> 8) ^ tables[0][previous & 0xff];
+            }
+        }
+        return tables;
+    }();
+
+    [[nodiscard]] inline std::uint32_t crc32c_update(std::uint32_t crc, const std::uint8_t* data, std::size_t size) noexcept {
+        const auto& t = crc32c_tables;
+        for (; size >= 8; data += 8, size -= 8) {
+            const std::uint32_t low = crc ^ (std::uint32_t{ data[0] } | std::uint32_t{ data[1] } << 8
+                                                | std::uint32_t{ data[2] } << 16 | std::uint32_t{ data[3] } << 24);
+            crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24]
+                ^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        }
+        for (; size != 0; ++data, --size) {
+            crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+        }
+        return crc;
+    }
+
+#endif
+
+}
@@ -0,0 +1,68 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/simd.h"
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+namespace hope::serialization::detail {
+
+    /**
+     * In place inclusive prefix sum with wrap-around: values[i] becomes start + values[0] + ... + values[i].
+     * 32 and 64 bit lanes are summed with log-step shifts inside a vector and a broadcast carry between
+     * vectors, four (eight with AVX2) 32 bit or two 64 bit values per step.
+     */
+    template <std::unsigned_integral T>
+    void prefix_sum(T* values, std::size_t count, T start) noexcept {
+        std::size_t i = 0;
+#if defined(HOPE_SERIALIZATION_AVX2)
+        if constexpr (sizeof(T) == 4) {
+            __m256i carry = _mm256_set1_epi32(static_cast<int>(start));
+            for (; i + 8 <= count; i += 8) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+                x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+                x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+                // the low lane's total goes into every element of the high lane
+                x = _mm256_add_epi32(x, _mm256_permute2x128_si256(_mm256_shuffle_epi32(x, 0xff), x, 0x08));
+                x = _mm256_add_epi32(x, carry);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), x);
+                carry = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+            }
+            start = i == 0 ? start : values[i - 1];
+        }
+#endif
+#if defined(HOPE_SERIALIZATION_SSE41)
+        if constexpr (sizeof(T) == 4) {
+            __m128i carry = _mm_set1_epi32(static_cast<int>(start));
+            for (; i + 4 <= count; i += 4) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+                x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+                x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+                x = _mm_add_epi32(x, carry);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), x);
+                carry = _mm_shuffle_epi32(x, 0xff);
+            }
+        } else if constexpr (sizeof(T) == 8) {
+            __m128i carry = _mm_set1_epi64x(static_cast<long long>(start));
+            for (; i + 2 <= count; i += 2) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+                x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+                x = _mm_add_epi64(x, carry);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), x);
+                carry = _mm_unpackhi_epi64(x, x);
+            }
+        }
+        start = i == 0 ? start : values[i - 1];
+#endif
+        for (; i < count; ++i) {
+            start = static_cast<T>(start + values[i]);
+            values[i] = start;
+        }
+    }
+
+}
@@ -0,0 +1,33 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+// Kernels are selected at compile time from the target flags (-msse4.1, -mavx2, -march=native, ...);
+// without them every kernel has a scalar fallback producing identical output.
+
+#if defined(__AVX2__)
+#define HOPE_SERIALIZATION_AVX2 1
+#endif
+
+#if defined(__SSE4_2__)
+#define HOPE_SERIALIZATION_SSE42 1
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX2__) || defined(HOPE_SERIALIZATION_SSE42)
+#define HOPE_SERIALIZATION_SSE41 1
+#endif
+
+#if defined(__SSE2__) || defined(HOPE_SERIALIZATION_SSE41)
+#define HOPE_SERIALIZATION_SSE2 1
+#endif
+
+#if defined(HOPE_SERIALIZATION_SSE2)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#define HOPE_SERIALIZATION_ARM_CRC32 1
+#include <arm_acle.h>
+#endif
@@ -0,0 +1,201 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/simd.h"
+#include "hope/serialization/varint.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Stream VByte (Lemire et al.) for 32 bit integers. Values are grouped in blocks of block_size: the two bit
+ * length codes of a block come first, four per control byte, followed by the little endian value bytes.
+ * Decoding turns every control byte into a pshufb mask, so four values are expanded per shuffle with no
+ * data-dependent branches. Blocks keep the control bytes next to their data and bound the scratch space
+ * needed by streams that cannot be read in place.
+ */
+namespace hope::serialization::detail::stream_vbyte {
+
+    inline constexpr std::size_t block_size = 64;
+    inline constexpr std::size_t max_block_bytes = block_size / 4 + block_size * 4;
+
+    /**
+     * Decoders load 16 bytes per control byte; scratch buffers are padded so a block can be decoded with SIMD.
+     */
+    inline constexpr std::size_t decode_padding = 32;
+
+    struct lookup_tables final {
+        std::array<std::uint8_t, 256> length{};
+        alignas(16) std::array<std::array<std::uint8_t, 16>, 256> shuffle{};
+    };
+
+    constexpr lookup_tables make_tables() noexcept {
+        lookup_tables tables;
+        for (std::size_t control = 0; control < 256; ++control) {
+            std::uint8_t offset = 0;
+            for (std::size_t value = 0; value < 4; ++value) {
+                const auto length = static_cast<std::uint8_t>(((control >> (2 * value)) & 3) + 1);
+                for (std::size_t byte = 0; byte < 4; ++byte) {
+                    tables.shuffle[control][4 * value + byte] = byte < length ? static_cast<std::uint8_t>(offset + byte) : 0x80;
+                }
+                offset = static_cast<std::uint8_t>(offset + length);
+            }
+            tables.length[control] = offset;
+        }
+        return tables;
+    }
+
+    inline constexpr lookup_tables tables = make_tables();
+
+    template <typename T>
+    concept element = std::is_integral_v<T> && sizeof(T) == 4;
+
+    template <element T>
+    [[nodiscard]] constexpr std::uint32_t to_wire(T value) noexcept {
+        if constexpr (std::is_signed_v<T>) {
+            return zigzag_encode(static_cast<std::int32_t>(value));
+        } else {
+            return static_cast<std::uint32_t>(value);
+        }
+    }
+
+    template <element T>
+    [[nodiscard]] constexpr T from_wire(std::uint32_t value) noexcept {
+        if constexpr (std::is_signed_v<T>) {
+            return static_cast<T>(zigzag_decode(value));
+        } else {
+            return static_cast<T>(value);
+        }
+    }
+
+    /**
+     * Encodes count <= block_size values; out needs max_block_bytes. Returns the bytes written.
+     */
+    template <element T>
+    std::size_t encode_block(const T* in, std::size_t count, std::uint8_t* out) noexcept {
+        std::uint8_t* control = out;
+        std::uint8_t* data = out + (count + 3) / 4;
+        for (std::size_t quad = 0; quad < count; quad += 4) {
+            std::uint8_t codes = 0;
+            const std::size_t end = quad + 4 < count ? quad + 4 : count;
+            for (std::size_t i = quad; i < end; ++i) {
+                std::uint32_t value = to_wire(in[i]);
+                const auto length = static_cast<std::uint8_t>((value > 0xff) + (value > 0xffff) + (value > 0xffffff));
+                codes = static_cast<std::uint8_t>(codes | (length << (2 * (i - quad))));
+                for (std::size_t byte = 0; byte <= length; ++byte) {
+                    *data++ = static_cast<std::uint8_t>(value);
+                    value >>= 8;
+                }
+            }
+            *control++ = codes;
+        }
+        return static_cast<std::size_t>(data - out);
+    }
+
+    /**
+     * Data bytes of one value, without its share of the control bytes.
+     */
+    template <element T>
+    [[nodiscard]] constexpr std::size_t value_size(T value) noexcept {
+        const std::uint32_t wire = to_wire(value);
+        return 1 + static_cast<std::size_t>(wire > 0xff) + (wire > 0xffff) + (wire > 0xffffff);
+    }
+
+    /**
+     * Bytes the blocks for count values take: the control bytes (blocks are multiples of four values, so
+     * they add up to one per four values) plus one to four bytes per value.
+     */
+    template <element T>
+    [[nodiscard]] constexpr std::size_t encoded_size(const T* values, std::size_t count) noexcept {
+        std::size_t size = (count + 3) / 4;
+        for (std::size_t i = 0; i < count; ++i) {
+            size += value_size(values[i]);
+        }
+        return size;
+    }
+
+    /**
+     * Number of value bytes described by the control bytes of a block of count values.
+     */
+    inline std::size_t data_size(const std::uint8_t* control, std::size_t count) noexcept {
+        std::size_t size = 0;
+        const std::size_t quads = count / 4;
+        for (std::size_t quad = 0; quad < quads; ++quad) {
+            size += tables.length[control[quad]];
+        }
+        for (std::size_t i = quads * 4; i < count; ++i) {
+            size += ((control[quads] >> (2 * (i - quads * 4))) & 3) + 1;
+        }
+        return size;
+    }
+
+    /**
+     * Decodes a block of count values from [in, end). Returns the bytes consumed, 0 when the block is truncated.
+     * SIMD is used while 16 (32 for AVX2) bytes can be loaded without leaving [in, end).
+     */
+    template <element T>
+    std::size_t decode_block(const std::uint8_t* in, const std::uint8_t* end, std::size_t count, T* out) noexcept {
+        const std::size_t control_size = (count + 3) / 4;
+        const auto available = static_cast<std::size_t>(end - in);
+        if (control_size > available) {
+            return 0;
+        }
+        const std::uint8_t* control = in;
+        const std::uint8_t* data = in + control_size;
+        const std::size_t size = control_size + data_size(control, count);
+        if (size > available) {
+            return 0;
+        }
+        [[maybe_unused]] const std::size_t quads = count / 4;
+        std::size_t quad = 0;
+#if defined(HOPE_SERIALIZATION_AVX2)
+        for (; quad + 2 <= quads && end - data >= 32; quad += 2) {
+            const std::uint8_t first = control[quad];
+            const std::uint8_t second = control[quad + 1];
+            const __m256i bytes = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + tables.length[first])), 1);
+            const __m256i mask = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(tables.shuffle[first].data()))),
+                _mm_load_si128(reinterpret_cast<const __m128i*>(tables.shuffle[second].data())), 1);
+            __m256i values = _mm256_shuffle_epi8(bytes, mask);
+            if constexpr (std::is_signed_v<T>) {
+                values = _mm256_xor_si256(_mm256_srli_epi32(values, 1),
+                    _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(values, _mm256_set1_epi32(1))));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * quad), values);
+            data += tables.length[first] + tables.length[second];
+        }
+#endif
+#if defined(HOPE_SERIALIZATION_SSE41)
+        for (; quad < quads && end - data >= 16; ++quad) {
+            const std::uint8_t codes = control[quad];
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.shuffle[codes].data()));
+            __m128i values = _mm_shuffle_epi8(bytes, mask);
+            if constexpr (std::is_signed_v<T>) {
+                values = _mm_xor_si128(_mm_srli_epi32(values, 1),
+                    _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(values, _mm_set1_epi32(1))));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * quad), values);
+            data += tables.length[codes];
+        }
+#endif
+        for (std::size_t i = quad * 4; i < count; ++i) {
+            const std::size_t length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+            std::uint32_t value = 0;
+            for (std::size_t byte = 0; byte < length; ++byte) {
+                value |= static_cast<std::uint32_t>(data[byte]) << (8 * byte);
+            }
+            out[i] = from_wire<T>(value);
+            data += length;
+        }
+        return size;
+    }
+
+}
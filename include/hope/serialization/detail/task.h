@@ -0,0 +1,242 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <utility>
+
+namespace hope::serialization::detail {
+
+    /**
+     * Recycles the coroutine frames of one owner. Frames are binned by size in steps of granularity; a freed
+     * frame goes on the free list of its bin, so a warmed up decoder allocates nothing per message.
+     */
+    class frame_pool final {
+    public:
+        frame_pool() = default;
+        frame_pool(const frame_pool&) = delete;
+        frame_pool& operator=(const frame_pool&) = delete;
+
+        ~frame_pool() {
+            for (auto*& head : free_) {
+                while (head != nullptr) {
+                    ::operator delete(std::exchange(head, head->next));
+                }
+            }
+        }
+
+        [[nodiscard]] void* allocate(std::size_t size) {
+            const std::size_t bin = bin_of(size);
+            if (bin >= bins) {
+                return ::operator new(size);
+            }
+            if (free_[bin] != nullptr) {
+                return std::exchange(free_[bin], free_[bin]->next);
+            }
+            return ::operator new((bin + 1) * granularity);
+        }
+
+        void deallocate(void* frame, std::size_t size) noexcept {
+            const std::size_t bin = bin_of(size);
+            if (bin >= bins) {
+                ::operator delete(frame);
+                return;
+            }
+            free_[bin] = ::new (frame) node{ free_[bin] };
+        }
+
+    private:
+        static constexpr std::size_t granularity = 64;
+        static constexpr std::size_t bins = 64;
+
+        struct node final {
+            node* next;
+        };
+
+        static constexpr std::size_t bin_of(std::size_t size) noexcept { return (size - 1) / granularity; }
+
+        std::array<node*, bins> free_{};
+    };
+
+    [[nodiscard]] inline frame_pool& thread_frames() noexcept {
+        thread_local frame_pool frames;
+        return frames;
+    }
+
+    /**
+     * Base of classes whose member coroutines allocate their frames from a frame_pool.
+     */
+    class frame_owner {
+    public:
+        [[nodiscard]] frame_pool& frames() noexcept { return frames_; }
+
+    private:
+        frame_pool frames_;
+    };
+
+    /**
+     * Lazily started coroutine returning nothing. Awaiting a task runs it and resumes the awaiter once it
+     * finishes (by symmetric transfer, so deep nesting does not grow the stack); exceptions propagate to the
+     * awaiter. Member coroutines of a frame_owner, and coroutines whose first parameter is one, take their
+     * frames from its pool, any other coroutine from a pool of the thread.
+     */
+    class [[nodiscard]] task final {
+    public:
+        struct promise_base {
+            std::coroutine_handle<> continuation{ std::noop_coroutine() };
+            std::exception_ptr exception;
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            auto final_suspend() noexcept {
+                struct resume_continuation final {
+                    std::coroutine_handle<> continuation;
+
+                    bool await_ready() noexcept { return false; }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept { return continuation; }
+
+                    void await_resume() noexcept {}
+                };
+                return resume_continuation{ continuation };
+            }
+
+            void return_void() noexcept {}
+
+            void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+        protected:
+            /**
+             * The pool and the size taken from it are stored in front of the frame so the frame can find its
+             * way back. Frames of the thread's pool have null in the header: a frame destroyed on another
+             * thread goes to that thread's pool.
+             */
+            [[nodiscard]] static void* allocate_frame(std::size_t size, frame_pool* pool) {
+                frame_pool& frames = pool != nullptr ? *pool : thread_frames();
+                auto* memory = static_cast<std::byte*>(frames.allocate(size + header_size));
+                ::new (memory) frame_header{ pool, size + header_size };
+                return memory + header_size;
+            }
+
+            static void deallocate_frame(void* frame) noexcept {
+                auto* memory = static_cast<std::byte*>(frame) - header_size;
+                const frame_header header = *std::launder(reinterpret_cast<frame_header*>(memory));
+                (header.pool != nullptr ? *header.pool : thread_frames()).deallocate(memory, header.size);
+            }
+
+            template <typename First, typename... Rest>
+            [[nodiscard]] static frame_pool* pool_of(First& first, Rest&...) noexcept {
+                if constexpr (std::derived_from<First, frame_owner>) {
+                    return &first.frames();
+                } else {
+                    return nullptr;
+                }
+            }
+
+            [[nodiscard]] static frame_pool* pool_of() noexcept { return nullptr; }
+
+        private:
+            struct frame_header final {
+                frame_pool* pool;
+                std::size_t size;
+            };
+
+            static constexpr std::size_t header_size = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+            static_assert(sizeof(frame_header) <= header_size);
+        };
+
+        /**
+         * Promise of a coroutine with parameters Params, the object first for a member coroutine; chosen by
+         * the std::coroutine_traits specialization below. Its operator new takes exactly those parameters
+         * instead of being a template, so each coroutine allocates and frees its frame through a matching
+         * pair of one class.
+         */
+        template <typename... Params>
+        struct promise final : promise_base {
+            task get_return_object() noexcept { return task(std::coroutine_handle<promise>::from_promise(*this), *this); }
+
+            static void* operator new(std::size_t size, Params&... params) {
+                return allocate_frame(size, pool_of(params...));
+            }
+
+            static void operator delete(void* frame) noexcept { deallocate_frame(frame); }
+        };
+
+        task() noexcept = default;
+
+        task(task&& other) noexcept
+            : handle_(std::exchange(other.handle_, nullptr))
+            , promise_(std::exchange(other.promise_, nullptr)) {}
+
+        task& operator=(task&& other) noexcept {
+            if (this != &other) {
+                destroy();
+                handle_ = std::exchange(other.handle_, nullptr);
+                promise_ = std::exchange(other.promise_, nullptr);
+            }
+            return *this;
+        }
+
+        ~task() { destroy(); }
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+            promise_->continuation = awaiter;
+            return handle_;
+        }
+
+        void await_resume() const {
+            if (promise_->exception) {
+                std::rethrow_exception(promise_->exception);
+            }
+        }
+
+        [[nodiscard]] std::coroutine_handle<> handle() const noexcept { return handle_; }
+
+        [[nodiscard]] bool done() const noexcept { return handle_ == nullptr || handle_.done(); }
+
+        /**
+         * Runs a top-level task until it first suspends or finishes; rethrows what escaped it.
+         */
+        void start() {
+            handle_.resume();
+            rethrow();
+        }
+
+        void rethrow() const {
+            if (handle_ != nullptr && handle_.done() && promise_->exception) {
+                std::rethrow_exception(promise_->exception);
+            }
+        }
+
+    private:
+        task(std::coroutine_handle<> handle, promise_base& promise) noexcept
+            : handle_(handle)
+            , promise_(&promise) {}
+
+        void destroy() noexcept {
+            if (handle_ != nullptr) {
+                promise_ = nullptr;
+                std::exchange(handle_, nullptr).destroy();
+            }
+        }
+
+        std::coroutine_handle<> handle_{ nullptr };
+        promise_base* promise_{ nullptr };
+    };
+
+}
+
+template <typename... Params>
+struct std::coroutine_traits<hope::serialization::detail::task, Params...> {
+    using promise_type = hope::serialization::detail::task::promise<Params...>;
+};
@@ -0,0 +1,19 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include <stdexcept>
+
+namespace hope::serialization {
+
+    /**
+     * Thrown on malformed or truncated input and on values that cannot be represented on the wire.
+     */
+    class error final : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+}
@@ -0,0 +1,61 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace hope::serialization {
+
+    enum class integer_encoding : std::uint8_t {
+        fixed,  ///< integers and length prefixes keep their in-memory width
+        varint, ///< LEB128, zigzag for signed values; vectors of 32 bit integers use Stream VByte blocks
+    };
+
+    enum class struct_layout : std::uint8_t {
+        frozen, ///< fields back to back in declaration order; both ends must share the exact schema
+        tagged, ///< every field carries its id and wire type; unknown fields are skipped, missing ones reset
+    };
+
+    enum class sequence_layout : std::uint8_t {
+        rows,    ///< elements one after another
+        columns, ///< sequences of reflected records are written field by field, each field as one column;
+                 ///< applies to the frozen struct layout, tagged records stay rows
+    };
+
+    enum class bool_encoding : std::uint8_t {
+        byte, ///< one byte per bool
+        bit,  ///< one bit: packed with neighbouring bit fields of a record, eight per byte in arrays
+    };
+
+    enum class byte_order : std::uint8_t {
+        native, ///< whatever the host uses; fastest, for peers known to share it
+        little, ///< multi-byte scalars are little endian on the wire, swapped on big endian hosts
+        big,    ///< multi-byte scalars are big endian on the wire, swapped on little endian hosts
+    };
+
+    /**
+     * Wire format options, passed to writer/reader as a template argument so the choice
+     * costs nothing at run time. Both ends must use the same format.
+     */
+    struct format final {
+        integer_encoding integers{ integer_encoding::fixed };
+        struct_layout layout{ struct_layout::frozen };
+        sequence_layout sequences{ sequence_layout::rows };
+        bool_encoding bools{ bool_encoding::byte };
+        byte_order order{ byte_order::native };
+    };
+
+    [[nodiscard]] constexpr format with_layout(format base, struct_layout layout) noexcept {
+        base.layout = layout;
+        return base;
+    }
+
+    inline constexpr format fixed_format{};
+    inline constexpr format varint_format{ .integers = integer_encoding::varint };
+    inline constexpr format columnar_format{ .integers = integer_encoding::varint, .sequences = sequence_layout::columns };
+    inline constexpr format packed_format{ .integers = integer_encoding::varint, .bools = bool_encoding::bit };
+    inline constexpr format tagged_format{ .integers = integer_encoding::varint, .layout = struct_layout::tagged };
+
+}
@@ -0,0 +1,302 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/crc32c.h"
+#include "hope/serialization/detail/byte_swap.h"
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/reader.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/varint.h"
+#include "hope/serialization/writer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <vector>
+
+/**
+ * Frames batch many small messages behind one header so a burst goes out in a single write:
+ *
+ *     varint frame length (bytes after this prefix)
+ *     varint message count
+ *     varint length of every message
+ *     the messages, back to back
+ *     u32 CRC-32C of the bytes after the length prefix, little endian, only with frame_integrity::crc32c
+ *
+ * Each message is an ordinary encoding of writer<Stream, Format>.
+ */
+namespace hope::serialization {
+
+    /**
+     * Whether frames end with a checksum; both peers must agree. The trailer is counted in the frame
+     * length, so frame_size() and compression envelopes work either way.
+     */
+    enum class frame_integrity : std::uint8_t {
+        none,
+        crc32c,
+    };
+
+    namespace detail {
+
+        inline constexpr std::size_t frame_trailer_size = 4;
+
+    }
+
+    /**
+     * Largest frame length frame_size() accepts unless it is given another limit.
+     */
+    inline constexpr std::size_t default_max_frame_size = std::size_t{ 1 } << 28;
+
+    /**
+     * Collects messages into the next frame. Memory is reused from frame to frame.
+     *
+     *     frame_writer<varint_format> frame;
+     *     for (const auto& event : burst) frame.add(event);
+     *     frame.flush(socket_stream); // header and body, two writes
+     */
+    template <format Format = format{}>
+    class frame_writer final {
+    public:
+        explicit frame_writer(frame_integrity integrity = frame_integrity::none) noexcept
+            : integrity_(integrity) {}
+
+        /**
+         * Appends message to the frame. If encoding it throws, the frame is left as it was.
+         */
+        template <typename T>
+        void add(const T& message) {
+            const std::size_t before = body_.size();
+            try {
+                writer<output_buffer, Format>(body_).write(message);
+                lengths_.push_back(body_.size() - before);
+            } catch (...) {
+                body_.truncate(before);
+                throw;
+            }
+        }
+
+        [[nodiscard]] std::size_t count() const noexcept { return lengths_.size(); }
+        [[nodiscard]] bool empty() const noexcept { return lengths_.empty(); }
+
+        /**
+         * Bytes of encoded messages so far, without the header; lets callers cap frames by size.
+         */
+        [[nodiscard]] std::size_t body_size() const noexcept { return body_.size(); }
+
+        [[nodiscard]] frame_integrity integrity() const noexcept { return integrity_; }
+
+        /**
+         * Writes the frame and starts a new one. Nothing is written for an empty frame. If the stream throws,
+         * the frame keeps its messages and can be flushed again.
+         */
+        template <output_stream Stream>
+        void flush(Stream& stream) {
+            if (empty()) {
+                return;
+            }
+            header_.clear();
+            std::size_t lengths_size = varint_size(lengths_.size());
+            for (const auto length : lengths_) {
+                lengths_size += varint_size(length);
+            }
+            const std::size_t trailer_size = integrity_ == frame_integrity::crc32c ? detail::frame_trailer_size : 0;
+            std::uint8_t* out = header_.prepare(max_varint_size + lengths_size);
+            std::uint8_t* cursor = out;
+            cursor += encode_varint(lengths_size + body_.size() + trailer_size, cursor);
+            std::uint8_t* const lengths = cursor;
+            cursor += encode_varint(lengths_.size(), cursor);
+            for (const auto length : lengths_) {
+                cursor += encode_varint(length, cursor);
+            }
+            header_.commit(static_cast<std::size_t>(cursor - out));
+            const std::size_t messages_size = body_.size();
+            try {
+                if (trailer_size != 0) {
+                    // appended to the body so the frame still goes out in two writes
+                    const std::uint32_t crc = crc32c(body_.view(), crc32c({ lengths, cursor }));
+                    const std::uint32_t trailer = detail::little_endian(crc);
+                    body_.write(&trailer, sizeof(trailer));
+                }
+                stream.write(header_.data(), header_.size());
+                stream.write(body_.data(), body_.size());
+            } catch (...) {
+                // the messages stay for the next flush, the trailer is computed again then
+                body_.truncate(messages_size);
+                throw;
+            }
+            clear();
+        }
+
+        /**
+         * Drops the messages added since the last flush.
+         */
+        void clear() noexcept {
+            body_.clear();
+            lengths_.clear();
+        }
+
+    private:
+        frame_integrity integrity_;
+        output_buffer body_;
+        output_buffer header_;
+        std::vector<std::size_t> lengths_;
+    };
+
+    /**
+     * Total size of the frame at the front of bytes, length prefix included, or 0 while the prefix itself
+     * is incomplete; tells a receiver how much to accumulate before building a frame_view. The length comes
+     * from the peer, so one above max_length throws instead of having the receiver buffer it.
+     */
+    [[nodiscard]] inline std::size_t frame_size(std::span<const std::uint8_t> bytes,
+        std::size_t max_length = default_max_frame_size) {
+        std::uint64_t length;
+        const std::size_t prefix = decode_varint(bytes.data(), bytes.data() + bytes.size(), length);
+        if (prefix == 0) {
+            if (bytes.size() >= max_varint_size) [[unlikely]] {
+                throw error("hope::serialization: malformed frame length");
+            }
+            return 0;
+        }
+        if (length > max_length) [[unlikely]] {
+            throw error("hope::serialization: frame exceeds the size limit");
+        }
+        return prefix + static_cast<std::size_t>(length);
+    }
+
+    /**
+     * Read-only view of one frame; iterating yields every message as a span into the frame, nothing is copied.
+     * The header is validated once on construction, iteration itself does no checks.
+     *
+     *     for (auto message : frame_view(bytes)) {
+     *         auto event = deserialize<event_t, varint_format>(message);
+     *     }
+     */
+    class frame_view final {
+    public:
+        class iterator final {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::span<const std::uint8_t>;
+            using difference_type = std::ptrdiff_t;
+            using reference = value_type;
+
+            iterator() = default;
+
+            value_type operator*() const noexcept { return { message_, length_ }; }
+
+            iterator& operator++() noexcept {
+                message_ += length_;
+                ++index_;
+                load();
+                return *this;
+            }
+
+            iterator operator++(int) noexcept {
+                auto copy = *this;
+                ++*this;
+                return copy;
+            }
+
+            friend bool operator==(const iterator& left, const iterator& right) noexcept { return left.index_ == right.index_; }
+
+        private:
+            friend class frame_view;
+
+            iterator(const std::uint8_t* lengths, const std::uint8_t* message, std::size_t index, std::size_t count) noexcept
+                : lengths_(lengths)
+                , message_(message)
+                , index_(index)
+                , count_(count) {
+                load();
+            }
+
+            void load() noexcept {
+                if (index_ < count_) {
+                    std::uint64_t length;
+                    lengths_ += decode_varint(lengths_, lengths_ + max_varint_size, length);
+                    length_ = static_cast<std::size_t>(length);
+                }
+            }
+
+            const std::uint8_t* lengths_{ nullptr };
+            const std::uint8_t* message_{ nullptr };
+            std::size_t index_{ 0 };
+            std::size_t count_{ 0 };
+            std::size_t length_{ 0 };
+        };
+
+        /**
+         * frame must start with a complete frame (see frame_size); bytes past it are ignored. With
+         * frame_integrity::crc32c the checksum is verified before the header is looked at.
+         */
+        explicit frame_view(std::span<const std::uint8_t> frame, frame_integrity integrity = frame_integrity::none) {
+            std::uint64_t length;
+            const std::size_t prefix = decode_varint(frame.data(), frame.data() + frame.size(), length);
+            if (prefix == 0 || length > frame.size() - prefix) [[unlikely]] {
+                throw error("hope::serialization: incomplete frame");
+            }
+            const std::uint8_t* cursor = frame.data() + prefix;
+            const std::uint8_t* end = cursor + length;
+            size_ = prefix + static_cast<std::size_t>(length);
+            if (integrity == frame_integrity::crc32c) {
+                if (length < detail::frame_trailer_size) [[unlikely]] {
+                    throw error("hope::serialization: frame too short for its checksum");
+                }
+                end -= detail::frame_trailer_size;
+                std::uint32_t trailer;
+                std::memcpy(&trailer, end, sizeof(trailer));
+                if (detail::little_endian(trailer) != crc32c({ cursor, end })) [[unlikely]] {
+                    throw error("hope::serialization: frame checksum mismatch");
+                }
+            }
+            std::uint64_t count;
+            const std::size_t count_size = decode_varint(cursor, end, count);
+            if (count_size == 0 || count > static_cast<std::size_t>(end - cursor)) [[unlikely]] {
+                throw error("hope::serialization: malformed frame header");
+            }
+            cursor += count_size;
+            lengths_ = cursor;
+            std::uint64_t total = 0;
+            for (std::uint64_t i = 0; i < count; ++i) {
+                std::uint64_t length;
+                const std::size_t length_size = decode_varint(cursor, end, length);
+                if (length_size == 0) [[unlikely]] {
+                    throw error("hope::serialization: malformed frame header");
+                }
+                cursor += length_size;
+                total += length;
+                if (total > static_cast<std::uint64_t>(end - cursor)) [[unlikely]] {
+                    throw error("hope::serialization: frame lengths exceed the frame");
+                }
+            }
+            if (total != static_cast<std::uint64_t>(end - cursor)) [[unlikely]] {
+                throw error("hope::serialization: frame lengths do not add up to the frame");
+            }
+            body_ = cursor;
+            count_ = static_cast<std::size_t>(count);
+        }
+
+        [[nodiscard]] std::size_t count() const noexcept { return count_; }
+
+        /**
+         * Bytes the frame occupies, length prefix included.
+         */
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+        [[nodiscard]] iterator begin() const noexcept { return { lengths_, body_, 0, count_ }; }
+        [[nodiscard]] iterator end() const noexcept { return { nullptr, nullptr, count_, count_ }; }
+
+    private:
+        const std::uint8_t* lengths_{ nullptr };
+        const std::uint8_t* body_{ nullptr };
+        std::size_t count_{ 0 };
+        std::size_t size_{ 0 };
+    };
+
+}
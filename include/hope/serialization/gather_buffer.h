@@ -0,0 +1,149 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/crc32c.h"
+#include "hope/serialization/stream.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#if __has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#endif
+
+namespace hope::serialization {
+
+#if __has_include(<sys/uio.h>)
+    using segment = ::iovec;
+#else
+    struct segment final {
+        void* iov_base;
+        std::size_t iov_len;
+    };
+#endif
+
+    /**
+     * Scatter-gather output for writev/sendmsg. Small writes are coalesced into an internal chunk; raw
+     * arrays and strings of at least reference_threshold bytes are not copied but become segments of their
+     * own pointing at the caller's memory, which must stay alive and unchanged until the segments are sent.
+     *
+     *     gather_buffer out;
+     *     writer<gather_buffer>(out).write(message);
+     *     auto parts = out.segments();
+     *     ::writev(fd, parts.data(), static_cast<int>(parts.size()));
+     */
+    class gather_buffer final {
+    public:
+        static constexpr std::size_t default_reference_threshold = 4096;
+
+        explicit gather_buffer(std::size_t reference_threshold = default_reference_threshold) noexcept
+            : threshold_(reference_threshold) {}
+
+        void write(const void* data, std::size_t size) {
+            chunk_.write(data, size);
+        }
+
+        [[nodiscard]] std::uint8_t* prepare(std::size_t size) {
+            return chunk_.prepare(size);
+        }
+
+        void commit(std::size_t size) noexcept { chunk_.commit(size); }
+
+        void write_reference(const void* data, std::size_t size) {
+            if (size == 0) {
+                return;
+            }
+            if (size < threshold_) {
+                chunk_.write(data, size);
+                return;
+            }
+            close_run();
+            parts_.push_back({ static_cast<const std::uint8_t*>(data), 0, size });
+            size_ += size;
+        }
+
+        /**
+         * The output in order, ready to be passed to writev. Valid until the next write or clear().
+         */
+        [[nodiscard]] std::span<const segment> segments() {
+            segments_.clear();
+            for (const auto& part : parts_) {
+                segments_.push_back(make_segment(part));
+            }
+            if (chunk_.size() != run_begin_) {
+                segments_.push_back(make_segment({ nullptr, run_begin_, chunk_.size() - run_begin_ }));
+            }
+            return segments_;
+        }
+
+        /**
+         * Total bytes written, copied and referenced.
+         */
+        [[nodiscard]] std::size_t size() const noexcept { return size_ + chunk_.size(); }
+
+        /**
+         * Bytes held in the internal chunk.
+         */
+        [[nodiscard]] std::size_t copied() const noexcept { return chunk_.size(); }
+
+        [[nodiscard]] std::size_t reference_threshold() const noexcept { return threshold_; }
+
+        /**
+         * Forgets the output and every reference; the internal chunk keeps its capacity.
+         */
+        void clear() noexcept {
+            chunk_.clear();
+            parts_.clear();
+            segments_.clear();
+            run_begin_ = 0;
+            size_ = 0;
+        }
+
+    private:
+        /**
+         * Either caller memory (external) or a range of the chunk; chunk ranges are kept as offsets because
+         * the chunk may still move while it grows.
+         */
+        struct part final {
+            const std::uint8_t* external;
+            std::size_t offset;
+            std::size_t size;
+        };
+
+        void close_run() {
+            if (chunk_.size() != run_begin_) {
+                parts_.push_back({ nullptr, run_begin_, chunk_.size() - run_begin_ });
+                run_begin_ = chunk_.size();
+            }
+        }
+
+        [[nodiscard]] segment make_segment(const part& part) const noexcept {
+            const std::uint8_t* base = part.external != nullptr ? part.external : chunk_.data() + part.offset;
+            return { const_cast<std::uint8_t*>(base), part.size };
+        }
+
+        output_buffer chunk_;
+        std::vector<part> parts_;
+        std::vector<segment> segments_;
+        std::size_t threshold_;
+        std::size_t run_begin_{ 0 };
+        std::size_t size_{ 0 };
+    };
+
+    /**
+     * CRC-32C of the segments in order, continuing crc like crc32c(bytes, crc). Referenced memory is read
+     * where it lives; a blob whose CRC is already known can be left out and merged with crc32c_combine.
+     */
+    [[nodiscard]] inline std::uint32_t crc32c(std::span<const segment> segments, std::uint32_t crc = 0) noexcept {
+        for (const auto& part : segments) {
+            crc = crc32c({ static_cast<const std::uint8_t*>(part.iov_base), part.iov_len }, crc);
+        }
+        return crc;
+    }
+
+}
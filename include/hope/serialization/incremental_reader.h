@@ -0,0 +1,876 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/bit_fields.h"
+#include "hope/serialization/detail/bit_pack.h"
+#include "hope/serialization/detail/stream_vbyte.h"
+#include "hope/serialization/detail/task.h"
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/reader.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/tagged.h"
+#include "hope/serialization/traits.h"
+#include "hope/serialization/varint.h"
+
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <tuple>
+#include <variant>
+
+namespace hope::serialization {
+
+    /**
+     * Bytes a message may take unless the incremental_reader is told otherwise.
+     */
+    inline constexpr std::size_t default_max_message_size = std::size_t{ 64 } << 20;
+
+    /**
+     * Decodes one T from bytes handed over in arbitrary chunks, as they come off a socket. feed() takes what
+     * it can and stops; needed() tells how many more bytes are required before decoding can move on.
+     * Strings and raw arrays are copied from the chunks straight into the target, only values that straddle
+     * two chunks (at most one Stream VByte block) are staged in a small internal buffer, so the encoded
+     * message is never buffered as a whole.
+     *
+     *     incremental_reader<message> decoder(msg);
+     *     while (!decoder.done()) {
+     *         auto chunk = socket.receive(); // any size
+     *         chunk = chunk.subspan(decoder.feed(chunk));
+     *     }
+     *
+     * Every rule of reader applies, except that views (string_view, span, array_view) and serializer
+     * specializations need the whole input at once and are rejected at compile time. Nested values are
+     * decoded by coroutines whose frames are recycled by the decoder; values whose bytes are already at
+     * hand are decoded without one.
+     *
+     * The peer decides the length prefixes, so they are not trusted: a message may take at most
+     * max_message_size bytes, a prefix announcing more elements than that leaves room for throws, and
+     * containers grow with the elements that actually arrive rather than being sized up front.
+     */
+    template <typename T, format Format = format{}>
+    class incremental_reader final : public detail::frame_owner {
+    public:
+        explicit incremental_reader(T& value, std::pmr::memory_resource* resource = nullptr,
+            std::size_t max_message_size = default_max_message_size)
+            : resource_(resource)
+            , max_message_size_(max_message_size) {
+            restart(value);
+        }
+
+        incremental_reader(const incremental_reader&) = delete;
+        incremental_reader& operator=(const incremental_reader&) = delete;
+
+        /**
+         * Starts over with a new target, e.g. for the next message on the connection. Staging memory and
+         * coroutine frames are kept.
+         */
+        void restart(T& value) {
+            root_ = detail::task();
+            carry_size_ = 0;
+            pending_ = 0;
+            hint_ = 0;
+            consumed_ = 0;
+            cursor_ = end_ = nullptr;
+            root_ = decode(value);
+            current_ = root_.handle();
+            // started by the first feed(), so a message that arrives whole never suspends
+            hint_ = static_serialized_size_v<T, Format> != dynamic_size ? static_serialized_size_v<T, Format> : 1;
+        }
+
+        /**
+         * Decodes as much as bytes allows and returns how many of them were used. Fewer than bytes.size()
+         * are used only when the message ends inside the chunk; the rest belongs to whatever follows.
+         * Throws error on malformed input, after which the decoder must be restarted.
+         */
+        std::size_t feed(std::span<const std::uint8_t> bytes) {
+            if (done()) {
+                return 0;
+            }
+            cursor_ = bytes.data();
+            end_ = cursor_ + bytes.size();
+            if (ensure(pending_)) {
+                resume();
+            }
+            const auto used = static_cast<std::size_t>(cursor_ - bytes.data());
+            cursor_ = end_ = nullptr;
+            if (consumed_ > max_message_size_) [[unlikely]] {
+                throw error("hope::serialization: message exceeds the size limit");
+            }
+            return used;
+        }
+
+        [[nodiscard]] bool done() const noexcept { return root_.done(); }
+
+        /**
+         * Lower bound on the bytes feed() needs before the decoder makes progress, 0 once done. Exact for
+         * fixed size values and raw blocks, 1 while a varint is incomplete.
+         */
+        [[nodiscard]] std::size_t needed() const noexcept {
+            if (done()) {
+                return 0;
+            }
+            return std::max(pending_ - std::min(pending_, carry_size_), hint_);
+        }
+
+        /**
+         * Bytes of the current message decoded so far.
+         */
+        [[nodiscard]] std::size_t consumed() const noexcept { return consumed_; }
+
+    private:
+        static constexpr std::size_t carry_capacity = 512;
+
+        static_assert(carry_capacity >= detail::stream_vbyte::max_block_bytes + detail::stream_vbyte::decode_padding);
+
+        /**
+         * Elements a container grows by while its bytes come in: about 64 KiB worth, and a whole number of
+         * Stream VByte and bit packing blocks so the writer's block boundaries are kept.
+         */
+        template <typename U>
+        static constexpr std::size_t growth_step = std::max(detail::column_block,
+            std::size_t{ 65536 } / sizeof(U) / detail::column_block * detail::column_block);
+
+        static_assert(detail::column_block % detail::bit_pack::block_size == 0);
+
+        /**
+         * Values the decoder can take synchronously once their bytes are at hand: fixed size encodings that
+         * fit the staging buffer, and varints.
+         */
+        template <typename U>
+        static constexpr bool immediate = detail::varint_integer<U, Format>
+            || (!detail::has_serializer<U> && static_serialized_size_v<U, Format> <= carry_capacity);
+
+        // input
+
+        /**
+         * Makes n contiguous bytes available at data(). Bytes are staged only when the chunk alone does not
+         * have them; returns false (having staged what there was) when more input is needed.
+         */
+        bool ensure(std::size_t n) {
+            if (carry_size_ == 0 && static_cast<std::size_t>(end_ - cursor_) >= n) {
+                return true;
+            }
+            if (carry_size_ < n) {
+                const std::size_t take = std::min(n - carry_size_, static_cast<std::size_t>(end_ - cursor_));
+                if (take != 0) {
+                    std::memcpy(carry_.data() + carry_size_, cursor_, take);
+                    carry_size_ += take;
+                    cursor_ += take;
+                }
+            }
+            return carry_size_ >= n;
+        }
+
+        [[nodiscard]] const std::uint8_t* data() const noexcept {
+            return carry_size_ != 0 ? carry_.data() : cursor_;
+        }
+
+        [[nodiscard]] std::size_t available() const noexcept {
+            return carry_size_ != 0 ? carry_size_ : static_cast<std::size_t>(end_ - cursor_);
+        }
+
+        void consume(std::size_t n) noexcept {
+            if (carry_size_ != 0) {
+                carry_size_ -= n;
+                std::memmove(carry_.data(), carry_.data() + n, carry_size_);
+            } else {
+                cursor_ += n;
+            }
+            consumed_ += n;
+        }
+
+        void resume() {
+            current_.resume();
+            root_.rethrow();
+        }
+
+        /**
+         * Suspends the decoding coroutine until n bytes can be made contiguous; hint is what needed() reports
+         * when it is more than that (the rest of a raw block).
+         */
+        struct need final {
+            incremental_reader& self;
+            std::size_t size;
+            std::size_t hint{ 0 };
+
+            bool await_ready() { return self.ensure(size); }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                self.current_ = handle;
+                self.pending_ = size;
+                self.hint_ = hint;
+            }
+
+            const std::uint8_t* await_resume() noexcept {
+                self.pending_ = 0;
+                self.hint_ = 0;
+                return self.data();
+            }
+        };
+
+        /**
+         * Awaitable decoding one value: synchronous when the value is immediate and its bytes are at hand,
+         * otherwise it transfers to a decode coroutine for the value.
+         */
+        template <typename U>
+        struct value_awaiter final {
+            incremental_reader& self;
+            U& value;
+            detail::task slow{};
+
+            bool await_ready() { return self.try_immediate(value); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) {
+                slow = self.decode(value);
+                return slow.await_suspend(handle);
+            }
+
+            void await_resume() const {
+                if (slow.handle() != nullptr) {
+                    slow.await_resume();
+                }
+            }
+        };
+
+        template <typename U>
+        value_awaiter<U> value(U& target) noexcept {
+            return { *this, target };
+        }
+
+        template <typename U>
+        bool try_immediate(U& target) {
+            if constexpr (detail::varint_integer<U, Format>) {
+                detail::varint_unsigned_t<U> bits;
+                const std::uint8_t* begin = data();
+                const std::size_t size = decode_varint(begin, begin + available(), bits);
+                if (size == 0) {
+                    if (available() >= max_varint_size_v<detail::varint_unsigned_t<U>>) [[unlikely]] {
+                        throw error("hope::serialization: malformed varint");
+                    }
+                    return false;
+                }
+                target = detail::from_varint<U>(bits);
+                consume(size);
+                return true;
+            } else if constexpr (immediate<U>) {
+                constexpr std::size_t size = static_serialized_size_v<U, Format>;
+                if (!ensure(size)) {
+                    return false;
+                }
+                input_buffer input(data(), size);
+                reader<input_buffer, Format>(input, resource_).read(target);
+                consume(size);
+                return true;
+            } else if constexpr (detail::raw_contiguous<U, Format> && !detail::columnar<U, Format>
+                && (detail::string_like<U> || detail::sequence_container<U>)) {
+                // the whole string or array may already be at hand; if not, nothing is consumed
+                std::size_t prefix;
+                std::size_t size;
+                if (!peek_size(prefix, size) || size > (available() - prefix) / sizeof(typename U::value_type)) {
+                    return false;
+                }
+                const std::size_t total = prefix + size * sizeof(typename U::value_type);
+                input_buffer input(data(), total);
+                reader<input_buffer, Format>(input, resource_).read(target);
+                consume(total);
+                return true;
+            } else if constexpr (detail::string_like<U> || detail::sequence_container<U> || detail::associative_container<U>) {
+                std::size_t prefix;
+                std::size_t size;
+                if (!peek_size(prefix, size) || size != 0) {
+                    return false;
+                }
+                if constexpr (detail::pmr_container<U>) {
+                    bind_resource(target);
+                }
+                target.clear();
+                consume(prefix);
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        /**
+         * Parses a length prefix at data() without consuming it; false when it is not complete yet.
+         */
+        bool peek_size(std::size_t& prefix, std::size_t& size) const {
+            std::uint64_t encoded;
+            if constexpr (Format.integers == integer_encoding::varint) {
+                prefix = decode_varint(data(), data() + available(), encoded);
+                if (prefix == 0) {
+                    return false;
+                }
+            } else {
+                prefix = sizeof(std::uint64_t);
+                if (available() < prefix) {
+                    return false;
+                }
+                std::memcpy(&encoded, data(), prefix);
+                if constexpr (detail::swaps_bytes<Format>) {
+                    encoded = detail::byte_swap(encoded);
+                }
+            }
+            if (encoded > std::numeric_limits<std::size_t>::max()) [[unlikely]] {
+                throw error("hope::serialization: length prefix does not fit into size_t");
+            }
+            size = static_cast<std::size_t>(encoded);
+            return true;
+        }
+
+        bool try_size(std::size_t& size) {
+            std::size_t prefix;
+            if (!peek_size(prefix, size)) {
+                if (Format.integers == integer_encoding::varint && available() >= max_varint_size) [[unlikely]] {
+                    throw error("hope::serialization: malformed varint");
+                }
+                return false;
+            }
+            consume(prefix);
+            return true;
+        }
+
+        template <typename Element>
+        static constexpr std::size_t min_encoded_size() {
+            if constexpr (detail::raw<Element, Format> || detail::byte_swapped<Element, Format>) {
+                return sizeof(Element);
+            } else if constexpr (!detail::has_serializer<Element> && static_serialized_size_v<Element, Format> != dynamic_size) {
+                return static_serialized_size_v<Element, Format>;
+            } else {
+                return 1;
+            }
+        }
+
+        /**
+         * Checks a length prefix for elements of type Element against what is left of the size limit.
+         */
+        template <typename Element>
+        void check_size(std::size_t size) const {
+            const std::size_t left = max_message_size_ - std::min(consumed_, max_message_size_);
+            bool fits;
+            if constexpr (detail::bit_field<Element, Format>) {
+                fits = size <= std::min(left, std::numeric_limits<std::size_t>::max() / 8) * 8 / detail::bit_width_v<Element>;
+            } else if constexpr (detail::nonempty_encoding<Element>()) {
+                fits = size <= left / min_encoded_size<Element>();
+            } else {
+                fits = size <= max_message_size_; // free on the wire, still not unbounded
+            }
+            if (!fits) [[unlikely]] {
+                throw error("hope::serialization: length prefix exceeds the message size limit");
+            }
+        }
+
+        [[nodiscard]] std::size_t size_need() const noexcept {
+            if constexpr (Format.integers == integer_encoding::varint) {
+                return available() + 1;
+            } else {
+                return sizeof(std::uint64_t);
+            }
+        }
+
+        // decoding
+
+        /**
+         * Picks the coroutine for a value; not a coroutine itself, so dispatching costs no frame.
+         */
+        template <typename U>
+        detail::task decode(U& target) {
+            if constexpr (detail::pmr_container<U>) {
+                bind_resource(target);
+            }
+            static_assert(!detail::has_serializer<U>,
+                "hope::serialization: serializer specializations need the whole input, use reader");
+            static_assert(!(detail::string_like<U> || detail::span_like<U>) || detail::is_specialization_v<U, std::basic_string>,
+                "hope::serialization: views need the whole input, use reader");
+            if constexpr (immediate<U>) {
+                return decode_immediate(target);
+            } else if constexpr (detail::raw<U, Format>) {
+                return read_bytes(&target, sizeof(U));
+            } else if constexpr (detail::string_like<U> || detail::sequence_container<U>) {
+                return decode_sequence(target);
+            } else if constexpr (detail::optional_like<U>) {
+                return decode_optional(target);
+            } else if constexpr (detail::variant_like<U>) {
+                return decode_variant(target);
+            } else if constexpr (detail::polymorphic_pointer<U>) {
+                return decode_polymorphic(target);
+            } else if constexpr (detail::tuple_like<U>) {
+                return decode_each(std::apply([](auto&... elements) { return std::tie(elements...); }, target),
+                    std::make_index_sequence<std::tuple_size_v<U>>{});
+            } else if constexpr (detail::fixed_array<U>) {
+                return decode_elements(std::ranges::data(target), detail::fixed_array_size<U>());
+            } else if constexpr (detail::associative_container<U>) {
+                return decode_associative(target);
+            } else if constexpr (detail::reflectable<U> && Format.layout == struct_layout::tagged) {
+                return decode_tagged<U>(detail::tie_fields(target));
+            } else if constexpr (detail::reflectable<U>) {
+                return decode_record(detail::tie_fields(target), std::make_index_sequence<detail::field_count_v<U>>{});
+            } else {
+                static_assert(detail::dependent_false<U>,
+                    "hope::serialization: type is not serializable, specialize hope::serialization::serializer");
+            }
+        }
+
+        template <typename U>
+        detail::task decode_immediate(U& target) {
+            while (!try_immediate(target)) {
+                if constexpr (detail::varint_integer<U, Format>) {
+                    co_await need{ *this, available() + 1 };
+                } else {
+                    co_await need{ *this, static_serialized_size_v<U, Format> };
+                }
+            }
+        }
+
+        template <typename U>
+        detail::task decode_optional(U& target) {
+            bool present;
+            co_await value(present);
+            if (present) {
+                co_await value(target.emplace());
+            } else {
+                target.reset();
+            }
+        }
+
+        template <typename U>
+        detail::task decode_variant(U& target) {
+            constexpr std::size_t choices = std::variant_size_v<U>;
+            detail::choice_tag_t<choices> tag;
+            co_await value(tag);
+            if (tag >= choices) [[unlikely]] {
+                throw error("hope::serialization: unknown variant alternative or subtype tag");
+            }
+            constexpr auto table = []<std::size_t... I>(std::index_sequence<I...>) {
+                return std::array{ &incremental_reader::template decode_alternative<U, I>... };
+            }(std::make_index_sequence<choices>{});
+            co_await (this->*table[tag])(target);
+        }
+
+        template <typename U, std::size_t I>
+        detail::task decode_alternative(U& target) {
+            if (target.index() != I) {
+                target.template emplace<I>(make<std::variant_alternative_t<I, U>>());
+            }
+            return decode(*std::get_if<I>(&target));
+        }
+
+        template <typename Pointer>
+        detail::task decode_polymorphic(Pointer& target) {
+            using subtypes = typename Pointer::element_type::hope_subtypes;
+            detail::choice_tag_t<subtypes::size + 1> tag;
+            co_await value(tag);
+            if (tag > subtypes::size) [[unlikely]] {
+                throw error("hope::serialization: unknown variant alternative or subtype tag");
+            }
+            if (tag == 0) {
+                target.reset();
+                co_return;
+            }
+            constexpr auto table = []<typename... Types>(type_list<Types...>) {
+                return std::array{ &incremental_reader::template decode_subtype<Pointer, Types>... };
+            }(subtypes{});
+            co_await (this->*table[tag - 1])(target);
+        }
+
+        /**
+         * Like reader, an object of the right class owned by a std::unique_ptr is decoded in place.
+         */
+        template <typename Pointer, typename Subtype>
+        detail::task decode_subtype(Pointer& target) {
+            using subtypes = typename Pointer::element_type::hope_subtypes;
+            if constexpr (std::is_same_v<Pointer, std::unique_ptr<typename Pointer::element_type>>) {
+                if (target && target->hope_subtype() == detail::subtype_index<Subtype, subtypes>()) {
+                    return decode(static_cast<Subtype&>(*target));
+                }
+            }
+            return decode_new_subtype<Pointer, Subtype>(target);
+        }
+
+        template <typename Pointer, typename Subtype>
+        detail::task decode_new_subtype(Pointer& target) {
+            if constexpr (std::is_same_v<Pointer, std::unique_ptr<typename Pointer::element_type>>) {
+                auto object = std::make_unique<Subtype>();
+                co_await value(*object);
+                target = std::move(object);
+            } else {
+                auto object = std::make_shared<Subtype>();
+                co_await value(*object);
+                target = std::move(object);
+            }
+        }
+
+        template <typename Fields, std::size_t... I>
+        detail::task decode_each(Fields fields, std::index_sequence<I...>) {
+            (co_await value(std::get<I>(fields)), ...);
+        }
+
+        template <typename Fields, std::size_t... I>
+        detail::task decode_record(Fields fields, std::index_sequence<I...>) {
+            (co_await record_field<I>(fields), ...);
+        }
+
+        /**
+         * A run of bit fields is decoded at its first field, the others are already done by then.
+         */
+        template <std::size_t I, typename Fields>
+        auto record_field(const Fields& fields) {
+            if constexpr (!detail::bit_field<detail::field_t<Fields, I>, Format>) {
+                return value(std::get<I>(fields));
+            } else if constexpr (detail::packed_run_start<Fields, Format>(I)) {
+                return decode_packed<I, detail::packed_run_end<Fields, Format>(I)>(fields);
+            } else {
+                return std::suspend_never{};
+            }
+        }
+
+        template <std::size_t First, std::size_t End, typename Fields>
+        detail::task decode_packed(Fields fields) {
+            constexpr std::size_t size = detail::packed_run_bytes<Fields, Format, First, End>();
+            std::array<std::uint8_t, size + detail::bit_pack::padding> block{};
+            co_await read_bytes(block.data(), size);
+            detail::unpack_bit_fields<First, End>(fields, block.data());
+        }
+
+        /**
+         * Copies size bytes into target as they arrive.
+         */
+        detail::task read_bytes(void* target, std::size_t size) {
+            auto* out = static_cast<std::uint8_t*>(target);
+            while (size != 0) {
+                if (available() == 0) {
+                    co_await need{ *this, 1, size };
+                }
+                const std::size_t take = std::min(size, available());
+                std::memcpy(out, data(), take);
+                consume(take);
+                out += take;
+                size -= take;
+            }
+        }
+
+        detail::task skip_bytes(std::size_t size) {
+            while (size != 0) {
+                if (available() == 0) {
+                    co_await need{ *this, 1, size };
+                }
+                const std::size_t take = std::min(size, available());
+                consume(take);
+                size -= take;
+            }
+        }
+
+        bool try_varint(std::uint64_t& target) {
+            const std::uint8_t* begin = data();
+            const std::size_t size = decode_varint(begin, begin + available(), target);
+            if (size == 0) {
+                if (available() >= max_varint_size) [[unlikely]] {
+                    throw error("hope::serialization: malformed varint");
+                }
+                return false;
+            }
+            consume(size);
+            return true;
+        }
+
+        template <typename Container>
+        detail::task decode_sequence(Container& container) {
+            using element_type = typename Container::value_type;
+            std::size_t size;
+            while (!try_size(size)) {
+                co_await need{ *this, size_need() };
+            }
+            if constexpr (detail::columnar<Container, Format>) {
+                // columns drop the padding of raw records, a record is only known to take a byte
+                check_size<std::conditional_t<detail::nonempty_encoding<element_type>(), std::uint8_t, element_type>>(size);
+                container.clear();
+                co_await decode_columns(container, size, std::make_index_sequence<detail::field_count_v<element_type>>{});
+            } else if constexpr (std::ranges::contiguous_range<Container> && !detail::bool_vector<Container>
+                && requires { container.resize(size); }) {
+                check_size<element_type>(size);
+                // elements already there are reused, new ones are added a step at a time as their bytes come
+                if (container.size() > size) {
+                    container.resize(size);
+                }
+                for (std::size_t first = 0; first < size;) {
+                    const std::size_t count = std::min(size - first, growth_step<element_type>);
+                    if (container.size() < first + count) {
+                        container.resize(first + count);
+                    }
+                    if constexpr (detail::raw<element_type, Format> || detail::byte_swapped<element_type, Format>
+                        || block_encoded<element_type> || detail::bit_field<element_type, Format>) {
+                        co_await decode_elements(std::ranges::data(container) + first, count);
+                    } else {
+                        for (std::size_t i = first; i < first + count; ++i) {
+                            co_await value(std::ranges::data(container)[i]);
+                        }
+                    }
+                    first += count;
+                }
+            } else if constexpr (detail::bit_field<element_type, Format>) {
+                check_size<element_type>(size);
+                container.clear();
+                if constexpr (requires { container.reserve(size); }) {
+                    container.reserve(std::min(size, growth_step<element_type>));
+                }
+                std::array<element_type, detail::bit_pack::block_size> block;
+                for (std::size_t first = 0; first < size; first += block.size()) {
+                    const std::size_t count = std::min(block.size(), size - first);
+                    co_await decode_elements(block.data(), count);
+                    for (std::size_t i = 0; i < count; ++i) {
+                        container.emplace_back(block[i]);
+                    }
+                }
+            } else {
+                check_size<element_type>(size);
+                container.clear();
+                if constexpr (requires { container.reserve(size); }) {
+                    container.reserve(std::min(size, growth_step<element_type>));
+                }
+                for (std::size_t i = 0; i < size; ++i) {
+                    if constexpr (detail::bool_vector<Container>) {
+                        bool element;
+                        co_await value(element);
+                        container.push_back(element);
+                    } else {
+                        co_await value(container.emplace_back());
+                    }
+                }
+            }
+        }
+
+        template <typename Container, std::size_t... I>
+        detail::task decode_columns(Container& container, std::size_t size, std::index_sequence<I...>) {
+            (co_await decode_column<I>(container, size), ...);
+        }
+
+        /**
+         * Scalar columns are staged one Stream VByte block at a time, which keeps the frame small and still
+         * meets the writer's block boundaries. Elements are appended as the first column arrives, the later
+         * columns fill them in.
+         */
+        template <std::size_t I, typename Container>
+        detail::task decode_column(Container& container, std::size_t size) {
+            using field_type = detail::field_t<detail::fields_tuple_t<typename Container::value_type>, I>;
+            if constexpr (detail::column_scalar<field_type, Format>) {
+                std::array<field_type, detail::stream_vbyte::block_size> block;
+                auto element = container.begin();
+                for (std::size_t left = size; left != 0;) {
+                    const std::size_t count = std::min(left, block.size());
+                    co_await decode_elements(block.data(), count);
+                    for (std::size_t i = 0; i < count; ++i) {
+                        auto& target = I == 0 ? container.emplace_back() : *element++;
+                        std::memcpy(&std::get<I>(detail::tie_fields(target)), &block[i], sizeof(field_type));
+                    }
+                    left -= count;
+                }
+            } else if constexpr (I == 0) {
+                for (std::size_t i = 0; i < size; ++i) {
+                    co_await value(std::get<I>(detail::tie_fields(container.emplace_back())));
+                }
+            } else {
+                for (auto& element : container) {
+                    co_await value(std::get<I>(detail::tie_fields(element)));
+                }
+            }
+        }
+
+        template <typename U>
+        static constexpr bool block_encoded = Format.integers == integer_encoding::varint && detail::stream_vbyte::element<U>;
+
+        template <typename U>
+        detail::task decode_elements(U* values, std::size_t count) {
+            if constexpr (detail::bit_field<U, Format>) {
+                namespace bp = detail::bit_pack;
+                std::array<std::uint8_t, bp::block_size * detail::bit_width_v<U> / 8 + bp::padding> bytes;
+                for (std::size_t first = 0; first < count; first += bp::block_size) {
+                    const std::size_t block = std::min(bp::block_size, count - first);
+                    co_await read_bytes(bytes.data(), bp::packed_size(block, detail::bit_width_v<U>));
+                    detail::unpack_bit_array(bytes.data(), block, values + first);
+                }
+            } else if constexpr (detail::raw<U, Format>) {
+                co_await read_bytes(values, count * sizeof(U));
+            } else if constexpr (detail::byte_swapped<U, Format>) {
+                co_await read_bytes(values, count * sizeof(U));
+                detail::byte_swap_copy<sizeof(U)>(values, values, count);
+            } else if constexpr (block_encoded<U>) {
+                namespace svb = detail::stream_vbyte;
+                for (std::size_t first = 0; first < count; first += svb::block_size) {
+                    const std::size_t block = std::min(svb::block_size, count - first);
+                    const std::size_t control_size = (block + 3) / 4;
+                    co_await need{ *this, control_size };
+                    const std::size_t size = control_size + svb::data_size(data(), block);
+                    const std::uint8_t* bytes = co_await need{ *this, size };
+                    (void)svb::decode_block(bytes, bytes + size, block, values + first);
+                    consume(size);
+                }
+            } else {
+                for (std::size_t i = 0; i < count; ++i) {
+                    co_await value(values[i]);
+                }
+            }
+        }
+
+        template <typename Container>
+        detail::task decode_associative(Container& container) {
+            using key_type = std::remove_const_t<typename Container::key_type>;
+            std::size_t size;
+            while (!try_size(size)) {
+                co_await need{ *this, size_need() };
+            }
+            check_size<key_type>(size);
+            container.clear();
+            if constexpr (requires { container.reserve(size); }) {
+                container.reserve(std::min(size, growth_step<typename Container::value_type>));
+            }
+            for (std::size_t i = 0; i < size; ++i) {
+                auto key = make<key_type>();
+                co_await value(key);
+                if constexpr (requires { typename Container::mapped_type; }) {
+                    auto mapped = make<typename Container::mapped_type>();
+                    co_await value(mapped);
+                    container.emplace_hint(container.end(), std::move(key), std::move(mapped));
+                } else {
+                    container.emplace_hint(container.end(), std::move(key));
+                }
+            }
+        }
+
+        template <typename U, typename Fields>
+        detail::task decode_tagged(Fields fields) {
+            static_assert(detail::valid_field_ids<U>(), "hope::serialization: field ids must be unique and non-zero");
+            constexpr auto ids = detail::field_ids<U>();
+            constexpr auto indices = std::make_index_sequence<ids.size()>{};
+            std::array<bool, ids.size()> seen{};
+            for (;;) {
+                std::uint64_t key;
+                while (!try_varint(key)) {
+                    co_await need{ *this, available() + 1 };
+                }
+                if (key == detail::end_of_fields) {
+                    break;
+                }
+                const auto id = key >> 3;
+                const auto type = static_cast<wire_type>(key & 7);
+                const std::size_t index = [&]<std::size_t... I>(std::index_sequence<I...>) {
+                    std::size_t found = ids.size();
+                    ((id == ids[I] ? (found = I, true) : false) || ...);
+                    return found;
+                }(indices);
+                if (index == ids.size()) {
+                    co_await skip_field(type);
+                    continue;
+                }
+                constexpr auto table = []<std::size_t... I>(std::index_sequence<I...>) {
+                    return std::array{ &incremental_reader::template decode_tagged_field_at<Fields, I>... };
+                }(indices);
+                co_await (this->*table[index])(fields, type);
+                seen[index] = true;
+            }
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                ((seen[I] ? void() : reset_field(std::get<I>(fields))), ...);
+            }(indices);
+        }
+
+        template <typename Fields, std::size_t I>
+        detail::task decode_tagged_field_at(const Fields& fields, wire_type type) {
+            return decode_tagged_field(std::get<I>(fields), type);
+        }
+
+        template <typename U>
+        detail::task decode_tagged_field(U& target, wire_type type) {
+            if constexpr (detail::optional_like<U>) {
+                co_await decode_tagged_field(target.emplace(), type);
+            } else {
+                constexpr auto expected = detail::wire_type_of<U, Format>();
+                if (type != expected) [[unlikely]] {
+                    throw error("hope::serialization: field changed its wire type");
+                }
+                if constexpr (expected == wire_type::length_delimited) {
+                    std::size_t size;
+                    while (!try_size(size)) {
+                        co_await need{ *this, size_need() };
+                    }
+                    const std::size_t end = consumed_ + size;
+                    co_await value(target);
+                    if (consumed_ != end) [[unlikely]] {
+                        throw error("hope::serialization: field does not match its length");
+                    }
+                } else {
+                    co_await value(target);
+                }
+            }
+        }
+
+        detail::task skip_field(wire_type type) {
+            if (type == wire_type::varint) {
+                std::uint64_t ignored;
+                while (!try_varint(ignored)) {
+                    co_await need{ *this, available() + 1 };
+                }
+            } else if (type == wire_type::length_delimited) {
+                std::size_t size;
+                while (!try_size(size)) {
+                    co_await need{ *this, size_need() };
+                }
+                co_await skip_bytes(size);
+            } else if (const std::size_t size = detail::fixed_size(type); size != 0) {
+                co_await skip_bytes(size);
+            } else [[unlikely]] {
+                throw error("hope::serialization: unknown wire type");
+            }
+        }
+
+        template <typename U>
+        static void reset_field(U& target) {
+            if constexpr (requires { target.clear(); }) {
+                target.clear();
+            } else {
+                target = U{};
+            }
+        }
+
+        template <typename U>
+        [[nodiscard]] U make() {
+            if constexpr (std::uses_allocator_v<U, std::pmr::polymorphic_allocator<std::byte>>) {
+                if (resource_ != nullptr) {
+                    return std::make_obj_using_allocator<U>(std::pmr::polymorphic_allocator<std::byte>(resource_));
+                }
+            }
+            return U{};
+        }
+
+        template <typename Container>
+        void bind_resource(Container& container) {
+            if (resource_ != nullptr && container.get_allocator().resource() != resource_) {
+                std::destroy_at(&container);
+                std::construct_at(&container, typename Container::allocator_type(resource_));
+            }
+        }
+
+        std::pmr::memory_resource* resource_;
+        std::size_t max_message_size_;
+        detail::task root_;
+        std::coroutine_handle<> current_;
+        const std::uint8_t* cursor_{ nullptr };
+        const std::uint8_t* end_{ nullptr };
+        std::array<std::uint8_t, carry_capacity> carry_;
+        std::size_t carry_size_{ 0 };
+        std::size_t pending_{ 0 };
+        std::size_t hint_{ 0 };
+        std::size_t consumed_{ 0 };
+    };
+
+}
@@ -0,0 +1,351 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/bit_fields.h"
+#include "hope/serialization/detail/bit_pack.h"
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/reader.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/tagged.h"
+#include "hope/serialization/traits.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <ranges>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace hope::serialization {
+
+    template <typename T, format Format>
+    class lazy_view;
+
+    namespace detail {
+
+        /**
+         * Fields a lazy view hands out as nested views instead of decoding them.
+         */
+        template <typename T>
+        concept lazy_record = reflectable<T> && !fixed_array<T> && !tuple_like<T> && !std::ranges::range<T>
+            && !has_serializer<T>;
+
+        template <typename T, format Format>
+        struct lazy_field {
+            using type = T;
+        };
+
+        template <lazy_record T, format Format>
+        struct lazy_field<T, Format> {
+            using type = lazy_view<T, Format>;
+        };
+
+    }
+
+    /**
+     * Accessor over an encoded record that decodes a field only when it is asked for.
+     *
+     *     hope::serialization::lazy_view<order, hope::serialization::varint_format> view(bytes);
+     *     if (view.get<3>() == side::buy) {
+     *         route(view.get<7>().get<0>());  // field 7 is a nested record, itself a view
+     *     }
+     *
+     * Field I is found through a small offset table. With the frozen layout it is filled front to back as
+     * far as the furthest field requested, stepping over earlier fields with reader::skip (fixed width
+     * values and strings by length, nothing decoded); a tagged record is indexed by one pass over its keys
+     * on first access. Records the format copies whole are addressed by their member layout, padding
+     * included. get<I>() decodes field I, or returns a lazy_view over its bytes when it is a nested
+     * record; decode<I>() always decodes. Views point into the bytes, which must outlive them.
+     */
+    template <typename T, format Format = format{}>
+    class lazy_view final {
+        static_assert(detail::lazy_record<T>, "hope::serialization: lazy views are for reflected records");
+
+        using fields = detail::fields_tuple_t<T>;
+
+    public:
+        static constexpr std::size_t field_count = detail::field_count_v<T>;
+
+        template <std::size_t I>
+        using field_type = detail::field_t<fields, I>;
+
+        /**
+         * Decoded type of field I, or a nested view for records.
+         */
+        template <std::size_t I>
+        using access_type = typename detail::lazy_field<field_type<I>, Format>::type;
+
+        lazy_view() = default;
+
+        /**
+         * bytes hold exactly one encoded T. Strings and containers decoded from the view allocate from
+         * resource when one is given.
+         */
+        explicit lazy_view(std::span<const std::uint8_t> bytes, std::pmr::memory_resource* resource = nullptr) noexcept
+            : bytes_(bytes)
+            , resource_(resource) {}
+
+        [[nodiscard]] std::span<const std::uint8_t> bytes() const noexcept { return bytes_; }
+
+        template <std::size_t I>
+        [[nodiscard]] access_type<I> get() const {
+            if constexpr (detail::lazy_record<field_type<I>>) {
+                return access_type<I>(field_bytes<I>(), resource_);
+            } else {
+                return decode<I>();
+            }
+        }
+
+        template <std::size_t I>
+        [[nodiscard]] field_type<I> decode() const {
+            static_assert(I < field_count, "hope::serialization: field index out of range");
+            auto value = make<field_type<I>>();
+            if constexpr (Format.layout == struct_layout::tagged) {
+                index_tagged();
+                if (!present_[I]) {
+                    return value; // absent fields read as default, as with the eager reader
+                }
+                input_buffer input(bytes_.subspan(offsets_[I], sizes_[I]));
+                reader<input_buffer, Format> in(input, resource_);
+                if constexpr (detail::optional_like<field_type<I>>) {
+                    in.read(value.emplace());
+                } else {
+                    in.read(value);
+                }
+                if (input.remaining() != 0) [[unlikely]] {
+                    throw error("hope::serialization: field does not match its length");
+                }
+            } else if constexpr (detail::raw<T, Format>) {
+                input_buffer input(member_bytes<I>());
+                reader<input_buffer, Format>(input, resource_).read(value);
+            } else if constexpr (detail::bit_field<field_type<I>, Format>) {
+                decode_packed<I>(value);
+            } else {
+                locate(I);
+                input_buffer input(bytes_.subspan(offsets_[I]));
+                reader<input_buffer, Format>(input, resource_).read(value);
+            }
+            return value;
+        }
+
+        /**
+         * Encoded bytes of field I; for a tagged record, its value without key and length prefix. Fields
+         * sharing a byte block with other bit fields yield the whole block.
+         */
+        template <std::size_t I>
+        [[nodiscard]] std::span<const std::uint8_t> field_bytes() const {
+            static_assert(I < field_count, "hope::serialization: field index out of range");
+            if constexpr (Format.layout == struct_layout::tagged) {
+                index_tagged();
+                if (!present_[I]) [[unlikely]] {
+                    throw error("hope::serialization: field is not present");
+                }
+                return bytes_.subspan(offsets_[I], sizes_[I]);
+            } else if constexpr (detail::raw<T, Format>) {
+                return member_bytes<I>();
+            } else if constexpr (detail::bit_field<field_type<I>, Format>) {
+                constexpr std::size_t first = run_first(I);
+                constexpr std::size_t end = detail::packed_run_end<fields, Format>(I);
+                locate(first);
+                return checked_subspan(offsets_[first], detail::packed_run_bytes<fields, Format, first, end>());
+            } else {
+                locate(I + 1);
+                return bytes_.subspan(offsets_[I], offsets_[I + 1] - offsets_[I]);
+            }
+        }
+
+        /**
+         * Whether field I came with the message; always true for the frozen layout.
+         */
+        template <std::size_t I>
+        [[nodiscard]] bool has() const {
+            if constexpr (Format.layout == struct_layout::tagged) {
+                index_tagged();
+                return present_[I];
+            } else {
+                return true;
+            }
+        }
+
+        /**
+         * Decodes the whole record.
+         */
+        [[nodiscard]] T decode() const {
+            input_buffer input(bytes_);
+            return reader<input_buffer, Format>(input, resource_).template read<T>();
+        }
+
+    private:
+        template <typename U>
+        [[nodiscard]] U make() const {
+            if constexpr (std::uses_allocator_v<U, std::pmr::polymorphic_allocator<std::byte>>) {
+                if (resource_ != nullptr) {
+                    return std::make_obj_using_allocator<U>(std::pmr::polymorphic_allocator<std::byte>(resource_));
+                }
+            }
+            return U{};
+        }
+
+        [[nodiscard]] std::span<const std::uint8_t> checked_subspan(std::size_t offset, std::size_t size) const {
+            if (size > bytes_.size() - offset) [[unlikely]] {
+                throw error("hope::serialization: unexpected end of input");
+            }
+            return bytes_.subspan(offset, size);
+        }
+
+        /**
+         * Where every field sits in the object representation of T. A raw record is written as one copy of
+         * it, padding included, so its fields are found there rather than back to back.
+         */
+        static const std::array<std::size_t, field_count>& member_offsets() {
+            static const auto offsets = [] {
+                union storage {
+                    storage() noexcept {}
+                    T value;
+                } object;
+                const auto* base = reinterpret_cast<const unsigned char*>(std::addressof(object.value));
+                return std::apply(
+                    [base](const auto&... field) {
+                        return std::array<std::size_t, field_count>{ static_cast<std::size_t>(
+                            reinterpret_cast<const unsigned char*>(std::addressof(field)) - base)... };
+                    },
+                    detail::tie_fields(object.value));
+            }();
+            return offsets;
+        }
+
+        template <std::size_t I>
+        [[nodiscard]] std::span<const std::uint8_t> member_bytes() const {
+            if (bytes_.size() < sizeof(T)) [[unlikely]] {
+                throw error("hope::serialization: unexpected end of input");
+            }
+            return bytes_.subspan(member_offsets()[I], sizeof(field_type<I>));
+        }
+
+        static constexpr std::size_t run_first(std::size_t index) {
+            while (!detail::packed_run_start<fields, Format>(index)) {
+                --index;
+            }
+            return index;
+        }
+
+        /**
+         * Bytes taken by field I at the start of in. A run of bit fields is accounted to its last field,
+         * so every field of the run starts where the run does.
+         */
+        template <std::size_t I>
+        static std::size_t field_extent(std::span<const std::uint8_t> in) {
+            if constexpr (detail::bit_field<field_type<I>, Format>) {
+                constexpr std::size_t end = detail::packed_run_end<fields, Format>(I);
+                if constexpr (I + 1 < end) {
+                    return 0;
+                } else {
+                    return detail::packed_run_bytes<fields, Format, run_first(I), end>();
+                }
+            } else if constexpr (static_serialized_size_v<field_type<I>, Format> != dynamic_size) {
+                return static_serialized_size_v<field_type<I>, Format>;
+            } else {
+                input_buffer input(in);
+                reader<input_buffer, Format>(input).template skip<field_type<I>>();
+                return input.position();
+            }
+        }
+
+        /**
+         * Makes offsets_[0..index] known.
+         */
+        void locate(std::size_t index) const {
+            static constexpr auto extents = []<std::size_t... I>(std::index_sequence<I...>) {
+                return std::array<std::size_t (*)(std::span<const std::uint8_t>), field_count>{ &field_extent<I>... };
+            }(std::make_index_sequence<field_count>{});
+            for (; known_ < index; ++known_) {
+                const std::size_t offset = offsets_[known_];
+                const std::size_t extent = extents[known_](bytes_.subspan(offset));
+                if (extent > bytes_.size() - offset) [[unlikely]] {
+                    throw error("hope::serialization: unexpected end of input");
+                }
+                offsets_[known_ + 1] = offset + extent;
+            }
+        }
+
+        template <std::size_t I, typename U>
+        void decode_packed(U& value) const {
+            constexpr std::size_t first = run_first(I);
+            constexpr std::size_t end = detail::packed_run_end<fields, Format>(I);
+            const auto run = field_bytes<I>();
+            std::array<std::uint8_t, detail::packed_run_bytes<fields, Format, first, end>() + detail::bit_pack::padding> block{};
+            std::memcpy(block.data(), run.data(), run.size());
+            auto values = [&]<std::size_t... J>(std::index_sequence<J...>) {
+                return std::tuple<field_type<first + J>...>{};
+            }(std::make_index_sequence<end - first>{});
+            // unpack_bit_fields indexes the tuple like the record, so the run's fields are addressed from 0
+            detail::unpack_bit_fields<0, end - first>(std::apply([](auto&... run_values) { return std::tie(run_values...); }, values),
+                block.data());
+            value = std::get<I - first>(values);
+        }
+
+        /**
+         * Records where every field of the message starts; keys of unknown fields are skipped, a repeated
+         * key wins over earlier ones like it does for the eager reader.
+         */
+        void index_tagged() const {
+            static_assert(detail::valid_field_ids<T>(), "hope::serialization: field ids must be unique and non-zero");
+            if (indexed_) {
+                return;
+            }
+            static constexpr auto ids = detail::field_ids<T>();
+            static constexpr auto types = []<std::size_t... I>(std::index_sequence<I...>) {
+                return std::array<wire_type, field_count>{ detail::wire_type_of<field_type<I>, Format>()... };
+            }(std::make_index_sequence<field_count>{});
+            input_buffer input(bytes_);
+            reader<input_buffer, Format> in(input);
+            for (auto key = in.template read_varint<std::uint64_t>(); key != detail::end_of_fields;
+                 key = in.template read_varint<std::uint64_t>()) {
+                const auto id = key >> 3;
+                const auto type = static_cast<wire_type>(key & 7);
+                std::size_t index = 0;
+                while (index < field_count && ids[index] != id) {
+                    ++index;
+                }
+                if (index == field_count) {
+                    in.skip_field(type);
+                    continue;
+                }
+                if (type != types[index]) [[unlikely]] {
+                    throw error("hope::serialization: field changed its wire type");
+                }
+                if (type == wire_type::length_delimited) {
+                    const auto size = in.read_size();
+                    offsets_[index] = input.position();
+                    sizes_[index] = size;
+                    in.skip_bytes(size);
+                } else {
+                    offsets_[index] = input.position();
+                    in.skip_field(type);
+                    sizes_[index] = input.position() - offsets_[index];
+                }
+                present_[index] = true;
+            }
+            indexed_ = true;
+        }
+
+        std::span<const std::uint8_t> bytes_;
+        std::pmr::memory_resource* resource_{ nullptr };
+        mutable std::array<std::size_t, field_count + 1> offsets_{};
+        mutable std::array<std::size_t, Format.layout == struct_layout::tagged ? field_count : 0> sizes_{};
+        mutable std::array<bool, Format.layout == struct_layout::tagged ? field_count : 0> present_{};
+        mutable std::size_t known_{ 0 };
+        mutable bool indexed_{ false };
+    };
+
+}
@@ -0,0 +1,418 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/crc32c.h"
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/reader.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/traits.h"
+#include "hope/serialization/writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hope::serialization {
+
+    /**
+     * Fixed set of worker threads, each with its own job queue. A worker takes jobs from the back of its
+     * own queue and, when that is empty, steals from the front of the others; the thread calling
+     * parallel_for works along, so nested calls cannot deadlock.
+     */
+    class work_stealing_pool final {
+    public:
+        explicit work_stealing_pool(std::size_t threads = std::max(std::thread::hardware_concurrency(), 1u))
+            : queues_(std::max<std::size_t>(threads, 1)) {
+            threads_.reserve(queues_.size());
+            for (std::size_t i = 0; i < queues_.size(); ++i) {
+                threads_.emplace_back([this, i] { work(i); });
+            }
+        }
+
+        work_stealing_pool(const work_stealing_pool&) = delete;
+        work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+        ~work_stealing_pool() {
+            {
+                std::lock_guard lock(sleep_mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            for (auto& thread : threads_) {
+                thread.join();
+            }
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept { return threads_.size(); }
+
+        /**
+         * Calls body(i) for every i in [0, count) across the pool and returns when all calls are done. The
+         * first exception thrown by body is rethrown here, after the remaining calls have run.
+         */
+        template <typename Body>
+        void parallel_for(std::size_t count, Body&& body) {
+            if (count == 0) {
+                return;
+            }
+            struct batch final {
+                work_stealing_pool& pool;
+                std::remove_reference_t<Body>& body;
+                std::atomic<std::size_t> left;
+                std::mutex failure_mutex;
+                std::exception_ptr failure;
+            } state{ *this, body, count, {}, nullptr };
+            const auto run = [](void* context, std::size_t index) noexcept {
+                auto& current = *static_cast<batch*>(context);
+                try {
+                    current.body(index);
+                } catch (...) {
+                    std::lock_guard lock(current.failure_mutex);
+                    if (!current.failure) {
+                        current.failure = std::current_exception();
+                    }
+                }
+                // the caller may return as soon as left drops to 0; only pool members are touched after that
+                auto& pool = current.pool;
+                if (current.left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    pool.finished_.fetch_add(1, std::memory_order_release);
+                    pool.finished_.notify_all();
+                }
+            };
+            // contiguous index ranges per queue keep neighbouring chunks on one worker until stolen
+            const std::size_t per_queue = (count + queues_.size() - 1) / queues_.size();
+            for (std::size_t q = 0; q < queues_.size() && q * per_queue < count; ++q) {
+                std::lock_guard lock(queues_[q].mutex);
+                for (std::size_t i = std::min(count, (q + 1) * per_queue); i-- > q * per_queue;) {
+                    queues_[q].jobs.push_back(job{ run, &state, i });
+                }
+            }
+            {
+                std::lock_guard lock(sleep_mutex_);
+                queued_.fetch_add(count, std::memory_order_relaxed);
+            }
+            wake_.notify_all();
+            for (std::size_t start = 0;; ++start) {
+                const auto epoch = finished_.load(std::memory_order_acquire);
+                if (state.left.load(std::memory_order_acquire) == 0) {
+                    break;
+                }
+                if (!run_one(start % queues_.size())) {
+                    finished_.wait(epoch, std::memory_order_acquire);
+                }
+            }
+            if (state.failure) {
+                std::rethrow_exception(state.failure);
+            }
+        }
+
+    private:
+        struct job final {
+            void (*run)(void* context, std::size_t index) noexcept;
+            void* context;
+            std::size_t index;
+        };
+
+        struct job_queue final {
+            std::mutex mutex;
+            std::deque<job> jobs;
+        };
+
+        /**
+         * Runs one job: from the back of queue home, else stolen from the front of another queue.
+         */
+        bool run_one(std::size_t home) {
+            for (std::size_t k = 0; k < queues_.size(); ++k) {
+                auto& queue = queues_[(home + k) % queues_.size()];
+                std::unique_lock lock(queue.mutex);
+                if (queue.jobs.empty()) {
+                    continue;
+                }
+                job next;
+                if (k == 0) {
+                    next = queue.jobs.back();
+                    queue.jobs.pop_back();
+                } else {
+                    next = queue.jobs.front();
+                    queue.jobs.pop_front();
+                }
+                lock.unlock();
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                next.run(next.context, next.index);
+                return true;
+            }
+            return false;
+        }
+
+        void work(std::size_t self) {
+            for (;;) {
+                if (run_one(self)) {
+                    continue;
+                }
+                std::unique_lock lock(sleep_mutex_);
+                wake_.wait(lock, [this] { return stopping_ || queued_.load(std::memory_order_relaxed) != 0; });
+                if (stopping_ && queued_.load(std::memory_order_relaxed) == 0) {
+                    return;
+                }
+            }
+        }
+
+        std::vector<job_queue> queues_;
+        std::vector<std::thread> threads_;
+        std::mutex sleep_mutex_;
+        std::condition_variable wake_;
+        std::atomic<std::size_t> queued_{ 0 };
+        std::atomic<std::uint64_t> finished_{ 0 }; ///< bumped whenever a parallel_for completes
+        bool stopping_{ false };
+    };
+
+    /**
+     * Elements per chunk unless the caller says otherwise; large enough that a chunk amortizes its
+     * scheduling, small enough to balance a few gigabytes over dozens of cores.
+     */
+    inline constexpr std::size_t default_chunk_elements = std::size_t{ 1 } << 16;
+
+    /**
+     * Bytes per job when checksumming on a pool; one piece takes tens of microseconds with the crc32
+     * instruction.
+     */
+    inline constexpr std::size_t default_crc32c_piece = std::size_t{ 1 } << 20;
+
+    namespace detail {
+
+        template <typename Container>
+        concept parallel_contiguous = std::ranges::contiguous_range<Container> && !bool_vector<Container>
+            && requires(Container& container, std::size_t size) { container.resize(size); };
+
+        /**
+         * Element type chunks of Container are decoded into when they cannot be decoded in place; a map's
+         * value_type has a const key and cannot be decoded into.
+         */
+        template <typename Container>
+        struct parallel_element {
+            using type = typename Container::value_type;
+        };
+
+        template <typename Container>
+            requires requires { typename Container::mapped_type; }
+        struct parallel_element<Container> {
+            using type = std::pair<std::remove_const_t<typename Container::key_type>, typename Container::mapped_type>;
+        };
+
+        /**
+         * Reads a length prefix at offset, bounded like reader::read_size for Element, and moves past it.
+         */
+        template <format Format, typename Element = std::uint8_t>
+        std::size_t read_prefix(std::span<const std::uint8_t> bytes, std::size_t& offset) {
+            input_buffer input(bytes.subspan(offset));
+            const auto value = reader<input_buffer, Format>(input).template read_size<Element>();
+            offset += input.position();
+            return value;
+        }
+
+    }
+
+    /**
+     * Encodes a large sequence or associative container in chunks of chunk_elements, each encoded by a
+     * worker of pool into a buffer of its own, and appends them to out behind a chunk index:
+     *     size    element count
+     *     size    chunk count
+     *     size    byte length of every chunk
+     *     chunks  element count, then the elements: like a std::span of them for vectors, one by one for
+     *             other containers
+     * Read it back with deserialize_parallel. With checksum set, every worker also checksums its chunk
+     * while it is in cache, and *checksum receives the CRC-32C of everything appended to out.
+     */
+    template <format Format = format{}, typename Container>
+    void serialize_parallel(const Container& values, output_buffer& out, work_stealing_pool& pool,
+        std::size_t chunk_elements = default_chunk_elements, std::uint32_t* checksum = nullptr) {
+        chunk_elements = std::max<std::size_t>(chunk_elements, 1);
+        const std::size_t size = std::ranges::size(values);
+        const std::size_t chunk_count = (size + chunk_elements - 1) / chunk_elements;
+        std::vector<output_buffer> chunks(chunk_count);
+        std::vector<std::uint32_t> chunk_crcs(checksum != nullptr ? chunk_count : 0);
+        if constexpr (detail::parallel_contiguous<Container>) {
+            using element_type = typename Container::value_type;
+            pool.parallel_for(chunk_count, [&](std::size_t chunk) {
+                const std::size_t first = chunk * chunk_elements;
+                const std::span<const element_type> slice(std::ranges::data(values) + first, std::min(chunk_elements, size - first));
+                chunks[chunk].reserve(serialized_size<Format>(slice) + detail::max_prepare_size);
+                writer<output_buffer, Format>(chunks[chunk]).write(slice);
+                if (checksum != nullptr) {
+                    chunk_crcs[chunk] = crc32c(chunks[chunk].view());
+                }
+            });
+        } else {
+            std::vector<std::ranges::iterator_t<const Container>> starts;
+            starts.reserve(chunk_count);
+            auto it = std::ranges::begin(values);
+            for (std::size_t first = 0; first < size; first += chunk_elements) {
+                starts.push_back(it);
+                std::ranges::advance(it, static_cast<std::ptrdiff_t>(std::min(chunk_elements, size - first)));
+            }
+            pool.parallel_for(chunk_count, [&](std::size_t chunk) {
+                const std::size_t count = std::min(chunk_elements, size - chunk * chunk_elements);
+                writer<output_buffer, Format> encoder(chunks[chunk]);
+                encoder.write_size(count);
+                auto element = starts[chunk];
+                for (std::size_t i = 0; i < count; ++i, ++element) {
+                    encoder.write(*element);
+                }
+                if (checksum != nullptr) {
+                    chunk_crcs[chunk] = crc32c(chunks[chunk].view());
+                }
+            });
+        }
+        const std::size_t index_begin = out.size();
+        writer<output_buffer, Format> encoder(out);
+        encoder.write_size(size);
+        encoder.write_size(chunk_count);
+        std::size_t total = 0;
+        for (const auto& chunk : chunks) {
+            encoder.write_size(chunk.size());
+            total += chunk.size();
+        }
+        out.reserve(out.size() + total);
+        if (checksum != nullptr) {
+            std::uint32_t crc = crc32c(out.view().subspan(index_begin));
+            for (std::size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                crc = crc32c_combine(crc, chunk_crcs[chunk], chunks[chunk].size());
+            }
+            *checksum = crc;
+        }
+        for (const auto& chunk : chunks) {
+            out.write(chunk.data(), chunk.size());
+        }
+    }
+
+    /**
+     * CRC-32C of bytes, checksummed in pieces of piece_size across pool and merged with crc32c_combine;
+     * e.g. to verify a large serialize_parallel encoding before decoding it.
+     */
+    [[nodiscard]] inline std::uint32_t crc32c(std::span<const std::uint8_t> bytes, work_stealing_pool& pool,
+        std::size_t piece_size = default_crc32c_piece) {
+        piece_size = std::max<std::size_t>(piece_size, 1);
+        const std::size_t piece_count = (bytes.size() + piece_size - 1) / piece_size;
+        std::vector<std::uint32_t> crcs(piece_count);
+        pool.parallel_for(piece_count, [&](std::size_t piece) {
+            crcs[piece] = crc32c(bytes.subspan(piece * piece_size, std::min(piece_size, bytes.size() - piece * piece_size)));
+        });
+        std::uint32_t crc = 0;
+        for (std::size_t piece = 0; piece < piece_count; ++piece) {
+            crc = crc32c_combine(crc, crcs[piece], std::min(piece_size, bytes.size() - piece * piece_size));
+        }
+        return crc;
+    }
+
+    /**
+     * Decodes what serialize_parallel wrote for the same kind of container, one chunk per job. Vectors are
+     * sized once and every chunk is decoded straight into its slice; other containers decode their chunks
+     * into vectors that are then moved into the container in order.
+     */
+    template <format Format = format{}, typename Container>
+    void deserialize_parallel(std::span<const std::uint8_t> bytes, Container& values, work_stealing_pool& pool,
+        std::pmr::memory_resource* resource = nullptr) {
+        using element_type = typename detail::parallel_element<Container>::type;
+        std::size_t offset = 0;
+        const std::size_t size = detail::read_prefix<Format, element_type>(bytes, offset);
+        const std::size_t chunk_count = detail::read_prefix<Format>(bytes, offset);
+        if (chunk_count > bytes.size() - offset) [[unlikely]] {
+            throw error("hope::serialization: length prefix exceeds the remaining input");
+        }
+        std::vector<std::span<const std::uint8_t>> chunks(chunk_count);
+        std::vector<std::size_t> lengths(chunk_count);
+        for (auto& length : lengths) {
+            length = detail::read_prefix<Format>(bytes, offset);
+        }
+        for (std::size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            if (lengths[chunk] > bytes.size() - offset) [[unlikely]] {
+                throw error("hope::serialization: chunk exceeds the remaining input");
+            }
+            chunks[chunk] = bytes.subspan(offset, lengths[chunk]);
+            offset += lengths[chunk];
+        }
+        if (offset != bytes.size()) [[unlikely]] {
+            throw error("hope::serialization: trailing bytes after the last chunk");
+        }
+
+        if constexpr (detail::parallel_contiguous<Container>) {
+            // chunk i starts at the sum of the element counts before it
+            std::vector<std::size_t> firsts(chunk_count + 1);
+            for (std::size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                std::size_t prefix = 0;
+                firsts[chunk + 1] = firsts[chunk] + detail::read_prefix<Format, element_type>(chunks[chunk], prefix);
+                if (firsts[chunk + 1] < firsts[chunk] || firsts[chunk + 1] > size) [[unlikely]] {
+                    throw error("hope::serialization: chunk element counts do not add up");
+                }
+            }
+            if (firsts.back() != size) [[unlikely]] {
+                throw error("hope::serialization: chunk element counts do not add up");
+            }
+            values.clear();
+            values.resize(size);
+            element_type* data = std::ranges::data(values);
+            pool.parallel_for(chunk_count, [&](std::size_t chunk) {
+                input_buffer input(chunks[chunk]);
+                reader<input_buffer, Format> decoder(input, resource);
+                const std::size_t count = decoder.template read_size<element_type>();
+                decoder.read_elements(data + firsts[chunk], count);
+                if (input.remaining() != 0) [[unlikely]] {
+                    throw error("hope::serialization: chunk does not match its length");
+                }
+            });
+        } else {
+            std::vector<std::vector<element_type>> decoded(chunk_count);
+            pool.parallel_for(chunk_count, [&](std::size_t chunk) {
+                input_buffer input(chunks[chunk]);
+                reader<input_buffer, Format> decoder(input, resource);
+                const std::size_t count = decoder.template read_size<element_type>();
+                decoded[chunk].reserve(count);
+                for (std::size_t i = 0; i < count; ++i) {
+                    decoded[chunk].push_back(decoder.template read<element_type>());
+                }
+                if (input.remaining() != 0) [[unlikely]] {
+                    throw error("hope::serialization: chunk does not match its length");
+                }
+            });
+            std::size_t total = 0;
+            for (const auto& chunk : decoded) {
+                total += chunk.size();
+            }
+            if (total != size) [[unlikely]] {
+                throw error("hope::serialization: chunk element counts do not add up");
+            }
+            values.clear();
+            if constexpr (requires { values.reserve(size); }) {
+                values.reserve(size);
+            }
+            for (auto& chunk : decoded) {
+                for (auto&& element : chunk) {
+                    if constexpr (detail::associative_container<Container>) {
+                        values.emplace_hint(values.end(), std::move(element));
+                    } else {
+                        values.emplace_back(std::move(element));
+                    }
+                }
+            }
+        }
+    }
+
+}
@@ -0,0 +1,774 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/bit_fields.h"
+#include "hope/serialization/detail/bit_pack.h"
+#include "hope/serialization/detail/byte_swap.h"
+#include "hope/serialization/detail/stream_vbyte.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/tagged.h"
+#include "hope/serialization/traits.h"
+#include "hope/serialization/varint.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+
+namespace hope::serialization {
+
+    /**
+     * Decodes values written by writer with the same Format. Mirrors the writer rule for rule; containers are
+     * cleared and refilled, length prefixes are checked against the remaining input (when the stream can tell)
+     * before allocating.
+     */
+    template <input_stream Stream, format Format = format{}>
+    class reader final {
+    public:
+        using stream_type = Stream;
+        static constexpr format wire_format = Format;
+
+        /**
+         * With a memory resource every std::pmr container the reader fills (strings, vectors, maps, at any
+         * depth) allocates from it; containers bound to a different resource are rebound before being filled.
+         */
+        explicit reader(Stream& stream, std::pmr::memory_resource* resource = nullptr) noexcept
+            : stream_(stream)
+            , resource_(resource) {}
+
+        template <typename T>
+        void read(T& value) {
+            if constexpr (detail::pmr_container<T>) {
+                bind_resource(value);
+            }
+            if constexpr (detail::has_serializer<T>) {
+                serializer<T>::read(*this, value);
+            } else if constexpr (detail::bit_field<T, Format>) {
+                read_packed<0, 1>(std::tie(value));
+            } else if constexpr (detail::varint_integer<T, Format>) {
+                value = detail::from_varint<T>(read_varint<detail::varint_unsigned_t<T>>());
+            } else if constexpr (detail::raw<T, Format>) {
+                stream_.read(&value, sizeof(T));
+            } else if constexpr (detail::byte_swapped<T, Format>) {
+                stream_.read(&value, sizeof(T));
+                value = detail::byte_swap(value);
+            } else if constexpr (detail::string_like<T> || detail::span_like<T>) {
+                if constexpr (detail::is_specialization_v<T, std::basic_string>) {
+                    read_sequence(value);
+                } else {
+                    value = read_view<T>();
+                }
+            } else if constexpr (detail::optional_like<T>) {
+                if (read<bool>()) {
+                    read(value.emplace());
+                } else {
+                    value.reset();
+                }
+            } else if constexpr (detail::variant_like<T>) {
+                read_variant(value);
+            } else if constexpr (detail::polymorphic_pointer<T>) {
+                read_polymorphic(value);
+            } else if constexpr (detail::tuple_like<T>) {
+                std::apply([this](auto&... elements) { (read(elements), ...); }, value);
+            } else if constexpr (detail::fixed_array<T>) {
+                read_elements(std::ranges::data(value), detail::fixed_array_size<T>());
+            } else if constexpr (detail::sequence_container<T>) {
+                read_sequence(value);
+            } else if constexpr (detail::associative_container<T>) {
+                read_associative(value);
+            } else if constexpr (detail::reflectable<T> && Format.layout == struct_layout::tagged) {
+                read_tagged<T>(detail::tie_fields(value));
+            } else if constexpr (detail::reflectable<T>) {
+                read_fields<0>(detail::tie_fields(value));
+            } else {
+                static_assert(detail::dependent_false<T>,
+                    "hope::serialization: type is not serializable, specialize hope::serialization::serializer");
+            }
+        }
+
+        template <typename T>
+        [[nodiscard]] T read() {
+            T value = make<T>();
+            read(value);
+            return value;
+        }
+
+        /**
+         * Moves past an encoded T without materializing it. Values of static size, strings and arrays of
+         * fixed width or bit packed elements are stepped over by length; containers, optionals and records
+         * are walked one element or field at a time, tagged records key by key. Types with a serializer and
+         * columnar sequences have no self-describing shape and are decoded into a temporary.
+         */
+        template <typename T>
+        void skip() {
+            step_over<T, false>();
+        }
+
+        /**
+         * Walks an encoded T like skip() and additionally checks the known fields of tagged records against
+         * their types and lengths, so every length, varint and offset of the value has been checked against
+         * the input once it returns. Runs of varints are checked vectorized. Input a reader accepted here can
+         * be decoded with an unchecked_input_buffer.
+         */
+        template <typename T>
+        void validate() {
+            static_assert(sized_input_stream<Stream>, "hope::serialization: validation needs a stream that knows its remaining size");
+            step_over<T, true>();
+        }
+
+        /**
+         * Skips the value of a tagged field by its wire type.
+         */
+        void skip_field(wire_type type) {
+            if (type == wire_type::varint) {
+                (void)read_varint<std::uint64_t>();
+            } else if (type == wire_type::length_delimited) {
+                skip_bytes(read_size());
+            } else if (const std::size_t size = detail::fixed_size(type); size != 0) {
+                skip_bytes(size);
+            } else [[unlikely]] {
+                throw error("hope::serialization: unknown wire type");
+            }
+        }
+
+        [[nodiscard]] std::pmr::memory_resource* resource() const noexcept { return resource_; }
+
+        /**
+         * Reads a length prefix for elements of type Element and validates it against the remaining input.
+         */
+        template <typename Element = std::uint8_t>
+        [[nodiscard]] std::size_t read_size() {
+            std::uint64_t size;
+            if constexpr (Format.integers == integer_encoding::varint) {
+                size = read_varint<std::uint64_t>();
+            } else {
+                size = read<std::uint64_t>();
+            }
+            if constexpr (unchecked_input_stream<Stream>) {
+                // validated input: the prefix was checked when it was accepted
+            } else if constexpr (sized_input_stream<Stream> && detail::bit_field<Element, Format>) {
+                if (size > stream_.remaining() * 8 / detail::bit_width_v<Element>) [[unlikely]] {
+                    throw error("hope::serialization: length prefix exceeds the remaining input");
+                }
+            } else if constexpr (sized_input_stream<Stream> && detail::nonempty_encoding<Element>()) {
+                if (size > stream_.remaining() / min_encoded_size<Element>()) [[unlikely]] {
+                    throw error("hope::serialization: length prefix exceeds the remaining input");
+                }
+            } else if (size > std::numeric_limits<std::size_t>::max()) [[unlikely]] {
+                throw error("hope::serialization: length prefix does not fit into size_t");
+            }
+            return static_cast<std::size_t>(size);
+        }
+
+        template <std::unsigned_integral T>
+        [[nodiscard]] T read_varint() {
+            T value;
+            if constexpr (unchecked_input_stream<Stream>) {
+                // the value is known to end within its maximum length, so that is the only limit
+                const std::uint8_t* begin = stream_.peek();
+                (void)stream_.consume(decode_varint(begin, begin + max_varint_size_v<T>, value));
+            } else if constexpr (contiguous_input_stream<Stream>) {
+                const std::uint8_t* begin = stream_.peek();
+                const std::size_t size = decode_varint(begin, begin + stream_.remaining(), value);
+                if (size == 0) [[unlikely]] {
+                    throw error("hope::serialization: malformed varint");
+                }
+                (void)stream_.consume(size);
+            } else {
+                std::array<std::uint8_t, max_varint_size_v<T>> bytes;
+                std::size_t size = 0;
+                do {
+                    if (size == bytes.size()) [[unlikely]] {
+                        throw error("hope::serialization: malformed varint");
+                    }
+                    stream_.read(&bytes[size], 1);
+                } while (bytes[size++] >= 0x80);
+                if (decode_varint(bytes.data(), bytes.data() + size, value) != size) [[unlikely]] {
+                    throw error("hope::serialization: malformed varint");
+                }
+            }
+            return value;
+        }
+
+        /**
+         * Reads a string or array as a view into the input instead of copying it: std::basic_string_view or
+         * std::span<const T> for raw T. The input must outlive the view. Elements wider than a byte must be
+         * suitably aligned in the input, array_view has no such requirement.
+         */
+        template <typename View>
+        [[nodiscard]] View read_view() {
+            static_assert(contiguous_input_stream<Stream>,
+                "hope::serialization: views need an input stream that exposes its memory (peek/consume)");
+            using element_type = std::remove_cv_t<typename View::value_type>;
+            if constexpr (detail::span_like<View>) {
+                static_assert(std::is_const_v<typename View::element_type>, "hope::serialization: views are read-only, use std::span<const T>");
+            }
+            static_assert(detail::raw<element_type, Format>,
+                "hope::serialization: only elements the format stores verbatim can be viewed in place");
+            const auto size = read_size<element_type>();
+            if constexpr (detail::span_like<View>) {
+                if constexpr (View::extent != std::dynamic_extent) {
+                    if (size != View::extent) [[unlikely]] {
+                        throw error("hope::serialization: array size does not match the span extent");
+                    }
+                }
+            }
+            const std::uint8_t* bytes = stream_.consume(size * sizeof(element_type));
+            if constexpr (alignof(element_type) > 1) {
+                if (reinterpret_cast<std::uintptr_t>(bytes) % alignof(element_type) != 0) [[unlikely]] {
+                    throw error("hope::serialization: view is not aligned for its element type, read an array_view");
+                }
+            }
+            return View(reinterpret_cast<const element_type*>(bytes), size);
+        }
+
+        void read_bytes(void* data, std::size_t size) {
+            if (size != 0) {
+                stream_.read(data, size);
+            }
+        }
+
+        void skip_bytes(std::size_t size) {
+            if constexpr (contiguous_input_stream<Stream>) {
+                (void)stream_.consume(size);
+            } else {
+                std::array<std::uint8_t, 256> scratch;
+                while (size != 0) {
+                    const std::size_t chunk = std::min(size, scratch.size());
+                    stream_.read(scratch.data(), chunk);
+                    size -= chunk;
+                }
+            }
+        }
+
+        /**
+         * Fills count already constructed elements, encoded like the elements of a std::span<const T> of
+         * that size (without its length prefix).
+         */
+        template <typename T>
+        void read_elements(T* values, std::size_t count) {
+            if constexpr (detail::bit_field<T, Format>) {
+                read_bit_array(values, count);
+            } else if constexpr (detail::raw<T, Format>) {
+                read_bytes(values, count * sizeof(T));
+            } else if constexpr (detail::byte_swapped<T, Format>) {
+                read_bytes(values, count * sizeof(T));
+                detail::byte_swap_copy<sizeof(T)>(values, values, count);
+            } else if constexpr (Format.integers == integer_encoding::varint && detail::stream_vbyte::element<T>) {
+                read_stream_vbyte(values, count);
+            } else if constexpr (detail::varint_integer<T, Format> && contiguous_input_stream<Stream>) {
+                const std::uint8_t* begin = stream_.peek();
+                const std::size_t size = decode_varints(begin, begin + stream_.remaining(), values, count);
+                if (size == 0 && count != 0) [[unlikely]] {
+                    throw error("hope::serialization: malformed varint");
+                }
+                (void)stream_.consume(size);
+            } else {
+                for (std::size_t i = 0; i < count; ++i) {
+                    read(values[i]);
+                }
+            }
+        }
+
+        [[nodiscard]] Stream& stream() noexcept { return stream_; }
+
+    private:
+        template <typename T>
+        [[nodiscard]] T make() {
+            if constexpr (std::uses_allocator_v<T, std::pmr::polymorphic_allocator<std::byte>>) {
+                if (resource_ != nullptr) {
+                    return std::make_obj_using_allocator<T>(std::pmr::polymorphic_allocator<std::byte>(resource_));
+                }
+            }
+            return T{};
+        }
+
+        /**
+         * An empty container is swapped for one on the reader's resource; moving the existing one would copy
+         * elements across resources and assignment does not propagate polymorphic allocators.
+         */
+        template <typename Container>
+        void bind_resource(Container& container) {
+            if (resource_ != nullptr && container.get_allocator().resource() != resource_) {
+                std::destroy_at(&container);
+                std::construct_at(&container, typename Container::allocator_type(resource_));
+            }
+        }
+
+        template <typename Element>
+        static constexpr std::size_t min_encoded_size() {
+            if constexpr (detail::raw<Element, Format> || detail::byte_swapped<Element, Format>) {
+                return sizeof(Element);
+            } else {
+                return 1;
+            }
+        }
+
+        /**
+         * Reads a choice tag and checks it against the number of choices.
+         */
+        template <std::size_t Choices>
+        [[nodiscard]] std::size_t read_choice() {
+            const std::size_t tag = read<detail::choice_tag_t<Choices>>();
+            if (tag >= Choices) [[unlikely]] {
+                throw error("hope::serialization: unknown variant alternative or subtype tag");
+            }
+            return tag;
+        }
+
+        /**
+         * Jumps through a table indexed by the tag. An alternative the variant already holds is decoded in
+         * place, keeping whatever capacity it has.
+         */
+        template <typename T>
+        void read_variant(T& value) {
+            static constexpr auto alternatives = []<std::size_t... I>(std::index_sequence<I...>) {
+                return std::array<void (*)(reader&, T&), sizeof...(I)>{ [](reader& in, T& target) {
+                    if (target.index() != I) {
+                        target.template emplace<I>(in.template make<std::variant_alternative_t<I, T>>());
+                    }
+                    in.read(*std::get_if<I>(&target));
+                }... };
+            }(std::make_index_sequence<std::variant_size_v<T>>{});
+            alternatives[read_choice<std::variant_size_v<T>>()](*this, value);
+        }
+
+        /**
+         * Constructs the class the tag names through a table of factories; a std::unique_ptr already owning
+         * an object of that class has it decoded in place.
+         */
+        template <typename Pointer>
+        void read_polymorphic(Pointer& pointer) {
+            using subtypes = typename Pointer::element_type::hope_subtypes;
+            static constexpr auto factories = []<typename... Types>(type_list<Types...>) {
+                return std::array<void (*)(reader&, Pointer&), sizeof...(Types)>{ [](reader& in, Pointer& target) {
+                    constexpr bool unique = std::is_same_v<Pointer, std::unique_ptr<typename Pointer::element_type>>;
+                    if (unique && target && target->hope_subtype() == detail::subtype_index<Types, subtypes>()) {
+                        in.read(static_cast<Types&>(*target));
+                        return;
+                    }
+                    if constexpr (unique) {
+                        auto object = std::make_unique<Types>();
+                        in.read(*object);
+                        target = std::move(object);
+                    } else {
+                        auto object = std::make_shared<Types>();
+                        in.read(*object);
+                        target = std::move(object);
+                    }
+                }... };
+            }(subtypes{});
+            const std::size_t tag = read_choice<subtypes::size + 1>();
+            if (tag == 0) {
+                pointer.reset();
+            } else {
+                factories[tag - 1](*this, pointer);
+            }
+        }
+
+        template <typename Container>
+        void read_sequence(Container& container) {
+            using element_type = typename Container::value_type;
+            if constexpr (detail::columnar<Container, Format>) {
+                // columns drop the padding of raw records, a record is only known to take a byte
+                using bound_type = std::conditional_t<detail::nonempty_encoding<element_type>(), std::uint8_t, element_type>;
+                container.resize(read_size<bound_type>());
+                read_columns(container);
+                return;
+            }
+            const auto size = read_size<element_type>();
+            if constexpr (std::ranges::contiguous_range<Container> && !detail::bool_vector<Container>
+                && requires { container.resize(size); }) {
+                container.resize(size);
+                read_elements(std::ranges::data(container), size);
+            } else if constexpr (detail::bit_field<element_type, Format>) {
+                container.clear();
+                if constexpr (requires { container.reserve(size); }) {
+                    container.reserve(size);
+                }
+                std::array<element_type, detail::bit_pack::block_size> block;
+                for (std::size_t first = 0; first < size; first += block.size()) {
+                    const std::size_t count = std::min(block.size(), size - first);
+                    read_bit_array(block.data(), count);
+                    for (std::size_t i = 0; i < count; ++i) {
+                        container.emplace_back(block[i]);
+                    }
+                }
+            } else if constexpr (detail::bool_vector<Container>) {
+                container.clear();
+                container.reserve(size);
+                for (std::size_t i = 0; i < size; ++i) {
+                    container.push_back(read<bool>());
+                }
+            } else {
+                container.clear();
+                if constexpr (requires { container.reserve(size); }) {
+                    container.reserve(size);
+                }
+                for (std::size_t i = 0; i < size; ++i) {
+                    read(container.emplace_back());
+                }
+            }
+        }
+
+        template <typename Container>
+        void read_columns(Container& container) {
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                (read_column<I>(container), ...);
+            }(std::make_index_sequence<detail::field_count_v<typename Container::value_type>>{});
+        }
+
+        template <std::size_t I, typename Container>
+        void read_column(Container& container) {
+            using field_type = detail::field_t<detail::fields_tuple_t<typename Container::value_type>, I>;
+            if constexpr (detail::column_scalar<field_type, Format>) {
+                std::array<field_type, detail::column_block> block;
+                auto element = container.begin();
+                for (std::size_t left = container.size(); left != 0;) {
+                    const std::size_t count = std::min(left, block.size());
+                    read_elements(block.data(), count);
+                    for (std::size_t i = 0; i < count; ++i, ++element) {
+                        std::memcpy(&std::get<I>(detail::tie_fields(*element)), &block[i], sizeof(field_type));
+                    }
+                    left -= count;
+                }
+            } else {
+                for (auto& element : container) {
+                    read(std::get<I>(detail::tie_fields(element)));
+                }
+            }
+        }
+
+        template <typename T, bool Validate>
+        void step_over() {
+            if constexpr (static_serialized_size_v<T, Format> != dynamic_size) {
+                skip_bytes(static_serialized_size_v<T, Format>);
+            } else if constexpr (detail::has_serializer<T> || detail::columnar<T, Format>) {
+                (void)read<T>();
+            } else if constexpr (detail::varint_integer<T, Format>) {
+                (void)read_varint<detail::varint_unsigned_t<T>>();
+            } else if constexpr (detail::string_like<T> || detail::span_like<T>) {
+                using element_type = std::remove_cv_t<typename T::value_type>;
+                skip_elements<element_type, true, Validate>(read_size<element_type>());
+            } else if constexpr (detail::optional_like<T>) {
+                if (read<bool>()) {
+                    step_over<typename T::value_type, Validate>();
+                }
+            } else if constexpr (detail::variant_like<T>) {
+                static constexpr auto alternatives = []<std::size_t... I>(std::index_sequence<I...>) {
+                    return std::array<void (reader::*)(), sizeof...(I)>{ &reader::step_over<std::variant_alternative_t<I, T>, Validate>... };
+                }(std::make_index_sequence<std::variant_size_v<T>>{});
+                (this->*alternatives[read_choice<std::variant_size_v<T>>()])();
+            } else if constexpr (detail::polymorphic_pointer<T>) {
+                static constexpr auto subtypes = []<typename... Types>(type_list<Types...>) {
+                    return std::array<void (reader::*)(), sizeof...(Types)>{ &reader::step_over<Types, Validate>... };
+                }(typename T::element_type::hope_subtypes{});
+                if (const std::size_t tag = read_choice<subtypes.size() + 1>(); tag != 0) {
+                    (this->*subtypes[tag - 1])();
+                }
+            } else if constexpr (detail::tuple_like<T>) {
+                [this]<std::size_t... I>(std::index_sequence<I...>) {
+                    (step_over<std::remove_cvref_t<std::tuple_element_t<I, T>>, Validate>(), ...);
+                }(std::make_index_sequence<std::tuple_size_v<T>>{});
+            } else if constexpr (detail::fixed_array<T>) {
+                skip_elements<std::remove_cv_t<std::ranges::range_value_t<T>>, true, Validate>(detail::fixed_array_size<T>());
+            } else if constexpr (detail::sequence_container<T>) {
+                using element_type = typename T::value_type;
+                skip_elements<element_type, std::ranges::contiguous_range<const T> && !detail::bool_vector<T>, Validate>(
+                    read_size<element_type>());
+            } else if constexpr (detail::associative_container<T>) {
+                using key_type = std::remove_const_t<typename T::key_type>;
+                const auto size = read_size<key_type>();
+                for (std::size_t i = 0; i < size; ++i) {
+                    step_over<key_type, Validate>();
+                    if constexpr (requires { typename T::mapped_type; }) {
+                        step_over<typename T::mapped_type, Validate>();
+                    }
+                }
+            } else if constexpr (detail::reflectable<T> && Format.layout == struct_layout::tagged && Validate) {
+                validate_tagged<T>();
+            } else if constexpr (detail::reflectable<T> && Format.layout == struct_layout::tagged) {
+                for (auto key = read_varint<std::uint64_t>(); key != detail::end_of_fields; key = read_varint<std::uint64_t>()) {
+                    skip_field(static_cast<wire_type>(key & 7));
+                }
+            } else if constexpr (detail::reflectable<T>) {
+                skip_fields<detail::fields_tuple_t<T>, 0, Validate>();
+            } else {
+                static_assert(detail::dependent_false<T>,
+                    "hope::serialization: type is not serializable, specialize hope::serialization::serializer");
+            }
+        }
+
+        /**
+         * Skips count elements laid out the way write_elements puts them; only contiguous containers use
+         * Stream VByte blocks, so the caller says which kind wrote them.
+         */
+        template <typename T, bool Contiguous, bool Validate>
+        void skip_elements(std::size_t count) {
+            namespace svb = detail::stream_vbyte;
+            if constexpr (detail::bit_field<T, Format>) {
+                // whole blocks end on a byte boundary, only the last one is padded
+                skip_bytes(detail::bit_pack::packed_size(count, detail::bit_width_v<T>));
+            } else if constexpr (static_serialized_size_v<T, Format> != dynamic_size) {
+                skip_bytes(count * static_serialized_size_v<T, Format>);
+            } else if constexpr (Contiguous && Format.integers == integer_encoding::varint && svb::element<T>) {
+                for (std::size_t first = 0; first < count; first += svb::block_size) {
+                    const std::size_t block = std::min(svb::block_size, count - first);
+                    const std::size_t control_size = (block + 3) / 4;
+                    if constexpr (contiguous_input_stream<Stream>) {
+                        if (stream_.remaining() < control_size) [[unlikely]] {
+                            throw error("hope::serialization: truncated integer block");
+                        }
+                        (void)stream_.consume(control_size + svb::data_size(stream_.peek(), block));
+                    } else {
+                        std::array<std::uint8_t, svb::block_size / 4> control;
+                        stream_.read(control.data(), control_size);
+                        skip_bytes(svb::data_size(control.data(), block));
+                    }
+                }
+            } else if constexpr (detail::varint_integer<T, Format> && contiguous_input_stream<Stream>) {
+                const std::uint8_t* begin = stream_.peek();
+                const std::size_t size = skip_varints<T>(begin, begin + stream_.remaining(), count);
+                if (size == 0 && count != 0) [[unlikely]] {
+                    throw error("hope::serialization: malformed varint");
+                }
+                (void)stream_.consume(size);
+            } else {
+                for (std::size_t i = 0; i < count; ++i) {
+                    step_over<T, Validate>();
+                }
+            }
+        }
+
+        template <typename Fields, std::size_t I, bool Validate>
+        void skip_fields() {
+            if constexpr (I == std::tuple_size_v<Fields>) {
+                return;
+            } else if constexpr (detail::bit_field<detail::field_t<Fields, I>, Format>) {
+                constexpr auto end = detail::packed_run_end<Fields, Format>(I);
+                skip_bytes(detail::packed_run_bytes<Fields, Format, I, end>());
+                skip_fields<Fields, end, Validate>();
+            } else {
+                step_over<detail::field_t<Fields, I>, Validate>();
+                skip_fields<Fields, I + 1, Validate>();
+            }
+        }
+
+        template <typename T>
+        void read_bit_array(T* values, std::size_t count) {
+            namespace bp = detail::bit_pack;
+            constexpr unsigned bits = detail::bit_width_v<T>;
+            std::array<std::uint8_t, bp::block_size * bits / 8 + bp::padding> bytes;
+            for (std::size_t first = 0; first < count; first += bp::block_size) {
+                const std::size_t block = std::min(bp::block_size, count - first);
+                read_bytes(bytes.data(), bp::packed_size(block, bits));
+                detail::unpack_bit_array(bytes.data(), block, values + first);
+            }
+        }
+
+        template <typename T>
+        void read_stream_vbyte(T* values, std::size_t count) {
+            namespace svb = detail::stream_vbyte;
+            for (std::size_t first = 0; first < count; first += svb::block_size) {
+                const std::size_t block = std::min(svb::block_size, count - first);
+                if constexpr (contiguous_input_stream<Stream>) {
+                    const std::uint8_t* begin = stream_.peek();
+                    const std::size_t size = svb::decode_block(begin, begin + stream_.remaining(), block, values + first);
+                    if (size == 0) [[unlikely]] {
+                        throw error("hope::serialization: truncated integer block");
+                    }
+                    (void)stream_.consume(size);
+                } else {
+                    std::array<std::uint8_t, svb::max_block_bytes + svb::decode_padding> bytes;
+                    const std::size_t control_size = (block + 3) / 4;
+                    stream_.read(bytes.data(), control_size);
+                    const std::size_t data_size = svb::data_size(bytes.data(), block);
+                    stream_.read(bytes.data() + control_size, data_size);
+                    (void)svb::decode_block(bytes.data(), bytes.data() + bytes.size(), block, values + first);
+                }
+            }
+        }
+
+        template <typename Container>
+        void read_associative(Container& container) {
+            using key_type = std::remove_const_t<typename Container::key_type>;
+            const auto size = read_size<key_type>();
+            container.clear();
+            if constexpr (requires { container.reserve(size); }) {
+                container.reserve(size);
+            }
+            for (std::size_t i = 0; i < size; ++i) {
+                if constexpr (requires { typename Container::mapped_type; }) {
+                    auto key = read<key_type>();
+                    auto mapped = read<typename Container::mapped_type>();
+                    container.emplace_hint(container.end(), std::move(key), std::move(mapped));
+                } else {
+                    container.emplace_hint(container.end(), read<key_type>());
+                }
+            }
+        }
+
+        template <std::size_t I, typename Fields>
+        void read_fields(const Fields& fields) {
+            if constexpr (I == std::tuple_size_v<Fields>) {
+                return;
+            } else if constexpr (detail::bit_field<detail::field_t<Fields, I>, Format>) {
+                constexpr auto end = detail::packed_run_end<Fields, Format>(I);
+                read_packed<I, end>(fields);
+                read_fields<end>(fields);
+            } else {
+                constexpr auto end = detail::fused_run_end<Fields, Format>(I);
+                if constexpr (end - I > 1) {
+                    std::array<std::uint8_t, detail::fused_run_bytes<Fields, I, end>()> block;
+                    stream_.read(block.data(), block.size());
+                    unpack_fields<I, end>(fields, block.data());
+                } else {
+                    read(std::get<I>(fields));
+                }
+                read_fields<end>(fields);
+            }
+        }
+
+        /**
+         * Fields may come in any order; unknown ids are skipped by wire type, fields that did not come are
+         * reset so a reused object does not keep values from the previous message.
+         */
+        template <typename T, typename Fields>
+        void read_tagged(const Fields& fields) {
+            static_assert(detail::valid_field_ids<T>(), "hope::serialization: field ids must be unique and non-zero");
+            constexpr auto ids = detail::field_ids<T>();
+            constexpr auto indices = std::make_index_sequence<ids.size()>{};
+            std::array<bool, ids.size()> seen{};
+            for (;;) {
+                const auto key = read_varint<std::uint64_t>();
+                if (key == detail::end_of_fields) {
+                    break;
+                }
+                const auto id = key >> 3;
+                const auto type = static_cast<wire_type>(key & 7);
+                const bool known = [&]<std::size_t... I>(std::index_sequence<I...>) {
+                    return ((id == ids[I] && (read_tagged_field(std::get<I>(fields), type), seen[I] = true)) || ...);
+                }(indices);
+                if (!known) {
+                    skip_field(type);
+                }
+            }
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                ((seen[I] ? void() : reset_field(std::get<I>(fields))), ...);
+            }(indices);
+        }
+
+        template <typename T>
+        void read_tagged_field(T& value, wire_type type) {
+            if constexpr (detail::optional_like<T>) {
+                read_tagged_field(value.emplace(), type);
+            } else {
+                constexpr auto expected = detail::wire_type_of<T, Format>();
+                if (type != expected) [[unlikely]] {
+                    throw error("hope::serialization: field changed its wire type");
+                }
+                if constexpr (expected == wire_type::length_delimited) {
+                    const auto size = read_size();
+                    if constexpr (sized_input_stream<Stream> && !unchecked_input_stream<Stream>) {
+                        const std::size_t end = stream_.remaining() - size;
+                        read(value);
+                        if (stream_.remaining() != end) [[unlikely]] {
+                            throw error("hope::serialization: field does not match its length");
+                        }
+                    } else {
+                        read(value);
+                    }
+                } else {
+                    read(value);
+                }
+            }
+        }
+
+        /**
+         * Checks a tagged record the way read_tagged reads it: known fields by their type and length, unknown
+         * ones by wire type.
+         */
+        template <typename T>
+        void validate_tagged() {
+            static_assert(detail::valid_field_ids<T>(), "hope::serialization: field ids must be unique and non-zero");
+            using fields = detail::fields_tuple_t<T>;
+            constexpr auto ids = detail::field_ids<T>();
+            for (auto key = read_varint<std::uint64_t>(); key != detail::end_of_fields; key = read_varint<std::uint64_t>()) {
+                const auto id = key >> 3;
+                const auto type = static_cast<wire_type>(key & 7);
+                const bool known = [&]<std::size_t... I>(std::index_sequence<I...>) {
+                    return ((id == ids[I] && (validate_tagged_field<detail::field_t<fields, I>>(type), true)) || ...);
+                }(std::make_index_sequence<ids.size()>{});
+                if (!known) {
+                    skip_field(type);
+                }
+            }
+        }
+
+        template <typename T>
+        void validate_tagged_field(wire_type type) {
+            if constexpr (detail::optional_like<T>) {
+                validate_tagged_field<typename T::value_type>(type);
+            } else {
+                constexpr auto expected = detail::wire_type_of<T, Format>();
+                if (type != expected) [[unlikely]] {
+                    throw error("hope::serialization: field changed its wire type");
+                }
+                if constexpr (expected == wire_type::length_delimited) {
+                    const auto size = read_size();
+                    const std::size_t end = stream_.remaining() - size;
+                    step_over<T, true>();
+                    if (stream_.remaining() != end) [[unlikely]] {
+                        throw error("hope::serialization: field does not match its length");
+                    }
+                } else {
+                    step_over<T, true>();
+                }
+            }
+        }
+
+        template <typename T>
+        static void reset_field(T& value) {
+            if constexpr (requires { value.clear(); }) {
+                value.clear();
+            } else {
+                value = T{};
+            }
+        }
+
+        template <std::size_t First, std::size_t End, typename Fields>
+        void read_packed(const Fields& fields) {
+            constexpr std::size_t size = detail::packed_run_bytes<Fields, Format, First, End>();
+            std::array<std::uint8_t, size + detail::bit_pack::padding> block{};
+            stream_.read(block.data(), size);
+            detail::unpack_bit_fields<First, End>(fields, block.data());
+        }
+
+        template <std::size_t I, std::size_t End, typename Fields>
+        static void unpack_fields(const Fields& fields, const std::uint8_t* in) noexcept {
+            if constexpr (I < End) {
+                auto& field = std::get<I>(fields);
+                std::memcpy(&field, in, sizeof(field));
+                if constexpr (detail::byte_swapped<detail::field_t<Fields, I>, Format>) {
+                    field = detail::byte_swap(field);
+                }
+                unpack_fields<I + 1, End>(fields, in + sizeof(field));
+            }
+        }
+
+        Stream& stream_;
+        std::pmr::memory_resource* resource_;
+    };
+
+}
@@ -0,0 +1,216 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/reader.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/writer.h"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Declares the wire id of a message type dispatched through a message_registry. Must be placed in a public
+ * section; specialize hope::serialization::message_id for types that cannot be changed.
+ *
+ *     struct quote { HOPE_MESSAGE_ID(7) std::uint64_t instrument; double price; };
+ */
+#define HOPE_MESSAGE_ID(id)                                                         \
+    static constexpr std::uint32_t hope_message_id = id;
+
+namespace hope::serialization {
+
+    template <typename T>
+    struct message_id {
+        static constexpr std::uint32_t value = T::hope_message_id;
+    };
+
+    template <typename T>
+    inline constexpr std::uint32_t message_id_v = message_id<T>::value;
+
+    namespace detail {
+
+        /**
+         * How ids map to slots of the lookup table: the id itself when the ids are dense enough, otherwise a
+         * multiplicative hash (id * multiplier mod 2^32) >> shift searched at compile time to be collision free.
+         */
+        struct message_table_plan final {
+            std::uint32_t multiplier;
+            unsigned shift;
+            std::size_t size;
+
+            [[nodiscard]] constexpr std::size_t slot(std::uint32_t id) const noexcept {
+                if (multiplier == 0) {
+                    return id;
+                }
+                return static_cast<std::size_t>((static_cast<std::uint64_t>(id) * multiplier & 0xffffffffu) >> shift);
+            }
+        };
+
+        /**
+         * Largest dense table, relative to the number of messages, taken before falling back to hashing.
+         */
+        inline constexpr std::size_t max_dense_ratio = 4;
+        inline constexpr std::size_t max_dense_slack = 16;
+
+        template <std::size_t N>
+        constexpr message_table_plan plan_message_table(const std::array<std::uint32_t, N>& ids) {
+            std::uint32_t max_id = 0;
+            for (const auto id : ids) {
+                max_id = id > max_id ? id : max_id;
+            }
+            if (std::size_t{ max_id } < max_dense_ratio * N + max_dense_slack) {
+                return { 0, 0, std::size_t{ max_id } + 1 };
+            }
+            const unsigned min_bits = static_cast<unsigned>(std::bit_width(N - 1));
+            for (unsigned bits = min_bits; bits <= min_bits + 4; ++bits) {
+                std::uint32_t candidate = 0x9e3779b9u;
+                for (int attempt = 0; attempt < 4096; ++attempt) {
+                    const message_table_plan plan{ candidate | 1u, 32 - bits, std::size_t{ 1 } << bits };
+                    bool collision = false;
+                    for (std::size_t i = 0; i < N && !collision; ++i) {
+                        for (std::size_t j = 0; j < i && !collision; ++j) {
+                            collision = plan.slot(ids[i]) == plan.slot(ids[j]);
+                        }
+                    }
+                    if (!collision) {
+                        return plan;
+                    }
+                    candidate = candidate * 1664525u + 1013904223u;
+                }
+            }
+            throw "hope::serialization: no perfect hash found for the message ids";
+        }
+
+        template <typename T, typename... Types>
+        constexpr std::size_t type_index() noexcept {
+            constexpr std::array<bool, sizeof...(Types)> matches{ std::is_same_v<T, Types>... };
+            for (std::size_t i = 0; i < matches.size(); ++i) {
+                if (matches[i]) {
+                    return i;
+                }
+            }
+            return matches.size();
+        }
+
+    }
+
+    /**
+     * Maps wire ids to message types, entirely at compile time. A message on the wire is its varint id
+     * followed by its encoding in Format. dispatch() reads the id, finds the type through a dense table or a
+     * perfect hash (one multiply, one shift, one compare) and jumps through a table of decode-and-handle
+     * functions, one per type; there are no maps, no RTTI and no virtual factories on the receive path.
+     *
+     *     using protocol = message_registry<varint_format, login, quote, trade>;
+     *     protocol::write(out, quote{ 42, 1.5 });
+     *     protocol::dispatch(in, overloaded{ [](login&& m) { ... }, [](quote&& m) { ... }, [](trade&& m) { ... } });
+     */
+    template <format Format, typename... Messages>
+    class message_registry final {
+    public:
+        static constexpr format wire_format = Format;
+        static constexpr std::size_t size = sizeof...(Messages);
+
+        /**
+         * index_of() result for ids that are not registered.
+         */
+        static constexpr std::size_t npos = size;
+
+        static_assert(size > 0, "hope::serialization: a message registry needs at least one message type");
+        static_assert(size < 0xffff, "hope::serialization: too many message types");
+
+        static constexpr std::array<std::uint32_t, size> ids{ message_id_v<Messages>... };
+
+        /**
+         * Position of the type registered under id, npos when there is none.
+         */
+        [[nodiscard]] static constexpr std::size_t index_of(std::uint32_t id) noexcept {
+            const std::size_t slot = plan.slot(id);
+            if (slot >= plan.size) {
+                return npos;
+            }
+            const std::size_t entry = slots[slot];
+            if (entry == 0 || ids[entry - 1] != id) {
+                return npos;
+            }
+            return entry - 1;
+        }
+
+        [[nodiscard]] static constexpr bool contains(std::uint32_t id) noexcept { return index_of(id) != npos; }
+
+        template <typename T>
+        static constexpr bool registered = detail::type_index<T, Messages...>() != npos;
+
+        template <output_stream Stream, typename T>
+        static void write(Stream& stream, const T& message) {
+            static_assert(registered<T>, "hope::serialization: message type is not in the registry");
+            writer<Stream, Format> out(stream);
+            out.write_varint(message_id_v<T>);
+            out.write(message);
+        }
+
+        /**
+         * Decodes the next message and calls handler with it as an rvalue. Returns what the handler returns
+         * (the common type over all messages); throws error for an unknown id.
+         */
+        template <input_stream Stream, typename Handler>
+        static decltype(auto) dispatch(Stream& stream, Handler&& handler, std::pmr::memory_resource* resource = nullptr) {
+            reader<Stream, Format> in(stream, resource);
+            const std::size_t index = index_of(in.template read_varint<std::uint32_t>());
+            if (index == npos) [[unlikely]] {
+                throw error("hope::serialization: unknown message id");
+            }
+            return handlers<Stream, Handler>[index](in, handler);
+        }
+
+    private:
+        static constexpr bool unique_ids() {
+            for (std::size_t i = 0; i < ids.size(); ++i) {
+                for (std::size_t j = 0; j < i; ++j) {
+                    if (ids[i] == ids[j]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        static_assert(unique_ids(), "hope::serialization: message ids must be unique");
+
+        static constexpr detail::message_table_plan plan = detail::plan_message_table(ids);
+
+        /**
+         * Slot -> position + 1, 0 for empty slots.
+         */
+        static constexpr auto slots = [] {
+            std::array<std::uint16_t, plan.size> table{};
+            for (std::size_t i = 0; i < ids.size(); ++i) {
+                table[plan.slot(ids[i])] = static_cast<std::uint16_t>(i + 1);
+            }
+            return table;
+        }();
+
+        template <typename Handler>
+        using result_type = std::common_type_t<std::invoke_result_t<Handler&, Messages&&>...>;
+
+        template <typename T, input_stream Stream, typename Handler>
+        static result_type<Handler> handle(reader<Stream, Format>& in, Handler& handler) {
+            return handler(in.template read<T>());
+        }
+
+        template <input_stream Stream, typename Handler>
+        static constexpr std::array<result_type<Handler> (*)(reader<Stream, Format>&, Handler&), size> handlers{
+            &handle<Messages, Stream, Handler>...
+        };
+    };
+
+}
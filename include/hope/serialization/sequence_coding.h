@@ -0,0 +1,280 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/bit_pack.h"
+#include "hope/serialization/detail/prefix_sum.h"
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/traits.h"
+#include "hope/serialization/varint.h"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+namespace hope::serialization {
+
+    enum class sequence_coding : std::uint8_t {
+        delta,              ///< differences between neighbours; sorted ids, counters
+        delta_of_delta,     ///< differences between neighbouring differences; timestamps at a steady rate
+        frame_of_reference, ///< offsets from the smallest value of each block; clustered, unsorted values
+    };
+
+    /**
+     * A container of integers annotated with a coding; otherwise it is the container itself.
+     *
+     *     struct telemetry {
+     *         hope::serialization::delta_of_delta<std::vector<std::uint64_t>> timestamps;
+     *         hope::serialization::delta<std::vector<std::uint32_t>> sequence_numbers;
+     *     };
+     *
+     * The coded values (first value and first difference as varints, the rest as residuals) are bit packed in
+     * blocks of 128, each block with its own width, so a steady sequence costs a few bits per element whatever
+     * the format's integer encoding. Decoding unpacks a block and rebuilds the values with vectorized prefix sums.
+     */
+    template <typename Container, sequence_coding Coding>
+        requires std::ranges::contiguous_range<Container> && std::integral<typename Container::value_type>
+            && (!std::same_as<typename Container::value_type, bool>)
+    class coded_sequence : public Container {
+    public:
+        using Container::Container;
+
+        coded_sequence() = default;
+
+        coded_sequence(Container container) noexcept(std::is_nothrow_move_constructible_v<Container>)
+            : Container(std::move(container)) {}
+    };
+
+    template <typename Container>
+    using delta = coded_sequence<Container, sequence_coding::delta>;
+
+    template <typename Container>
+    using delta_of_delta = coded_sequence<Container, sequence_coding::delta_of_delta>;
+
+    template <typename Container>
+    using frame_of_reference = coded_sequence<Container, sequence_coding::frame_of_reference>;
+
+    namespace detail {
+
+        /**
+         * Maps signed values to unsigned ones of the same order, so block minimums and offsets stay unsigned.
+         */
+        template <std::integral T>
+        [[nodiscard]] constexpr std::make_unsigned_t<T> order_preserving(T value) noexcept {
+            using unsigned_type = std::make_unsigned_t<T>;
+            if constexpr (std::is_signed_v<T>) {
+                return static_cast<unsigned_type>(static_cast<unsigned_type>(value) ^ (unsigned_type{ 1 } << (sizeof(T) * 8 - 1)));
+            } else {
+                return value;
+            }
+        }
+
+        /**
+         * Produces the wire form of a coded sequence as a header of varints followed by residual blocks;
+         * the writer and serialized_size both walk it with their own sink:
+         *     sink.varint(value)
+         *     sink.block(reference, residuals, count, bits)   reference is the block minimum, FOR only
+         */
+        template <sequence_coding Coding, std::integral T, typename Sink>
+        void encode_sequence(const T* values, std::size_t count, Sink& sink) {
+            using unsigned_type = std::make_unsigned_t<T>;
+            using signed_type = std::make_signed_t<T>;
+            const auto difference = [](unsigned_type left, unsigned_type right) {
+                return static_cast<unsigned_type>(left - right);
+            };
+            const auto zigzag = [](unsigned_type value) { return zigzag_encode(static_cast<signed_type>(value)); };
+            std::array<unsigned_type, bit_pack::block_size> residuals;
+
+            std::size_t first = 0;
+            if constexpr (Coding == sequence_coding::delta) {
+                if (count != 0) {
+                    sink.varint(to_varint(values[0]));
+                    first = 1;
+                }
+            } else if constexpr (Coding == sequence_coding::delta_of_delta) {
+                if (count != 0) {
+                    sink.varint(to_varint(values[0]));
+                    first = 1;
+                }
+                if (count > 1) {
+                    sink.varint(zigzag(difference(values[1], values[0])));
+                    first = 2;
+                }
+            }
+            for (; first < count; first += bit_pack::block_size) {
+                const std::size_t block = std::min(bit_pack::block_size, count - first);
+                unsigned_type reference = 0;
+                if constexpr (Coding == sequence_coding::frame_of_reference) {
+                    reference = std::numeric_limits<unsigned_type>::max();
+                    for (std::size_t i = 0; i < block; ++i) {
+                        reference = std::min(reference, order_preserving(values[first + i]));
+                    }
+                }
+                for (std::size_t i = 0; i < block; ++i) {
+                    const std::size_t index = first + i;
+                    if constexpr (Coding == sequence_coding::delta) {
+                        residuals[i] = zigzag(difference(values[index], values[index - 1]));
+                    } else if constexpr (Coding == sequence_coding::delta_of_delta) {
+                        residuals[i] = zigzag(difference(difference(values[index], values[index - 1]),
+                            difference(values[index - 1], values[index - 2])));
+                    } else {
+                        residuals[i] = difference(order_preserving(values[index]), reference);
+                    }
+                }
+                sink.block(reference, residuals.data(), block, bit_pack::width(residuals.data(), block));
+            }
+        }
+
+        template <bool Reference>
+        struct coded_size_sink final {
+            std::size_t size = 0;
+
+            void varint(std::uint64_t value) noexcept { size += varint_size(value); }
+
+            template <typename U>
+            void block(U reference, const U*, std::size_t count, unsigned bits) noexcept {
+                size += 1 + bit_pack::packed_size(count, bits);
+                if constexpr (Reference) {
+                    size += varint_size(reference);
+                }
+            }
+        };
+
+    }
+
+    template <typename Container, sequence_coding Coding>
+    struct serializer<coded_sequence<Container, Coding>> {
+        using value_type = typename Container::value_type;
+        using unsigned_type = std::make_unsigned_t<value_type>;
+
+        static constexpr bool has_reference = Coding == sequence_coding::frame_of_reference;
+
+        template <typename Writer>
+        static void write(Writer& writer, const coded_sequence<Container, Coding>& values) {
+            struct sink final {
+                Writer& writer;
+
+                void varint(std::uint64_t value) { writer.write_varint(value); }
+
+                void block(unsigned_type reference, const unsigned_type* residuals, std::size_t count, unsigned bits) {
+                    if constexpr (has_reference) {
+                        writer.write_varint(reference);
+                    }
+                    std::array<std::uint8_t, 1 + detail::bit_pack::max_block_bytes> bytes;
+                    bytes[0] = static_cast<std::uint8_t>(bits);
+                    detail::bit_pack::pack(residuals, count, bits, bytes.data() + 1);
+                    writer.write_bytes(bytes.data(), 1 + detail::bit_pack::packed_size(count, bits));
+                }
+            } out{ writer };
+            writer.write_size(std::ranges::size(values));
+            detail::encode_sequence<Coding>(std::ranges::data(values), std::ranges::size(values), out);
+        }
+
+        template <format Format>
+        static std::size_t serialized_size(const coded_sequence<Container, Coding>& values) {
+            detail::coded_size_sink<has_reference> sink;
+            detail::encode_sequence<Coding>(std::ranges::data(values), std::ranges::size(values), sink);
+            return detail::size_prefix_size<Format>(std::ranges::size(values)) + sink.size;
+        }
+
+        template <typename Reader>
+        static void read(Reader& reader, coded_sequence<Container, Coding>& values) {
+            std::uint64_t size;
+            if constexpr (Reader::wire_format.integers == integer_encoding::varint) {
+                size = reader.template read_varint<std::uint64_t>();
+            } else {
+                size = reader.template read<std::uint64_t>();
+            }
+            // a block takes at least its width byte
+            if constexpr (sized_input_stream<typename Reader::stream_type>) {
+                if (size / detail::bit_pack::block_size > reader.stream().remaining()) [[unlikely]] {
+                    throw error("hope::serialization: length prefix exceeds the remaining input");
+                }
+            } else if (size > std::numeric_limits<std::size_t>::max() / sizeof(value_type)) [[unlikely]] {
+                throw error("hope::serialization: length prefix does not fit into size_t");
+            }
+            const auto count = static_cast<std::size_t>(size);
+            values.resize(count);
+            auto* out = reinterpret_cast<unsigned_type*>(std::ranges::data(values));
+
+            std::size_t first = 0;
+            unsigned_type start = 0;
+            unsigned_type first_difference = 0;
+            if constexpr (Coding != sequence_coding::frame_of_reference) {
+                if (count != 0) {
+                    start = static_cast<unsigned_type>(detail::from_varint<value_type>(
+                        reader.template read_varint<detail::varint_unsigned_t<value_type>>()));
+                    out[0] = start;
+                    first = 1;
+                }
+            }
+            if constexpr (Coding == sequence_coding::delta_of_delta) {
+                if (count > 1) {
+                    first_difference = unzigzag(reader.template read_varint<unsigned_type>());
+                    first = 2;
+                }
+            }
+            for (std::size_t block_first = first; block_first < count; block_first += detail::bit_pack::block_size) {
+                const std::size_t block = std::min(detail::bit_pack::block_size, count - block_first);
+                unsigned_type reference = 0;
+                if constexpr (has_reference) {
+                    reference = reader.template read_varint<unsigned_type>();
+                }
+                std::uint8_t bits;
+                reader.read_bytes(&bits, 1);
+                if (bits > sizeof(value_type) * 8) [[unlikely]] {
+                    throw error("hope::serialization: invalid bit width");
+                }
+                std::array<std::uint8_t, detail::bit_pack::max_block_bytes + detail::bit_pack::padding> bytes;
+                reader.read_bytes(bytes.data(), detail::bit_pack::packed_size(block, bits));
+                unsigned_type* residuals = out + block_first;
+                detail::bit_pack::unpack(bytes.data(), block, bits, residuals);
+                if constexpr (has_reference) {
+                    for (std::size_t i = 0; i < block; ++i) {
+                        residuals[i] = from_order_preserving(static_cast<unsigned_type>(residuals[i] + reference));
+                    }
+                } else {
+                    for (std::size_t i = 0; i < block; ++i) {
+                        residuals[i] = unzigzag(residuals[i]);
+                    }
+                }
+            }
+            if constexpr (Coding == sequence_coding::delta) {
+                if (count > 1) {
+                    detail::prefix_sum(out + 1, count - 1, start);
+                }
+            } else if constexpr (Coding == sequence_coding::delta_of_delta) {
+                if (count > 1) {
+                    out[1] = first_difference;
+                    detail::prefix_sum(out + 2, count - 2, first_difference);
+                    detail::prefix_sum(out + 1, count - 1, start);
+                }
+            }
+        }
+
+    private:
+        static unsigned_type unzigzag(unsigned_type value) noexcept {
+            return static_cast<unsigned_type>(zigzag_decode(value));
+        }
+
+        static unsigned_type from_order_preserving(unsigned_type value) noexcept {
+            if constexpr (std::is_signed_v<value_type>) {
+                return static_cast<unsigned_type>(value ^ (unsigned_type{ 1 } << (sizeof(value_type) * 8 - 1)));
+            } else {
+                return value;
+            }
+        }
+    };
+
+}
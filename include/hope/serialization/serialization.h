@@ -0,0 +1,90 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/bounded.h"
+#include "hope/serialization/compression.h"
+#include "hope/serialization/framing.h"
+#include "hope/serialization/gather_buffer.h"
+#include "hope/serialization/reader.h"
+#include "hope/serialization/registry.h"
+#include "hope/serialization/sequence_coding.h"
+#include "hope/serialization/session.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/writer.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+namespace hope::serialization {
+
+    /**
+     * Appends the encoding of value to buffer. The buffer grows at most once, to the exact size needed plus
+     * the room in-place encoders ask for at the end.
+     */
+    template <format Format = format{}, typename T>
+    void serialize(const T& value, output_buffer& buffer) {
+        buffer.reserve(buffer.size() + serialized_size<Format>(value) + detail::max_prepare_size);
+        writer<output_buffer, Format>(buffer).write(value);
+    }
+
+    template <format Format = format{}, typename T>
+    [[nodiscard]] std::vector<std::uint8_t> serialize(const T& value) {
+        output_buffer buffer;
+        serialize<Format>(value, buffer);
+        return buffer.release();
+    }
+
+    template <format Format = format{}, typename T>
+    void deserialize(std::span<const std::uint8_t> bytes, T& value) {
+        input_buffer buffer(bytes);
+        reader<input_buffer, Format>(buffer).read(value);
+    }
+
+    template <typename T, format Format = format{}>
+    [[nodiscard]] T deserialize(std::span<const std::uint8_t> bytes) {
+        input_buffer buffer(bytes);
+        return reader<input_buffer, Format>(buffer).template read<T>();
+    }
+
+    /**
+     * Decodes with every std::pmr container allocating from resource, typically an arena reset per batch.
+     */
+    template <typename T, format Format = format{}>
+    [[nodiscard]] T deserialize(std::span<const std::uint8_t> bytes, std::pmr::memory_resource* resource) {
+        input_buffer buffer(bytes);
+        return reader<input_buffer, Format>(buffer, resource).template read<T>();
+    }
+
+    /**
+     * Checks that bytes start with a well formed T: every length prefix, varint, field key and offset is
+     * checked against the input in one pass, nothing is decoded or allocated. Throws error when it is not.
+     * Bytes that passed can be decoded with deserialize_unchecked.
+     */
+    template <typename T, format Format = format{}>
+    void validate(std::span<const std::uint8_t> bytes) {
+        input_buffer buffer(bytes);
+        reader<input_buffer, Format>(buffer).template validate<T>();
+    }
+
+    /**
+     * Decodes bytes validate<T, Format>() accepted without a bounds check per field. Anything else is undefined
+     * behaviour; untrusted input goes through deserialize, which checks as it decodes.
+     */
+    template <format Format = format{}, typename T>
+    void deserialize_unchecked(std::span<const std::uint8_t> bytes, T& value) {
+        unchecked_input_buffer buffer(bytes);
+        reader<unchecked_input_buffer, Format>(buffer).read(value);
+    }
+
+    template <typename T, format Format = format{}>
+    [[nodiscard]] T deserialize_unchecked(std::span<const std::uint8_t> bytes, std::pmr::memory_resource* resource = nullptr) {
+        unchecked_input_buffer buffer(bytes);
+        return reader<unchecked_input_buffer, Format>(buffer, resource).template read<T>();
+    }
+
+}
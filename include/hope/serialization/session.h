@@ -0,0 +1,111 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/reader.h"
+#include "hope/serialization/writer.h"
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+namespace hope::serialization {
+
+    /**
+     * Connection preamble: magic, preamble revision and the application's schema version, sent once by
+     * each peer right after connecting.
+     */
+    inline constexpr std::array<std::uint8_t, 4> hello_magic{ 'H', 'O', 'P', 'E' };
+    inline constexpr std::uint8_t hello_revision = 1;
+
+    template <output_stream Stream>
+    void send_hello(Stream& stream, std::uint64_t schema_version) {
+        writer<Stream, fixed_format> out(stream);
+        out.write(hello_magic);
+        out.write(hello_revision);
+        out.write(schema_version);
+    }
+
+    /**
+     * Reads the peer's preamble and returns its schema version.
+     */
+    template <input_stream Stream>
+    [[nodiscard]] std::uint64_t receive_hello(Stream& stream) {
+        reader<Stream, fixed_format> in(stream);
+        if (in.template read<std::array<std::uint8_t, 4>>() != hello_magic) [[unlikely]] {
+            throw error("hope::serialization: peer did not send a hello");
+        }
+        if (in.template read<std::uint8_t>() != hello_revision) [[unlikely]] {
+            throw error("hope::serialization: unsupported hello revision");
+        }
+        return in.template read<std::uint64_t>();
+    }
+
+    /**
+     * Peers on the same schema version skip the tags entirely; everyone else pays for them.
+     */
+    [[nodiscard]] constexpr struct_layout negotiate_layout(std::uint64_t local_version, std::uint64_t remote_version) noexcept {
+        return local_version == remote_version ? struct_layout::frozen : struct_layout::tagged;
+    }
+
+    /**
+     * Per-connection codec holding the negotiated layout. Both layouts of Base are instantiated up front,
+     * so each message costs one predictable branch and then runs fully specialized code; the negotiation
+     * itself happens once, when the session is created.
+     */
+    template <format Base = varint_format>
+    class session final {
+    public:
+        static constexpr format frozen_format = with_layout(Base, struct_layout::frozen);
+        static constexpr format tagged_format = with_layout(Base, struct_layout::tagged);
+
+        explicit session(struct_layout layout) noexcept
+            : layout_(layout) {}
+
+        session(std::uint64_t local_version, std::uint64_t remote_version) noexcept
+            : layout_(negotiate_layout(local_version, remote_version)) {}
+
+        [[nodiscard]] struct_layout layout() const noexcept { return layout_; }
+
+        template <output_stream Stream, typename T>
+        void write(Stream& stream, const T& value) const {
+            visit([&]<format Format>(std::integral_constant<format, Format>) { writer<Stream, Format>(stream).write(value); });
+        }
+
+        template <input_stream Stream, typename T>
+        void read(Stream& stream, T& value, std::pmr::memory_resource* resource = nullptr) const {
+            visit([&]<format Format>(std::integral_constant<format, Format>) { reader<Stream, Format>(stream, resource).read(value); });
+        }
+
+        /**
+         * Calls visitor with std::integral_constant<format, F> for the negotiated format F, for callers that
+         * keep their own writer or reader around.
+         */
+        template <typename Visitor>
+        decltype(auto) visit(Visitor&& visitor) const {
+            if (layout_ == struct_layout::frozen) {
+                return std::forward<Visitor>(visitor)(std::integral_constant<format, frozen_format>{});
+            }
+            return std::forward<Visitor>(visitor)(std::integral_constant<format, tagged_format>{});
+        }
+
+    private:
+        struct_layout layout_;
+    };
+
+    /**
+     * Exchanges hellos over a connection and returns the session both peers will agree on.
+     */
+    template <format Base = varint_format, output_stream Output, input_stream Input>
+    [[nodiscard]] session<Base> handshake(Output& output, Input& input, std::uint64_t schema_version) {
+        send_hello(output, schema_version);
+        return session<Base>(schema_version, receive_hello(input));
+    }
+
+}
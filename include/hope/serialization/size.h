@@ -0,0 +1,333 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/bit_pack.h"
+#include "hope/serialization/detail/stream_vbyte.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/tagged.h"
+#include "hope/serialization/traits.h"
+#include "hope/serialization/varint.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <tuple>
+#include <utility>
+#include <variant>
+
+namespace hope::serialization {
+
+    template <output_stream Stream, format Format>
+    class writer;
+
+    /**
+     * Marks types whose encoded size depends on the value.
+     */
+    inline constexpr std::size_t dynamic_size = std::numeric_limits<std::size_t>::max();
+
+    namespace detail {
+
+        /**
+         * Largest prepare() the writer issues; an exactly sized buffer needs this much slack at its end.
+         */
+        inline constexpr std::size_t max_prepare_size = stream_vbyte::max_block_bytes;
+
+        static_assert(max_prepare_size >= max_varint_size && max_prepare_size <= byte_counter::max_prepare);
+
+        template <format Format>
+        [[nodiscard]] constexpr std::size_t size_prefix_size(std::size_t size) noexcept {
+            if constexpr (Format.integers == integer_encoding::varint) {
+                return varint_size(size);
+            } else {
+                return sizeof(std::uint64_t);
+            }
+        }
+
+        template <typename T, format Format>
+        constexpr std::size_t static_size();
+
+        template <typename Fields, format Format, std::size_t... I>
+        constexpr std::size_t static_fields_size(std::index_sequence<I...>) {
+            constexpr std::array<std::size_t, sizeof...(I)> sizes{ static_size<field_t<Fields, I>, Format>()... };
+            std::size_t total = 0;
+            for (const auto size : sizes) {
+                if (size == dynamic_size) {
+                    return dynamic_size;
+                }
+                total += size;
+            }
+            return total;
+        }
+
+        /**
+         * static_fields_size for the fields of a reflected type, where every run of bit fields takes
+         * its bits rounded up to whole bytes.
+         */
+        template <typename Fields, format Format, std::size_t... I>
+        constexpr std::size_t static_record_size(std::index_sequence<I...>) {
+            constexpr std::array<std::size_t, sizeof...(I)> sizes{ static_size<field_t<Fields, I>, Format>()... };
+            constexpr std::array<unsigned, sizeof...(I)> widths{ packed_width<field_t<Fields, I>, Format>()... };
+            std::size_t total = 0;
+            std::size_t bits = 0;
+            for (std::size_t i = 0; i < sizes.size(); ++i) {
+                if (widths[i] != 0) {
+                    bits += widths[i];
+                    continue;
+                }
+                total += (bits + 7) / 8;
+                bits = 0;
+                if (sizes[i] == dynamic_size) {
+                    return dynamic_size;
+                }
+                total += sizes[i];
+            }
+            return total + (bits + 7) / 8;
+        }
+
+        /**
+         * A tagged struct has a static size when every field does and none of them is optional; keys are
+         * constants as well.
+         */
+        template <typename T, format Format, std::size_t... I>
+        constexpr std::size_t static_tagged_size(std::index_sequence<I...>) {
+            using fields = fields_tuple_t<T>;
+            constexpr auto ids = field_ids<T>();
+            if constexpr ((optional_like<field_t<fields, I>> || ...)) {
+                return dynamic_size;
+            } else {
+                constexpr std::array<std::size_t, sizeof...(I)> sizes{ static_size<field_t<fields, I>, Format>()... };
+                constexpr std::array<wire_type, sizeof...(I)> types{ wire_type_of<field_t<fields, I>, Format>()... };
+                std::size_t total = 1;
+                for (std::size_t i = 0; i < sizes.size(); ++i) {
+                    if (sizes[i] == dynamic_size) {
+                        return dynamic_size;
+                    }
+                    total += varint_size(field_key(ids[i], types[i])) + sizes[i];
+                    if (types[i] == wire_type::length_delimited) {
+                        total += size_prefix_size<Format>(sizes[i]);
+                    }
+                }
+                return total;
+            }
+        }
+
+        /**
+         * Encoded size of every value of type T, dynamic_size when it depends on the value.
+         */
+        template <typename T, format Format>
+        constexpr std::size_t static_size() {
+            if constexpr (has_serializer<T> || varint_integer<T, Format>) {
+                return dynamic_size;
+            } else if constexpr (bit_field<T, Format>) {
+                return bit_field_bytes_v<T>;
+            } else if constexpr (raw<T, Format> || byte_swapped<T, Format>) {
+                return sizeof(T);
+            } else if constexpr (tuple_like<T>) {
+                return static_fields_size<T, Format>(std::make_index_sequence<std::tuple_size_v<T>>{});
+            } else if constexpr (bit_field_array<T, Format>) {
+                return bit_pack::packed_size(fixed_array_size<T>(), bit_width_v<std::remove_cv_t<std::ranges::range_value_t<T>>>);
+            } else if constexpr (fixed_array<T>) {
+                constexpr auto element = static_size<std::remove_cv_t<std::ranges::range_value_t<T>>, Format>();
+                return element == dynamic_size ? dynamic_size : element * fixed_array_size<T>();
+            } else if constexpr (string_like<T> || span_like<T> || optional_like<T> || std::ranges::range<T>) {
+                return dynamic_size;
+            } else if constexpr (reflectable<T> && Format.layout == struct_layout::tagged) {
+                return static_tagged_size<T, Format>(std::make_index_sequence<field_count_v<T>>{});
+            } else if constexpr (reflectable<T>) {
+                return static_record_size<fields_tuple_t<T>, Format>(std::make_index_sequence<field_count_v<T>>{});
+            } else {
+                return dynamic_size;
+            }
+        }
+
+    }
+
+    /**
+     * Encoded size of T when it does not depend on the value (fixed width scalars and aggregates, arrays
+     * and tuples of them), dynamic_size otherwise.
+     */
+    template <typename T, format Format = format{}>
+    inline constexpr std::size_t static_serialized_size_v = detail::static_size<std::remove_cv_t<T>, Format>();
+
+    template <format Format = format{}, typename T>
+    [[nodiscard]] constexpr std::size_t serialized_size(const T& value);
+
+    namespace detail {
+
+        template <format Format, typename Range>
+        constexpr std::size_t elements_size(const Range& range) {
+            using element_type = std::remove_cv_t<std::ranges::range_value_t<const Range>>;
+            constexpr auto element = static_serialized_size_v<element_type, Format>;
+            if constexpr (bit_field<element_type, Format>) {
+                return bit_pack::packed_size(std::ranges::size(range), bit_width_v<element_type>);
+            } else if constexpr (element != dynamic_size && std::ranges::sized_range<const Range>) {
+                return element * std::ranges::size(range);
+            } else if constexpr (Format.integers == integer_encoding::varint && std::ranges::contiguous_range<const Range>
+                && stream_vbyte::element<element_type>) {
+                return stream_vbyte::encoded_size(std::ranges::data(range), std::ranges::size(range));
+            } else {
+                std::size_t size = 0;
+                for (const auto& value : range) {
+                    size += serialized_size<Format>(value);
+                }
+                return size;
+            }
+        }
+
+        template <format Format, std::size_t I, typename Range>
+        constexpr std::size_t column_size(const Range& range) {
+            using element_type = std::remove_cv_t<std::ranges::range_value_t<const Range>>;
+            using field_type = field_t<fields_tuple_t<element_type>, I>;
+            constexpr auto field = static_serialized_size_v<field_type, Format>;
+            if constexpr (bit_field<field_type, Format>) {
+                return bit_pack::packed_size(std::ranges::size(range), bit_width_v<field_type>);
+            } else if constexpr (field != dynamic_size) {
+                return field * std::ranges::size(range);
+            } else if constexpr (Format.integers == integer_encoding::varint && stream_vbyte::element<field_type>) {
+                std::size_t size = (std::ranges::size(range) + 3) / 4;
+                for (const auto& element : range) {
+                    size += stream_vbyte::value_size(std::get<I>(tie_fields(element)));
+                }
+                return size;
+            } else {
+                std::size_t size = 0;
+                for (const auto& element : range) {
+                    size += serialized_size<Format>(std::get<I>(tie_fields(element)));
+                }
+                return size;
+            }
+        }
+
+        template <format Format, typename Range>
+        constexpr std::size_t columns_size(const Range& range) {
+            using element_type = std::remove_cv_t<std::ranges::range_value_t<const Range>>;
+            return [&]<std::size_t... I>(std::index_sequence<I...>) {
+                return (column_size<Format, I>(range) + ... + 0);
+            }(std::make_index_sequence<field_count_v<element_type>>{});
+        }
+
+        /**
+         * A run of bit fields is counted once, at its first field.
+         */
+        template <format Format, std::size_t I, typename Fields>
+        constexpr std::size_t record_field_size(const Fields& fields) {
+            if constexpr (!bit_field<field_t<Fields, I>, Format>) {
+                return serialized_size<Format>(std::get<I>(fields));
+            } else if constexpr (packed_run_start<Fields, Format>(I)) {
+                return packed_run_bytes<Fields, Format, I, packed_run_end<Fields, Format>(I)>();
+            } else {
+                return 0;
+            }
+        }
+
+        template <format Format, typename Fields>
+        constexpr std::size_t record_size(const Fields& fields) {
+            return [&]<std::size_t... I>(std::index_sequence<I...>) {
+                return (record_field_size<Format, I>(fields) + ... + 0);
+            }(std::make_index_sequence<std::tuple_size_v<Fields>>{});
+        }
+
+        template <format Format, std::uint32_t Id, typename T>
+        constexpr std::size_t tagged_field_size(const T& value) {
+            if constexpr (optional_like<T>) {
+                return value ? tagged_field_size<Format, Id>(*value) : 0;
+            } else {
+                constexpr auto type = wire_type_of<T, Format>();
+                const std::size_t size = serialized_size<Format>(value);
+                std::size_t total = varint_size(field_key(Id, type)) + size;
+                if constexpr (type == wire_type::length_delimited) {
+                    total += size_prefix_size<Format>(size);
+                }
+                return total;
+            }
+        }
+
+        /**
+         * Tag plus the object as its concrete class; classes missing from HOPE_SUBTYPES are reported by the
+         * writer, here they count as the tag alone.
+         */
+        template <format Format, typename Pointer>
+        std::size_t polymorphic_size(const Pointer& pointer) {
+            using base_type = typename Pointer::element_type;
+            using subtypes = typename base_type::hope_subtypes;
+            static constexpr auto sizes = []<typename... Types>(type_list<Types...>) {
+                return std::array<std::size_t (*)(const base_type&), sizeof...(Types)>{
+                    [](const base_type& object) { return serialized_size<Format>(static_cast<const Types&>(object)); }...
+                };
+            }(subtypes{});
+            using tag_type = choice_tag_t<subtypes::size + 1>;
+            const std::size_t index = pointer ? pointer->hope_subtype() : subtypes::size;
+            if (index >= subtypes::size) {
+                return serialized_size<Format>(tag_type{ 0 });
+            }
+            return serialized_size<Format>(static_cast<tag_type>(index + 1)) + sizes[index](*pointer);
+        }
+
+        template <format Format, typename T, typename Fields>
+        constexpr std::size_t tagged_size(const Fields& fields) {
+            constexpr auto ids = field_ids<T>();
+            return [&]<std::size_t... I>(std::index_sequence<I...>) {
+                return (tagged_field_size<Format, ids[I]>(std::get<I>(fields)) + ... + varint_size(end_of_fields));
+            }(std::make_index_sequence<ids.size()>{});
+        }
+
+    }
+
+    /**
+     * Exact number of bytes writer<Stream, Format> produces for value; mirrors the writer rule for rule.
+     * Constant for types with a static size, otherwise a walk over the value that only looks at lengths
+     * and integers, never at string or array contents. Serializer specializations can provide
+     *     template <format Format> static std::size_t serialized_size(const T&);
+     * otherwise the value is encoded into a byte_counter.
+     */
+    template <format Format, typename T>
+    constexpr std::size_t serialized_size(const T& value) {
+        if constexpr (static_serialized_size_v<T, Format> != dynamic_size) {
+            return static_serialized_size_v<T, Format>;
+        } else if constexpr (detail::has_serializer<T>) {
+            if constexpr (requires { serializer<T>::template serialized_size<Format>(value); }) {
+                return serializer<T>::template serialized_size<Format>(value);
+            } else {
+                byte_counter counter;
+                writer<byte_counter, Format>(counter).write(value);
+                return counter.size();
+            }
+        } else if constexpr (detail::varint_integer<T, Format>) {
+            return varint_size(detail::to_varint(value));
+        } else if constexpr (detail::string_like<T> || detail::span_like<T>) {
+            return detail::size_prefix_size<Format>(value.size()) + detail::elements_size<Format>(value);
+        } else if constexpr (detail::optional_like<T>) {
+            return 1 + (value ? serialized_size<Format>(*value) : 0);
+        } else if constexpr (detail::variant_like<T>) {
+            using tag_type = detail::choice_tag_t<std::variant_size_v<T>>;
+            if (value.valueless_by_exception()) {
+                return serialized_size<Format>(tag_type{ 0 }); // the writer rejects it
+            }
+            return serialized_size<Format>(static_cast<tag_type>(value.index()))
+                + std::visit([](const auto& alternative) { return serialized_size<Format>(alternative); }, value);
+        } else if constexpr (detail::polymorphic_pointer<T>) {
+            return detail::polymorphic_size<Format>(value);
+        } else if constexpr (detail::tuple_like<T>) {
+            return std::apply([](const auto&... elements) { return (serialized_size<Format>(elements) + ... + 0); }, value);
+        } else if constexpr (detail::fixed_array<T>) {
+            return detail::elements_size<Format>(value);
+        } else if constexpr (detail::columnar<T, Format>) {
+            return detail::size_prefix_size<Format>(std::ranges::size(value)) + detail::columns_size<Format>(value);
+        } else if constexpr (detail::sequence_container<T> || detail::associative_container<T>) {
+            return detail::size_prefix_size<Format>(std::ranges::size(value)) + detail::elements_size<Format>(value);
+        } else if constexpr (detail::reflectable<T> && Format.layout == struct_layout::tagged) {
+            return detail::tagged_size<Format, T>(detail::tie_fields(value));
+        } else if constexpr (detail::reflectable<T>) {
+            return detail::record_size<Format>(detail::tie_fields(value));
+        } else {
+            static_assert(detail::dependent_false<T>,
+                "hope::serialization: type is not serializable, specialize hope::serialization::serializer");
+        }
+    }
+
+}
@@ -0,0 +1,250 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/error.h"
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace hope::serialization {
+
+    /**
+     * Anything the writer can push bytes into. Streams are taken by reference and called directly,
+     * so a concrete stream type costs nothing beyond its own write().
+     */
+    template <typename Stream>
+    concept output_stream = requires(Stream& stream, const void* data, std::size_t size) {
+        stream.write(data, size);
+    };
+
+    /**
+     * Anything the reader can pull bytes from. read() must either fill the whole range or throw.
+     */
+    template <typename Stream>
+    concept input_stream = requires(Stream& stream, void* data, std::size_t size) {
+        stream.read(data, size);
+    };
+
+    /**
+     * Input streams that know how many bytes are left; the reader uses it to reject
+     * length prefixes that cannot possibly be satisfied before allocating for them.
+     */
+    template <typename Stream>
+    concept sized_input_stream = input_stream<Stream> && requires(const Stream& stream) {
+        { stream.remaining() } -> std::convertible_to<std::size_t>;
+    };
+
+    /**
+     * Output streams that can hand out writable memory directly: prepare(n) returns room for at least n bytes,
+     * commit(k) publishes the first k of them. Variable-length encodings are produced in place through it.
+     */
+    template <typename Stream>
+    concept contiguous_output_stream = output_stream<Stream> && requires(Stream& stream, std::size_t size) {
+        { stream.prepare(size) } -> std::same_as<std::uint8_t*>;
+        stream.commit(size);
+    };
+
+    /**
+     * Input streams backed by memory: peek() points at the next unread byte, consume(n) checks that n bytes
+     * are available, skips them and returns where they start. Lets decoders work on the input in place.
+     */
+    template <typename Stream>
+    concept contiguous_input_stream = sized_input_stream<Stream> && requires(Stream& stream, std::size_t size) {
+        { stream.peek() } -> std::same_as<const std::uint8_t*>;
+        { stream.consume(size) } -> std::same_as<const std::uint8_t*>;
+    };
+
+    /**
+     * Memory backed input streams that skip bounds checks (they declare bounds_checked = false). The reader
+     * drops its own length checks for them as well, so decoding compiles down to plain loads and copies.
+     * Only input that already passed validate() may be decoded through them.
+     */
+    template <typename Stream>
+    concept unchecked_input_stream = contiguous_input_stream<Stream> && requires {
+        requires !Stream::bounds_checked;
+    };
+
+    /**
+     * Output streams that can keep a reference to caller memory instead of copying it. The writer hands
+     * contiguous raw data (strings, byte and POD arrays) to write_reference(); the stream may still copy
+     * it, typically when it is small. Referenced memory must stay valid until the output is consumed.
+     */
+    template <typename Stream>
+    concept referencing_output_stream = output_stream<Stream> && requires(Stream& stream, const void* data, std::size_t size) {
+        stream.write_reference(data, size);
+    };
+
+    /**
+     * Growable in-memory output. Keeps its own size separately from the vector so that small writes
+     * are a capacity check plus memcpy, without going through vector::insert.
+     */
+    class output_buffer final {
+    public:
+        output_buffer() = default;
+
+        /**
+         * Adopts the storage (and capacity) of an existing vector, its contents are discarded.
+         */
+        explicit output_buffer(std::vector<std::uint8_t> storage) noexcept
+            : storage_(std::move(storage)) {
+            storage_.resize(storage_.capacity());
+        }
+
+        void write(const void* data, std::size_t size) {
+            if (size > storage_.size() - size_) [[unlikely]] {
+                grow(size);
+            }
+            std::memcpy(storage_.data() + size_, data, size);
+            size_ += size;
+        }
+
+        [[nodiscard]] std::uint8_t* prepare(std::size_t size) {
+            if (size > storage_.size() - size_) [[unlikely]] {
+                grow(size);
+            }
+            return storage_.data() + size_;
+        }
+
+        void commit(std::size_t size) noexcept { size_ += size; }
+
+        void reserve(std::size_t capacity) {
+            if (capacity > storage_.size()) {
+                storage_.resize(capacity);
+            }
+        }
+
+        void clear() noexcept { size_ = 0; }
+
+        /**
+         * Drops what was written after the first size bytes, e.g. a value whose encoding failed halfway.
+         */
+        void truncate(std::size_t size) noexcept { size_ = std::min(size_, size); }
+
+        [[nodiscard]] const std::uint8_t* data() const noexcept { return storage_.data(); }
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+        [[nodiscard]] std::size_t capacity() const noexcept { return storage_.size(); }
+        [[nodiscard]] std::span<const std::uint8_t> view() const noexcept { return { storage_.data(), size_ }; }
+
+        /**
+         * Hands the written bytes over to the caller and leaves the buffer empty.
+         */
+        [[nodiscard]] std::vector<std::uint8_t> release() noexcept {
+            storage_.resize(size_);
+            size_ = 0;
+            return std::move(storage_);
+        }
+
+    private:
+        void grow(std::size_t extra) {
+            storage_.resize(std::max({ size_ + extra, storage_.size() * 2, std::size_t{ 64 } }));
+        }
+
+        std::vector<std::uint8_t> storage_;
+        std::size_t size_{ 0 };
+    };
+
+    /**
+     * Output stream that only counts what is written to it; running a writer over it measures an encoding
+     * without producing it. prepare() hands out a scratch area of max_prepare bytes, so in-place encoders
+     * work unchanged.
+     */
+    class byte_counter final {
+    public:
+        static constexpr std::size_t max_prepare = 512;
+
+        void write(const void*, std::size_t size) noexcept { size_ += size; }
+
+        [[nodiscard]] std::uint8_t* prepare([[maybe_unused]] std::size_t size) noexcept { return scratch_; }
+
+        void commit(std::size_t size) noexcept { size_ += size; }
+
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+    private:
+        std::uint8_t scratch_[max_prepare];
+        std::size_t size_{ 0 };
+    };
+
+    /**
+     * Non-owning cursor over a contiguous byte range; every read is bounds checked.
+     */
+    class input_buffer final {
+    public:
+        input_buffer(const void* data, std::size_t size) noexcept
+            : begin_(static_cast<const std::uint8_t*>(data))
+            , cursor_(begin_)
+            , end_(begin_ + size) {}
+
+        explicit input_buffer(std::span<const std::uint8_t> data) noexcept
+            : input_buffer(data.data(), data.size()) {}
+
+        void read(void* data, std::size_t size) {
+            if (size > remaining()) [[unlikely]] {
+                throw error("hope::serialization: unexpected end of input");
+            }
+            std::memcpy(data, cursor_, size);
+            cursor_ += size;
+        }
+
+        [[nodiscard]] const std::uint8_t* peek() const noexcept { return cursor_; }
+
+        [[nodiscard]] const std::uint8_t* consume(std::size_t size) {
+            if (size > remaining()) [[unlikely]] {
+                throw error("hope::serialization: unexpected end of input");
+            }
+            return std::exchange(cursor_, cursor_ + size);
+        }
+
+        [[nodiscard]] std::size_t remaining() const noexcept { return static_cast<std::size_t>(end_ - cursor_); }
+        [[nodiscard]] std::size_t position() const noexcept { return static_cast<std::size_t>(cursor_ - begin_); }
+
+    private:
+        const std::uint8_t* begin_;
+        const std::uint8_t* cursor_;
+        const std::uint8_t* end_;
+    };
+
+    /**
+     * Cursor over bytes validate() accepted for the type about to be decoded. Same interface as input_buffer
+     * without a single bounds check; on any other input, reads run past the end.
+     */
+    class unchecked_input_buffer final {
+    public:
+        static constexpr bool bounds_checked = false;
+
+        unchecked_input_buffer(const void* data, std::size_t size) noexcept
+            : begin_(static_cast<const std::uint8_t*>(data))
+            , cursor_(begin_)
+            , end_(begin_ + size) {}
+
+        explicit unchecked_input_buffer(std::span<const std::uint8_t> data) noexcept
+            : unchecked_input_buffer(data.data(), data.size()) {}
+
+        void read(void* data, std::size_t size) noexcept {
+            std::memcpy(data, cursor_, size);
+            cursor_ += size;
+        }
+
+        [[nodiscard]] const std::uint8_t* peek() const noexcept { return cursor_; }
+
+        [[nodiscard]] const std::uint8_t* consume(std::size_t size) noexcept { return std::exchange(cursor_, cursor_ + size); }
+
+        [[nodiscard]] std::size_t remaining() const noexcept { return static_cast<std::size_t>(end_ - cursor_); }
+        [[nodiscard]] std::size_t position() const noexcept { return static_cast<std::size_t>(cursor_ - begin_); }
+
+    private:
+        const std::uint8_t* begin_;
+        const std::uint8_t* cursor_;
+        const std::uint8_t* end_;
+    };
+
+}
@@ -0,0 +1,123 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/format.h"
+#include "hope/serialization/reflection.h"
+#include "hope/serialization/traits.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+/**
+ * Tagged layout: a reflected type is written as a sequence of (key, value) pairs closed by a zero key.
+ * The key is the varint (field_id << 3 | wire_type); the wire type tells a reader that does not know the
+ * field how to step over it, so peers on different schema versions can still talk.
+ */
+namespace hope::serialization {
+
+    enum class wire_type : std::uint8_t {
+        varint = 0,           ///< LEB128 integer
+        fixed64 = 1,          ///< 8 raw bytes
+        length_delimited = 2, ///< varint byte length followed by the value
+        fixed8 = 3,           ///< 1 raw byte
+        fixed16 = 4,          ///< 2 raw bytes
+        fixed32 = 5,          ///< 4 raw bytes
+    };
+
+    namespace detail {
+
+        inline constexpr std::uint64_t end_of_fields = 0;
+
+        [[nodiscard]] constexpr std::uint64_t field_key(std::uint32_t id, wire_type type) noexcept {
+            return static_cast<std::uint64_t>(id) << 3 | static_cast<std::uint64_t>(type);
+        }
+
+        /**
+         * Bytes taken by a fixed wire type, 0 for varint and length-delimited values.
+         */
+        [[nodiscard]] constexpr std::size_t fixed_size(wire_type type) noexcept {
+            switch (type) {
+            case wire_type::fixed8: return 1;
+            case wire_type::fixed16: return 2;
+            case wire_type::fixed32: return 4;
+            case wire_type::fixed64: return 8;
+            default: return 0;
+            }
+        }
+
+        /**
+         * The fixed wire type taking size bytes, length-delimited when there is none.
+         */
+        [[nodiscard]] constexpr wire_type fixed_type(std::size_t size) noexcept {
+            switch (size) {
+            case 1: return wire_type::fixed8;
+            case 2: return wire_type::fixed16;
+            case 4: return wire_type::fixed32;
+            case 8: return wire_type::fixed64;
+            default: return wire_type::length_delimited;
+            }
+        }
+
+        /**
+         * Wire type of a field; optionals use the type of their value, since an empty optional is simply
+         * not written. Changing a field between T and std::optional<T> therefore stays compatible.
+         */
+        template <typename T, format Format>
+        constexpr wire_type wire_type_of() {
+            if constexpr (optional_like<T>) {
+                return wire_type_of<typename T::value_type, Format>();
+            } else if constexpr (bit_field<T, Format>) {
+                return fixed_type(bit_field_bytes_v<T>);
+            } else if constexpr (varint_integer<T, Format>) {
+                return wire_type::varint;
+            } else if constexpr (raw<T, Format> || byte_swapped<T, Format>) {
+                return fixed_type(sizeof(T));
+            } else {
+                return wire_type::length_delimited;
+            }
+        }
+
+        /**
+         * Field ids of T in wire order: HOPE_FIELD_IDS when given, 1..N otherwise.
+         */
+        template <reflectable T>
+        constexpr auto field_ids() {
+            std::array<std::uint32_t, field_count_v<T>> ids{};
+            if constexpr (has_field_ids<T>) {
+                static_assert(std::size(T::hope_field_ids) == field_count_v<T>,
+                    "hope::serialization: HOPE_FIELD_IDS must list exactly one id per serialized field");
+                for (std::size_t i = 0; i < ids.size(); ++i) {
+                    ids[i] = T::hope_field_ids[i];
+                }
+            } else {
+                for (std::size_t i = 0; i < ids.size(); ++i) {
+                    ids[i] = static_cast<std::uint32_t>(i + 1);
+                }
+            }
+            return ids;
+        }
+
+        template <reflectable T>
+        constexpr bool valid_field_ids() {
+            constexpr auto ids = field_ids<T>();
+            for (std::size_t i = 0; i < ids.size(); ++i) {
+                if (ids[i] == 0) {
+                    return false;
+                }
+                for (std::size_t j = 0; j < i; ++j) {
+                    if (ids[i] == ids[j]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+    }
+
+}
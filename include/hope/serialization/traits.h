@@ -0,0 +1,497 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/bounded.h"
+#include "hope/serialization/detail/byte_swap.h"
+#include "hope/serialization/detail/stream_vbyte.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/reflection.h"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/**
+ * Registers the concrete classes a polymorphic base is written as when held by std::unique_ptr or
+ * std::shared_ptr. A class's position in the list is its wire tag, so new classes go at the end. Every
+ * listed class needs a default constructor, must be serializable itself (HOPE_FIELDS, naming inherited
+ * members too) and declares HOPE_SUBTYPE(). The base itself may be listed when it is concrete. Must be
+ * placed in a public section.
+ *
+ *     struct circle;
+ *     struct square;
+ *     struct shape { HOPE_SUBTYPES(circle, square) virtual ~shape() = default; };
+ *     struct circle : shape { HOPE_SUBTYPE() HOPE_FIELDS(radius) double radius{}; };
+ */
+#define HOPE_SUBTYPES(...)                                                          \
+    using hope_subtypes = ::hope::serialization::type_list<__VA_ARGS__>;            \
+    [[nodiscard]] virtual std::size_t hope_subtype() const noexcept {               \
+        return ::hope::serialization::detail::subtype_index<std::remove_cvref_t<decltype(*this)>, hope_subtypes>(); \
+    }
+
+/**
+ * Reports the position of a class in the HOPE_SUBTYPES list of its base, replacing the type information
+ * RTTI would provide. Must be placed in a public section of every listed class.
+ */
+#define HOPE_SUBTYPE()                                                              \
+    [[nodiscard]] std::size_t hope_subtype() const noexcept override {              \
+        static_assert(::hope::serialization::detail::subtype_index<std::remove_cvref_t<decltype(*this)>, hope_subtypes>() \
+                != hope_subtypes::size,                                             \
+            "hope::serialization: class is not listed in HOPE_SUBTYPES of its base");   \
+        return ::hope::serialization::detail::subtype_index<std::remove_cvref_t<decltype(*this)>, hope_subtypes>(); \
+    }
+
+namespace hope::serialization {
+
+    template <typename... Types>
+    struct type_list final {
+        static constexpr std::size_t size = sizeof...(Types);
+    };
+
+    /**
+     * Specialize to take over encoding of a type entirely. The specialization provides
+     *     template <typename Writer> static void write(Writer&, const T&);
+     *     template <typename Reader> static void read(Reader&, T&);
+     * and wins over every built-in rule. It may also provide
+     *     template <format Format> static std::size_t serialized_size(const T&);
+     * so sizes can be computed without encoding.
+     */
+    template <typename T>
+    struct serializer;
+
+    template <typename T>
+    struct enable_bitwise;
+
+    namespace detail {
+
+        /**
+         * Converts only to bitwise types: an aggregate that can be brace-initialized from these
+         * in every position has no member that needs per-field encoding (pointers, views, ...).
+         */
+        struct bitwise_field final {
+            template <typename T>
+                requires enable_bitwise<T>::value
+            operator T() const;
+        };
+
+        template <typename T, std::size_t... I>
+        constexpr bool brace_constructible_from_bitwise(std::index_sequence<I...>) {
+            return requires { T{ (void(I), bitwise_field{})... }; };
+        }
+
+        template <typename T>
+        constexpr bool default_bitwise() {
+            if constexpr (!std::is_trivially_copyable_v<T> || std::is_pointer_v<T> || std::is_member_pointer_v<T>) {
+                return false;
+            } else if constexpr (has_hope_fields<T>) {
+                // the memcpy would also carry members the field list leaves out
+                return []<std::size_t... I>(std::index_sequence<I...>) {
+                    using fields = fields_tuple_t<T>;
+                    return (enable_bitwise<std::remove_cvref_t<std::tuple_element_t<I, fields>>>::value && ...)
+                        && (sizeof(std::tuple_element_t<I, fields>) + ... + 0) == sizeof(T);
+                }(std::make_index_sequence<field_count_v<T>>{});
+            } else if constexpr (std::is_aggregate_v<T> && std::is_class_v<T> && !std::is_union_v<T>) {
+                return brace_constructible_from_bitwise<T>(std::make_index_sequence<aggregate_arity<T>()>{});
+            } else if constexpr (std::is_class_v<T> || std::is_union_v<T>) {
+                // members are hidden behind constructors and may be left uninitialized (a disengaged
+                // optional's payload); only standard layout classes without padding are copied whole
+                return std::is_standard_layout_v<T> && std::has_unique_object_representations_v<T>;
+            } else {
+                return true;
+            }
+        }
+
+    }
+
+    /**
+     * Decides whether a type is written as its raw object representation with a single memcpy.
+     * Trivially copyable types qualify unless they are (or contain, for reflected aggregates) pointers,
+     * views or other members that need their own encoding. Other classes qualify only when standard
+     * layout and free of padding. Specialize to std::false_type for trivially copyable types that hold
+     * handles the rules above cannot see, or to std::true_type for an opaque class that is safe to copy.
+     */
+    template <typename T>
+    struct enable_bitwise : std::bool_constant<detail::default_bitwise<T>()> {};
+
+    template <typename T, std::size_t N>
+    struct enable_bitwise<T[N]> : enable_bitwise<T> {};
+
+    template <typename T, std::size_t N>
+    struct enable_bitwise<std::array<T, N>> : enable_bitwise<T> {};
+
+    template <typename CharT, typename Traits>
+    struct enable_bitwise<std::basic_string_view<CharT, Traits>> : std::false_type {};
+
+    template <typename T, std::size_t Extent>
+    struct enable_bitwise<std::span<T, Extent>> : std::false_type {};
+
+    /**
+     * A variant's storage holds its index in a library specific place; it is written as tag and value.
+     */
+    template <typename... Types>
+    struct enable_bitwise<std::variant<Types...>> : std::false_type {};
+
+    /**
+     * Written as a flag and, when engaged, the value, so the value follows the format and a disengaged
+     * optional carries no stale payload.
+     */
+    template <typename T>
+    struct enable_bitwise<std::optional<T>> : std::false_type {};
+
+    namespace detail {
+
+        template <typename>
+        inline constexpr bool dependent_false = false;
+
+        template <typename T, template <typename...> class Template>
+        inline constexpr bool is_specialization_v = false;
+
+        template <template <typename...> class Template, typename... Args>
+        inline constexpr bool is_specialization_v<Template<Args...>, Template> = true;
+
+        template <typename T>
+        inline constexpr bool is_span_v = false;
+
+        template <typename T, std::size_t Extent>
+        inline constexpr bool is_span_v<std::span<T, Extent>> = true;
+
+        template <typename T>
+        inline constexpr bool is_std_array_v = false;
+
+        template <typename T, std::size_t N>
+        inline constexpr bool is_std_array_v<std::array<T, N>> = true;
+
+        template <typename T>
+        concept has_serializer = requires { sizeof(serializer<T>); };
+
+        template <typename T>
+        concept bitwise = enable_bitwise<T>::value;
+
+        template <typename T>
+        concept string_like = is_specialization_v<T, std::basic_string>
+            || is_specialization_v<T, std::basic_string_view>;
+
+        template <typename T>
+        concept span_like = is_span_v<T>;
+
+        template <typename T>
+        concept optional_like = is_specialization_v<T, std::optional>;
+
+        template <typename T>
+        concept tuple_like = is_specialization_v<T, std::tuple> || is_specialization_v<T, std::pair>;
+
+        template <typename T>
+        concept variant_like = is_specialization_v<T, std::variant>;
+
+        /**
+         * Position of T in the subtype list, List::size when it is not there.
+         */
+        template <typename T, typename List>
+        constexpr std::size_t subtype_index() noexcept {
+            return []<typename... Types>(type_list<Types...>) {
+                constexpr std::array<bool, sizeof...(Types) + 1> matches{ std::is_same_v<T, Types>..., true };
+                std::size_t index = 0;
+                while (!matches[index]) {
+                    ++index;
+                }
+                return index;
+            }(List{});
+        }
+
+        /**
+         * Owning pointers to a base with HOPE_SUBTYPES; the pointee is written as its concrete class.
+         */
+        template <typename T>
+        concept polymorphic_pointer = (std::is_same_v<T, std::unique_ptr<typename T::element_type>>
+                                          || std::is_same_v<T, std::shared_ptr<typename T::element_type>>)
+            && requires { typename T::element_type::hope_subtypes; };
+
+        /**
+         * Tag written in front of a variant alternative or a polymorphic object, among Choices: one byte for
+         * up to 256 choices, otherwise a 16 bit integer (a varint in varint formats).
+         */
+        template <std::size_t Choices>
+            requires (Choices <= 0x10000)
+        using choice_tag_t = std::conditional_t<(Choices <= 0x100), std::uint8_t, std::uint16_t>;
+
+        template <typename T>
+        concept fixed_array = std::is_bounded_array_v<T> || is_std_array_v<T>;
+
+        template <fixed_array T>
+        constexpr std::size_t fixed_array_size() {
+            if constexpr (std::is_bounded_array_v<T>) {
+                return std::extent_v<T>;
+            } else {
+                return std::tuple_size_v<T>;
+            }
+        }
+
+        template <typename T>
+        concept associative_container = std::ranges::sized_range<const T>
+            && requires { typename T::key_type; }
+            && requires(T& container, typename T::value_type&& value) { container.emplace(std::move(value)); };
+
+        template <typename T>
+        concept sequence_container = std::ranges::sized_range<const T>
+            && !associative_container<T>
+            && requires(T& container) { container.emplace_back(); container.clear(); };
+
+        /**
+         * Allocator-aware containers using std::pmr::polymorphic_allocator (std::pmr::string, vector, map, ...).
+         */
+        template <typename T>
+        concept pmr_container = requires { typename T::allocator_type; typename T::value_type; }
+            && std::is_same_v<typename T::allocator_type, std::pmr::polymorphic_allocator<typename T::value_type>>;
+
+        template <typename T>
+        concept bool_vector = is_specialization_v<T, std::vector>
+            && std::is_same_v<typename T::value_type, bool>;
+
+        /**
+         * Integers that the format writes as LEB128 (zigzag for signed), enums by their underlying type.
+         * Single byte integers and bool stay raw, a varint would never be shorter; bounded integers and
+         * enums with an enum_range are bit fields instead.
+         */
+        template <typename T, format Format>
+        concept varint_integer = Format.integers == integer_encoding::varint
+            && (std::is_integral_v<T> || std::is_enum_v<T>) && !std::is_same_v<T, bool> && sizeof(T) > 1
+            && !ranged<T>;
+
+        /**
+         * True when the format's byte order differs from the host's.
+         */
+        template <format Format>
+        inline constexpr bool swaps_bytes = (Format.order == byte_order::little && std::endian::native == std::endian::big)
+            || (Format.order == byte_order::big && std::endian::native == std::endian::little);
+
+        /**
+         * Fixed width scalars whose bytes the format reverses. They are not raw: arrays of them are swapped a
+         * vector at a time on their way to or from the stream, and records holding them are copied field by field.
+         */
+        template <typename T, format Format>
+        concept byte_swapped = swaps_bytes<Format> && swappable<T> && !varint_integer<T, Format> && !bit_field<T, Format>;
+
+        template <typename T, format Format>
+        constexpr bool raw_encoded();
+
+        /**
+         * Converts only to types the format copies verbatim, see bitwise_field.
+         */
+        template <format Format>
+        struct raw_field final {
+            template <typename T>
+                requires (raw_encoded<T, Format>())
+            operator T() const;
+        };
+
+        template <typename T, format Format, std::size_t... I>
+        constexpr bool brace_constructible_from_raw(std::index_sequence<I...>) {
+            return requires { T{ (void(I), raw_field<Format>{})... }; };
+        }
+
+        /**
+         * Whether the format writes T as its object representation. Bitwise types qualify unless the
+         * format re-encodes something inside them (varint integers, bit fields, swapped scalars, tagged
+         * fields); opaque bitwise types always do, in host byte order. Multi-byte scalars the library cannot
+         * swap (__int128) are refused by formats that swap, and those without a portable representation
+         * (long double) by every format with an explicit byte order.
+         */
+        template <typename T, format Format>
+        constexpr bool raw_encoded() {
+            if constexpr (!enable_bitwise<T>::value || bit_field<T, Format> || byte_swapped<T, Format>) {
+                return false;
+            } else if constexpr (!std::is_class_v<T> && !std::is_union_v<T> && !std::is_array_v<T> && sizeof(T) > 1 && !swappable<T>
+                && Format.order != byte_order::native) {
+                return !swaps_bytes<Format> && !std::is_floating_point_v<T>;
+            } else if constexpr (Format.layout == struct_layout::tagged && reflectable<T> && !fixed_array<T>) {
+                return false; // every field carries its own tag
+            } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+                return !varint_integer<T, Format>;
+            } else if constexpr (fixed_array<T>) {
+                return raw_encoded<std::remove_cv_t<std::ranges::range_value_t<T>>, Format>();
+            } else if constexpr (has_hope_fields<T>) {
+                return []<std::size_t... I>(std::index_sequence<I...>) {
+                    return (raw_encoded<std::remove_cvref_t<std::tuple_element_t<I, fields_tuple_t<T>>>, Format>() && ...);
+                }(std::make_index_sequence<field_count_v<T>>{});
+            } else if constexpr (std::is_aggregate_v<T> && std::is_class_v<T> && !std::is_union_v<T>) {
+                return brace_constructible_from_raw<T, Format>(std::make_index_sequence<aggregate_arity<T>()>{});
+            } else {
+                return true;
+            }
+        }
+
+        template <typename T, format Format>
+        concept raw = raw_encoded<T, Format>();
+
+        /**
+         * Contiguous containers of raw elements are copied as one block.
+         */
+        template <typename T, format Format>
+        concept raw_contiguous = std::ranges::contiguous_range<const T>
+            && !bool_vector<T>
+            && raw<std::ranges::range_value_t<const T>, Format>;
+
+        /**
+         * Sequences the format writes column by column: the first field of every element, then the second,
+         * and so on. Elements must be reflected records with at least one field (not arrays or tuples),
+         * and the container must be resizable.
+         */
+        template <typename T, format Format>
+        concept columnar = Format.sequences == sequence_layout::columns
+            && Format.layout == struct_layout::frozen
+            && sequence_container<T>
+            && !bool_vector<T>
+            && reflectable<std::ranges::range_value_t<const T>>
+            && !fixed_array<std::ranges::range_value_t<const T>>
+            && !has_serializer<std::ranges::range_value_t<const T>>
+            && field_count_v<std::ranges::range_value_t<const T>> != 0
+            && requires(T& container, std::size_t size) { container.resize(size); };
+
+        /**
+         * Columns are moved through fixed blocks of this many values; a multiple of the Stream VByte block
+         * so block boundaries are the same as for a plain vector of the field type.
+         */
+        inline constexpr std::size_t column_block = 4 * stream_vbyte::block_size;
+
+        /**
+         * Column fields staged through a block: integers and small raw values. Anything else is written
+         * and read element by element.
+         */
+        template <typename T, format Format>
+        concept column_scalar = (raw<T, Format> || byte_swapped<T, Format> || varint_integer<T, Format> || bit_field<T, Format>)
+            && sizeof(T) <= 16;
+
+        /**
+         * Consecutive raw fields of a reflected type are packed into one block and handed to the stream
+         * with a single call, letting the compiler merge the member copies into a few wide moves. Swapped
+         * scalars join the block, reversed as they are copied.
+         */
+        inline constexpr std::size_t max_fused_block = 128;
+
+        template <typename Fields, std::size_t I>
+        using field_t = std::remove_cvref_t<std::tuple_element_t<I, Fields>>;
+
+        template <typename Fields, format Format, std::size_t... I>
+        constexpr auto field_layout(std::index_sequence<I...>) {
+            struct layout {
+                std::array<bool, sizeof...(I)> raw;
+                std::array<std::size_t, sizeof...(I)> size;
+            };
+            return layout{ { (raw<field_t<Fields, I>, Format> || byte_swapped<field_t<Fields, I>, Format>)... },
+                { sizeof(field_t<Fields, I>)... } };
+        }
+
+        /**
+         * One past the last field of the fused block starting at First; First + 1 when nothing can be fused.
+         */
+        template <typename Fields, format Format>
+        constexpr std::size_t fused_run_end(std::size_t first) {
+            constexpr auto layout = field_layout<Fields, Format>(std::make_index_sequence<std::tuple_size_v<Fields>>{});
+            std::size_t end = first;
+            std::size_t bytes = 0;
+            while (end < layout.raw.size() && layout.raw[end] && bytes + layout.size[end] <= max_fused_block) {
+                bytes += layout.size[end];
+                ++end;
+            }
+            return end > first + 1 ? end : first + 1;
+        }
+
+        template <typename Fields, std::size_t First, std::size_t Last>
+        constexpr std::size_t fused_run_bytes() {
+            return []<std::size_t... I>(std::index_sequence<I...>) {
+                return (sizeof(field_t<Fields, First + I>) + ... + 0);
+            }(std::make_index_sequence<Last - First>{});
+        }
+
+        /**
+         * Fixed arrays of bit fields, packed back to back.
+         */
+        template <typename T, format Format>
+        concept bit_field_array = fixed_array<T> && bit_field<std::remove_cv_t<std::ranges::range_value_t<T>>, Format>;
+
+        template <typename T, format Format>
+        constexpr unsigned packed_width() {
+            if constexpr (bit_field<T, Format>) {
+                return bit_width_v<T>;
+            } else {
+                return 0;
+            }
+        }
+
+        /**
+         * Consecutive bit fields of a reflected type share bytes: the run is written as one little block,
+         * least significant bit first, padded to a whole byte at its end.
+         */
+        template <typename Fields, format Format>
+        constexpr std::size_t packed_run_end(std::size_t first) {
+            constexpr auto packed = []<std::size_t... I>(std::index_sequence<I...>) {
+                return std::array<bool, sizeof...(I)>{ bit_field<field_t<Fields, I>, Format>... };
+            }(std::make_index_sequence<std::tuple_size_v<Fields>>{});
+            std::size_t end = first;
+            while (end < packed.size() && packed[end]) {
+                ++end;
+            }
+            return end;
+        }
+
+        template <typename Fields, format Format>
+        constexpr bool packed_run_start(std::size_t index) {
+            return index == 0 || packed_run_end<Fields, Format>(index - 1) == index - 1;
+        }
+
+        template <typename Fields, format Format, std::size_t First, std::size_t Last>
+        constexpr std::size_t packed_run_bits() {
+            return []<std::size_t... I>(std::index_sequence<I...>) {
+                return (std::size_t{ packed_width<field_t<Fields, First + I>, Format>() } + ... + 0);
+            }(std::make_index_sequence<Last - First>{});
+        }
+
+        template <typename Fields, format Format, std::size_t First, std::size_t Last>
+        constexpr std::size_t packed_run_bytes() {
+            return (packed_run_bits<Fields, Format, First, Last>() + 7) / 8;
+        }
+
+        /**
+         * True when every encoding of T takes at least one byte; lets the reader bound element counts by
+         * the bytes still available before allocating. User serializers are not trusted to guarantee it.
+         */
+        template <typename T>
+        constexpr bool nonempty_encoding() {
+            if constexpr (has_serializer<T>) {
+                return false;
+            } else if constexpr (bitwise<T>) {
+                return sizeof(T) != 0;
+            } else if constexpr (tuple_like<T>) {
+                return []<std::size_t... I>(std::index_sequence<I...>) {
+                    return (nonempty_encoding<std::remove_cvref_t<std::tuple_element_t<I, T>>>() || ...);
+                }(std::make_index_sequence<std::tuple_size_v<T>>{});
+            } else if constexpr (fixed_array<T>) {
+                return fixed_array_size<T>() != 0 && nonempty_encoding<std::ranges::range_value_t<T>>();
+            } else if constexpr (reflectable<T> && !std::ranges::range<T>) {
+                return []<std::size_t... I>(std::index_sequence<I...>) {
+                    return (nonempty_encoding<std::remove_cvref_t<std::tuple_element_t<I, fields_tuple_t<T>>>>() || ...);
+                }(std::make_index_sequence<field_count_v<T>>{});
+            } else {
+                return true;
+            }
+        }
+
+    }
+
+}
@@ -0,0 +1,198 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/simd.h"
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace hope::serialization {
+
+    /**
+     * Longest LEB128 encoding of an unsigned integer of type T.
+     */
+    template <std::unsigned_integral T>
+    inline constexpr std::size_t max_varint_size_v = (sizeof(T) * 8 + 6) / 7;
+
+    inline constexpr std::size_t max_varint_size = max_varint_size_v<std::uint64_t>;
+
+    template <std::signed_integral T>
+    [[nodiscard]] constexpr std::make_unsigned_t<T> zigzag_encode(T value) noexcept {
+        using unsigned_type = std::make_unsigned_t<T>;
+        return static_cast<unsigned_type>(static_cast<unsigned_type>(value) << 1)
+            ^ static_cast<unsigned_type>(value >> (sizeof(T) * 8 - 1));
+    }
+
+    template <std::unsigned_integral T>
+    [[nodiscard]] constexpr std::make_signed_t<T> zigzag_decode(T value) noexcept {
+        return static_cast<std::make_signed_t<T>>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    [[nodiscard]] constexpr std::size_t varint_size(std::uint64_t value) noexcept {
+        return static_cast<std::size_t>(std::bit_width(value | 1) + 6) / 7;
+    }
+
+    namespace detail {
+
+        template <typename T>
+        struct varint_unsigned {
+            using type = std::make_unsigned_t<T>;
+        };
+
+        template <typename T>
+            requires std::is_enum_v<T>
+        struct varint_unsigned<T> : varint_unsigned<std::underlying_type_t<T>> {};
+
+        /**
+         * Unsigned type carrying the LEB128 payload of an integer or enum type.
+         */
+        template <typename T>
+        using varint_unsigned_t = typename varint_unsigned<T>::type;
+
+        template <typename T>
+        [[nodiscard]] constexpr varint_unsigned_t<T> to_varint(T value) noexcept {
+            if constexpr (std::is_enum_v<T>) {
+                return to_varint(static_cast<std::underlying_type_t<T>>(value));
+            } else if constexpr (std::is_signed_v<T>) {
+                return zigzag_encode(value);
+            } else {
+                return value;
+            }
+        }
+
+        template <typename T>
+        [[nodiscard]] constexpr T from_varint(varint_unsigned_t<T> value) noexcept {
+            if constexpr (std::is_enum_v<T>) {
+                return static_cast<T>(from_varint<std::underlying_type_t<T>>(value));
+            } else if constexpr (std::is_signed_v<T>) {
+                return zigzag_decode(value);
+            } else {
+                return value;
+            }
+        }
+
+    }
+
+    /**
+     * Writes value as unsigned LEB128, out must have room for max_varint_size bytes. Returns the bytes written.
+     */
+    inline std::size_t encode_varint(std::uint64_t value, std::uint8_t* out) noexcept {
+        std::uint8_t* cursor = out;
+        while (value >= 0x80) {
+            *cursor++ = static_cast<std::uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *cursor++ = static_cast<std::uint8_t>(value);
+        return static_cast<std::size_t>(cursor - out);
+    }
+
+    /**
+     * Reads an unsigned LEB128 value of type T from [in, end). Returns the bytes consumed, or 0 when the
+     * input ends inside the value, the encoding is longer than T allows or the value does not fit into T.
+     */
+    template <std::unsigned_integral T>
+    [[nodiscard]] std::size_t decode_varint(const std::uint8_t* in, const std::uint8_t* end, T& value) noexcept {
+        constexpr std::size_t max_size = max_varint_size_v<T>;
+        constexpr unsigned last_bits = sizeof(T) * 8 - 7 * (max_size - 1);
+        if (in != end && *in < 0x80) [[likely]] {
+            value = *in;
+            return 1;
+        }
+        const auto available = static_cast<std::size_t>(end - in);
+        const std::size_t limit = available < max_size ? available : max_size;
+        std::uint64_t result = 0;
+        for (std::size_t i = 0; i < limit; ++i) {
+            const std::uint8_t byte = in[i];
+            if (i == max_size - 1 && byte >= (1u << last_bits)) {
+                return 0;
+            }
+            result |= static_cast<std::uint64_t>(byte & 0x7f) << (7 * i);
+            if (byte < 0x80) {
+                value = static_cast<T>(result);
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Decodes count consecutive varints of type T (zigzag for signed, enums by their underlying type).
+     * Returns the bytes consumed, 0 on truncated or malformed input. Eight single-byte values in a row,
+     * by far the common case for ids and counters, are recognized with one mask test and widened together.
+     */
+    template <typename T>
+    [[nodiscard]] std::size_t decode_varints(const std::uint8_t* in, const std::uint8_t* end, T* out, std::size_t count) noexcept {
+        const std::uint8_t* cursor = in;
+        std::size_t index = 0;
+        while (index < count) {
+            if (count - index >= 8 && end - cursor >= 8) {
+                std::uint64_t word;
+                std::memcpy(&word, cursor, sizeof(word));
+                if ((word & 0x8080808080808080ull) == 0) {
+                    for (std::size_t i = 0; i < 8; ++i) {
+                        out[index + i] = detail::from_varint<T>(cursor[i]);
+                    }
+                    cursor += 8;
+                    index += 8;
+                    continue;
+                }
+            }
+            detail::varint_unsigned_t<T> value;
+            const std::size_t size = decode_varint(cursor, end, value);
+            if (size == 0) {
+                return 0;
+            }
+            out[index++] = detail::from_varint<T>(value);
+            cursor += size;
+        }
+        return static_cast<std::size_t>(cursor - in);
+    }
+
+    /**
+     * Steps over count consecutive varints of type T without decoding them. Returns the bytes they take, 0 on
+     * truncated or malformed input, exactly where decode_varints fails. Single-byte values are recognized
+     * sixteen (SSE2) or eight at a time from the continuation bits; only longer values are looked at one by one.
+     */
+    template <typename T>
+    [[nodiscard]] std::size_t skip_varints(const std::uint8_t* in, const std::uint8_t* end, std::size_t count) noexcept {
+        const std::uint8_t* cursor = in;
+        while (count != 0) {
+            std::size_t single = 0;
+#if defined(HOPE_SERIALIZATION_SSE2)
+            if (end - cursor >= 16) {
+                const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor))));
+                single = mask == 0 ? 16 : static_cast<std::size_t>(std::countr_zero(mask));
+            } else
+#endif
+            if (end - cursor >= 8) {
+                std::uint64_t word;
+                std::memcpy(&word, cursor, sizeof(word));
+                const std::uint64_t mask = word & 0x8080808080808080ull;
+                const int first = std::endian::native == std::endian::little ? std::countr_zero(mask) : std::countl_zero(mask);
+                single = static_cast<std::size_t>(first) / 8;
+            }
+            if (single != 0) {
+                single = single < count ? single : count;
+                cursor += single;
+                count -= single;
+                continue;
+            }
+            detail::varint_unsigned_t<T> value;
+            const std::size_t size = decode_varint(cursor, end, value);
+            if (size == 0) {
+                return 0;
+            }
+            cursor += size;
+            --count;
+        }
+        return static_cast<std::size_t>(cursor - in);
+    }
+
+}
@@ -0,0 +1,145 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/error.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/traits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace hope::serialization {
+
+    /**
+     * Read-only view over an encoded array of trivially copyable T that makes no alignment assumptions:
+     * elements are loaded with memcpy on access. Shares the wire layout of std::vector<T>/std::span<const T>,
+     * so a message can be written with owning containers and read with views.
+     */
+    template <typename T>
+    class array_view final {
+        static_assert(std::is_trivially_copyable_v<T>, "hope::serialization: array_view needs trivially copyable elements");
+
+    public:
+        class iterator final {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using reference = T;
+
+            iterator() = default;
+
+            explicit iterator(const std::uint8_t* position) noexcept
+                : position_(position) {}
+
+            T operator*() const noexcept { return load(position_); }
+            T operator[](difference_type offset) const noexcept { return load(position_ + offset * difference_type{ sizeof(T) }); }
+
+            iterator& operator++() noexcept { position_ += sizeof(T); return *this; }
+            iterator operator++(int) noexcept { auto copy = *this; ++*this; return copy; }
+            iterator& operator--() noexcept { position_ -= sizeof(T); return *this; }
+            iterator operator--(int) noexcept { auto copy = *this; --*this; return copy; }
+            iterator& operator+=(difference_type offset) noexcept { position_ += offset * difference_type{ sizeof(T) }; return *this; }
+            iterator& operator-=(difference_type offset) noexcept { position_ -= offset * difference_type{ sizeof(T) }; return *this; }
+
+            friend iterator operator+(iterator it, difference_type offset) noexcept { return it += offset; }
+            friend iterator operator+(difference_type offset, iterator it) noexcept { return it += offset; }
+            friend iterator operator-(iterator it, difference_type offset) noexcept { return it -= offset; }
+            friend difference_type operator-(iterator lhs, iterator rhs) noexcept {
+                return (lhs.position_ - rhs.position_) / difference_type{ sizeof(T) };
+            }
+            friend auto operator<=>(iterator lhs, iterator rhs) noexcept = default;
+
+        private:
+            const std::uint8_t* position_{ nullptr };
+        };
+
+        array_view() = default;
+
+        array_view(const void* data, std::size_t size) noexcept
+            : data_(static_cast<const std::uint8_t*>(data))
+            , size_(size) {}
+
+        array_view(std::span<const T> values) noexcept
+            : array_view(values.data(), values.size()) {}
+
+        [[nodiscard]] std::size_t size() const noexcept { return size_; }
+        [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+        [[nodiscard]] std::span<const std::uint8_t> bytes() const noexcept { return { data_, size_ * sizeof(T) }; }
+
+        [[nodiscard]] T operator[](std::size_t index) const noexcept { return load(data_ + index * sizeof(T)); }
+        [[nodiscard]] T front() const noexcept { return (*this)[0]; }
+        [[nodiscard]] T back() const noexcept { return (*this)[size_ - 1]; }
+
+        [[nodiscard]] iterator begin() const noexcept { return iterator(data_); }
+        [[nodiscard]] iterator end() const noexcept { return iterator(data_ + size_ * sizeof(T)); }
+
+        /**
+         * The elements as a span, only when the underlying bytes happen to be aligned for T.
+         */
+        [[nodiscard]] std::span<const T> aligned_span() const {
+            if (reinterpret_cast<std::uintptr_t>(data_) % alignof(T) != 0) {
+                throw error("hope::serialization: array_view is not aligned for its element type");
+            }
+            return { reinterpret_cast<const T*>(data_), size_ };
+        }
+
+        void copy_to(T* out) const noexcept {
+            if (size_ != 0) {
+                std::memcpy(out, data_, size_ * sizeof(T));
+            }
+        }
+
+        [[nodiscard]] std::vector<T> to_vector() const {
+            std::vector<T> values(size_);
+            copy_to(values.data());
+            return values;
+        }
+
+    private:
+        static T load(const std::uint8_t* position) noexcept {
+            T value;
+            std::memcpy(&value, position, sizeof(T));
+            return value;
+        }
+
+        const std::uint8_t* data_{ nullptr };
+        std::size_t size_{ 0 };
+    };
+
+    template <typename T>
+    struct serializer<array_view<T>> {
+        template <typename Writer>
+        static void write(Writer& writer, const array_view<T>& view) {
+            static_assert(detail::raw<T, Writer::wire_format>,
+                "hope::serialization: array_view elements must be stored verbatim by the format");
+            writer.write_size(view.size());
+            writer.write_bytes(view.bytes().data(), view.bytes().size());
+        }
+
+        template <format Format>
+        static std::size_t serialized_size(const array_view<T>& view) {
+            return detail::size_prefix_size<Format>(view.size()) + view.bytes().size();
+        }
+
+        template <typename Reader>
+        static void read(Reader& reader, array_view<T>& view) {
+            static_assert(detail::raw<T, Reader::wire_format>,
+                "hope::serialization: array_view elements must be stored verbatim by the format");
+            static_assert(contiguous_input_stream<typename Reader::stream_type>,
+                "hope::serialization: views need an input stream that exposes its memory (peek/consume)");
+            const auto size = reader.template read_size<T>();
+            view = array_view<T>(reader.stream().consume(size * sizeof(T)), size);
+        }
+    };
+
+}
@@ -0,0 +1,387 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/detail/bit_fields.h"
+#include "hope/serialization/detail/bit_pack.h"
+#include "hope/serialization/detail/byte_swap.h"
+#include "hope/serialization/detail/stream_vbyte.h"
+#include "hope/serialization/error.h"
+#include "hope/serialization/format.h"
+#include "hope/serialization/size.h"
+#include "hope/serialization/stream.h"
+#include "hope/serialization/tagged.h"
+#include "hope/serialization/traits.h"
+#include "hope/serialization/varint.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace hope::serialization {
+
+    /**
+     * Encodes values into an output stream. Everything is resolved at compile time: a raw value is one
+     * stream write, containers are a size prefix followed by their elements (one write for contiguous
+     * raw elements), aggregates are their fields in declaration order. Values are written in host byte
+     * order unless Format fixes one; Format also selects fixed width or varint integers and length
+     * prefixes, and whether fields are tagged for schema evolution.
+     */
+    template <output_stream Stream, format Format = format{}>
+    class writer final {
+    public:
+        using stream_type = Stream;
+        static constexpr format wire_format = Format;
+
+        explicit writer(Stream& stream) noexcept
+            : stream_(stream) {}
+
+        template <typename T>
+        void write(const T& value) {
+            if constexpr (detail::has_serializer<T>) {
+                serializer<T>::write(*this, value);
+            } else if constexpr (detail::bit_field<T, Format>) {
+                write_packed<0, 1>(std::tie(value));
+            } else if constexpr (detail::varint_integer<T, Format>) {
+                write_varint(detail::to_varint(value));
+            } else if constexpr (detail::raw<T, Format>) {
+                stream_.write(&value, sizeof(T));
+            } else if constexpr (detail::byte_swapped<T, Format>) {
+                const T swapped = detail::byte_swap(value);
+                stream_.write(&swapped, sizeof(T));
+            } else if constexpr (detail::string_like<T> || detail::span_like<T>) {
+                write_size(value.size());
+                write_elements(value);
+            } else if constexpr (detail::optional_like<T>) {
+                write(value.has_value());
+                if (value) {
+                    write(*value);
+                }
+            } else if constexpr (detail::variant_like<T>) {
+                write_variant(value);
+            } else if constexpr (detail::polymorphic_pointer<T>) {
+                write_polymorphic(value);
+            } else if constexpr (detail::tuple_like<T>) {
+                std::apply([this](const auto&... elements) { (write(elements), ...); }, value);
+            } else if constexpr (detail::fixed_array<T>) {
+                write_elements(value);
+            } else if constexpr (detail::columnar<T, Format>) {
+                write_size(std::ranges::size(value));
+                write_columns(value);
+            } else if constexpr (detail::sequence_container<T> || detail::associative_container<T>) {
+                write_size(std::ranges::size(value));
+                write_elements(value);
+            } else if constexpr (detail::reflectable<T> && Format.layout == struct_layout::tagged) {
+                write_tagged<T>(detail::tie_fields(value));
+            } else if constexpr (detail::reflectable<T>) {
+                write_fields<0>(detail::tie_fields(value));
+            } else {
+                static_assert(detail::dependent_false<T>,
+                    "hope::serialization: type is not serializable, specialize hope::serialization::serializer");
+            }
+        }
+
+        void write_size(std::size_t size) {
+            if constexpr (Format.integers == integer_encoding::varint) {
+                write_varint(size);
+            } else {
+                write(static_cast<std::uint64_t>(size));
+            }
+        }
+
+        void write_varint(std::uint64_t value) {
+            if constexpr (contiguous_output_stream<Stream>) {
+                stream_.commit(encode_varint(value, stream_.prepare(max_varint_size)));
+            } else {
+                std::array<std::uint8_t, max_varint_size> bytes;
+                stream_.write(bytes.data(), encode_varint(value, bytes.data()));
+            }
+        }
+
+        void write_bytes(const void* data, std::size_t size) {
+            if (size != 0) {
+                stream_.write(data, size);
+            }
+        }
+
+        [[nodiscard]] Stream& stream() noexcept { return stream_; }
+
+    private:
+        /**
+         * The alternative's index as a compact tag, then the alternative.
+         */
+        template <typename T>
+        void write_variant(const T& value) {
+            if (value.valueless_by_exception()) [[unlikely]] {
+                throw error("hope::serialization: variant is valueless");
+            }
+            write(static_cast<detail::choice_tag_t<std::variant_size_v<T>>>(value.index()));
+            std::visit([this](const auto& alternative) { write(alternative); }, value);
+        }
+
+        /**
+         * Tag 0 for a null pointer, otherwise the position of the object's class in HOPE_SUBTYPES plus one,
+         * then the object as that class. The class is found through hope_subtype(), no RTTI involved.
+         */
+        template <typename Pointer>
+        void write_polymorphic(const Pointer& pointer) {
+            using base_type = typename Pointer::element_type;
+            using subtypes = typename base_type::hope_subtypes;
+            using tag_type = detail::choice_tag_t<subtypes::size + 1>;
+            static constexpr auto writers = []<typename... Types>(type_list<Types...>) {
+                return std::array<void (*)(writer&, const base_type&), sizeof...(Types)>{
+                    [](writer& out, const base_type& object) { out.write(static_cast<const Types&>(object)); }...
+                };
+            }(subtypes{});
+            if (!pointer) {
+                write(tag_type{ 0 });
+                return;
+            }
+            const std::size_t index = pointer->hope_subtype();
+            if (index >= subtypes::size) [[unlikely]] {
+                throw error("hope::serialization: class is not listed in HOPE_SUBTYPES of its base");
+            }
+            write(static_cast<tag_type>(index + 1));
+            writers[index](*this, *pointer);
+        }
+
+        template <typename Range>
+        void write_elements(const Range& range) {
+            using element_type = std::remove_cv_t<std::ranges::range_value_t<const Range>>;
+            if constexpr (detail::bit_field<element_type, Format>) {
+                write_bit_array(range);
+            } else if constexpr (detail::raw_contiguous<Range, Format> && referencing_output_stream<Stream>) {
+                stream_.write_reference(std::ranges::data(range), std::ranges::size(range) * sizeof(element_type));
+            } else if constexpr (detail::raw_contiguous<Range, Format>) {
+                write_bytes(std::ranges::data(range), std::ranges::size(range) * sizeof(element_type));
+            } else if constexpr (detail::byte_swapped<element_type, Format> && std::ranges::contiguous_range<const Range>) {
+                write_swapped(std::ranges::data(range), std::ranges::size(range));
+            } else if constexpr (Format.integers == integer_encoding::varint && std::ranges::contiguous_range<const Range>
+                && detail::stream_vbyte::element<element_type>) {
+                write_stream_vbyte(std::ranges::data(range), std::ranges::size(range));
+            } else {
+                for (const auto& element : range) {
+                    write(element);
+                }
+            }
+        }
+
+        /**
+         * One column after another. Integer and small raw fields are gathered into blocks, and every block is
+         * written like a plain array of the field type, so a column is as compact as a vector of its values.
+         */
+        template <typename Range>
+        void write_columns(const Range& range) {
+            using element_type = std::remove_cv_t<std::ranges::range_value_t<const Range>>;
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                (write_column<I>(range), ...);
+            }(std::make_index_sequence<detail::field_count_v<element_type>>{});
+        }
+
+        template <std::size_t I, typename Range>
+        void write_column(const Range& range) {
+            using element_type = std::remove_cv_t<std::ranges::range_value_t<const Range>>;
+            using field_type = detail::field_t<detail::fields_tuple_t<element_type>, I>;
+            if constexpr (detail::column_scalar<field_type, Format>) {
+                std::array<field_type, detail::column_block> block;
+                std::size_t count = 0;
+                for (const auto& element : range) {
+                    std::memcpy(&block[count], &std::get<I>(detail::tie_fields(element)), sizeof(field_type));
+                    if (++count == block.size()) {
+                        write_values(block.data(), count);
+                        count = 0;
+                    }
+                }
+                write_values(block.data(), count);
+            } else {
+                for (const auto& element : range) {
+                    write(std::get<I>(detail::tie_fields(element)));
+                }
+            }
+        }
+
+        /**
+         * write_elements for values in scratch memory, which must never be handed out by reference.
+         */
+        template <typename T>
+        void write_values(const T* values, std::size_t count) {
+            if constexpr (detail::bit_field<T, Format>) {
+                write_bit_array(std::span<const T>(values, count));
+            } else if constexpr (detail::raw<T, Format>) {
+                write_bytes(values, count * sizeof(T));
+            } else if constexpr (detail::byte_swapped<T, Format>) {
+                write_swapped(values, count);
+            } else if constexpr (Format.integers == integer_encoding::varint && detail::stream_vbyte::element<T>) {
+                write_stream_vbyte(values, count);
+            } else {
+                for (std::size_t i = 0; i < count; ++i) {
+                    write(values[i]);
+                }
+            }
+        }
+
+        /**
+         * Bit fields back to back, staged in blocks of bit_pack::block_size values; the block is a multiple
+         * of eight, so only the last one ends inside a byte.
+         */
+        template <typename Range>
+        void write_bit_array(const Range& range) {
+            using element_type = std::remove_cv_t<std::ranges::range_value_t<const Range>>;
+            namespace bp = detail::bit_pack;
+            constexpr unsigned bits = detail::bit_width_v<element_type>;
+            constexpr bool bools = std::is_same_v<element_type, bool>;
+            using staged_type = std::conditional_t<bools, bool, std::uint64_t>;
+            std::array<std::uint8_t, bp::block_size * bits / 8> bytes;
+            const auto flush = [&](const staged_type* values, std::size_t count) {
+                if constexpr (bools) {
+                    bp::pack_bools(values, count, bytes.data());
+                } else {
+                    bp::pack(values, count, bits, bytes.data());
+                }
+                write_bytes(bytes.data(), bp::packed_size(count, bits));
+            };
+            if constexpr (bools && std::ranges::contiguous_range<const Range>) {
+                const std::size_t size = std::ranges::size(range);
+                for (std::size_t first = 0; first < size; first += bp::block_size) {
+                    flush(std::ranges::data(range) + first, std::min(bp::block_size, size - first));
+                }
+            } else {
+                std::array<staged_type, bp::block_size> values;
+                std::size_t count = 0;
+                for (const auto& element : range) {
+                    if constexpr (bools) {
+                        values[count] = element;
+                    } else {
+                        values[count] = detail::bit_range<element_type>::encode(element);
+                    }
+                    if (++count == values.size()) {
+                        flush(values.data(), count);
+                        count = 0;
+                    }
+                }
+                flush(values.data(), count);
+            }
+        }
+
+        /**
+         * Reversed a vector at a time straight into the stream's buffer, or through a small staging block.
+         */
+        template <typename T>
+        void write_swapped(const T* values, std::size_t count) {
+            constexpr std::size_t block = detail::max_prepare_size / sizeof(T);
+            for (std::size_t first = 0; first < count; first += block) {
+                const std::size_t size = std::min(block, count - first) * sizeof(T);
+                if constexpr (contiguous_output_stream<Stream>) {
+                    std::uint8_t* out = stream_.prepare(size);
+                    detail::byte_swap_copy<sizeof(T)>(values + first, out, size / sizeof(T));
+                    stream_.commit(size);
+                } else {
+                    std::array<std::uint8_t, block * sizeof(T)> bytes;
+                    detail::byte_swap_copy<sizeof(T)>(values + first, bytes.data(), size / sizeof(T));
+                    stream_.write(bytes.data(), size);
+                }
+            }
+        }
+
+        template <typename T>
+        void write_stream_vbyte(const T* values, std::size_t count) {
+            namespace svb = detail::stream_vbyte;
+            for (std::size_t first = 0; first < count; first += svb::block_size) {
+                const std::size_t block = std::min(svb::block_size, count - first);
+                if constexpr (contiguous_output_stream<Stream>) {
+                    stream_.commit(svb::encode_block(values + first, block, stream_.prepare(svb::max_block_bytes)));
+                } else {
+                    std::array<std::uint8_t, svb::max_block_bytes> bytes;
+                    stream_.write(bytes.data(), svb::encode_block(values + first, block, bytes.data()));
+                }
+            }
+        }
+
+        /**
+         * Unrolled at compile time; runs of raw fields become a single stream write, as do runs of bit fields.
+         */
+        template <std::size_t I, typename Fields>
+        void write_fields(const Fields& fields) {
+            if constexpr (I == std::tuple_size_v<Fields>) {
+                return;
+            } else if constexpr (detail::bit_field<detail::field_t<Fields, I>, Format>) {
+                constexpr auto end = detail::packed_run_end<Fields, Format>(I);
+                write_packed<I, end>(fields);
+                write_fields<end>(fields);
+            } else {
+                constexpr auto end = detail::fused_run_end<Fields, Format>(I);
+                if constexpr (end - I > 1) {
+                    std::array<std::uint8_t, detail::fused_run_bytes<Fields, I, end>()> block;
+                    pack_fields<I, end>(fields, block.data());
+                    stream_.write(block.data(), block.size());
+                } else {
+                    write(std::get<I>(fields));
+                }
+                write_fields<end>(fields);
+            }
+        }
+
+        template <typename T, typename Fields>
+        void write_tagged(const Fields& fields) {
+            static_assert(detail::valid_field_ids<T>(), "hope::serialization: field ids must be unique and non-zero");
+            constexpr auto ids = detail::field_ids<T>();
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                (write_tagged_field<ids[I]>(std::get<I>(fields)), ...);
+            }(std::make_index_sequence<ids.size()>{});
+            write_varint(detail::end_of_fields);
+        }
+
+        /**
+         * Empty optionals are left out, the reader resets fields it does not see. Length-delimited values are
+         * preceded by their serialized_size; fixed and varint values need no length.
+         */
+        template <std::uint32_t Id, typename T>
+        void write_tagged_field(const T& value) {
+            if constexpr (detail::optional_like<T>) {
+                if (value) {
+                    write_tagged_field<Id>(*value);
+                }
+            } else {
+                constexpr auto type = detail::wire_type_of<T, Format>();
+                write_varint(detail::field_key(Id, type));
+                if constexpr (type == wire_type::length_delimited) {
+                    write_size(serialized_size<Format>(value));
+                }
+                write(value);
+            }
+        }
+
+        template <std::size_t First, std::size_t End, typename Fields>
+        void write_packed(const Fields& fields) {
+            constexpr std::size_t size = detail::packed_run_bytes<Fields, Format, First, End>();
+            std::array<std::uint8_t, size + detail::bit_pack::padding> block{};
+            detail::pack_bit_fields<First, End>(fields, block.data());
+            stream_.write(block.data(), size);
+        }
+
+        template <std::size_t I, std::size_t End, typename Fields>
+        static void pack_fields(const Fields& fields, std::uint8_t* out) noexcept {
+            if constexpr (I < End) {
+                const auto& field = std::get<I>(fields);
+                if constexpr (detail::byte_swapped<detail::field_t<Fields, I>, Format>) {
+                    const auto swapped = detail::byte_swap(field);
+                    std::memcpy(out, &swapped, sizeof(field));
+                } else {
+                    std::memcpy(out, &field, sizeof(field));
+                }
+                pack_fields<I + 1, End>(fields, out + sizeof(field));
+            }
+        }
+
+        Stream& stream_;
+    };
+
+}
@@ -0,0 +1,135 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/archive.h"
+#include "hope/serialization/view.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct event {
+        std::uint64_t id;
+        std::string text;
+        std::vector<double> values;
+
+        bool operator==(const event&) const = default;
+    };
+
+    struct event_view {
+        std::uint64_t id;
+        std::string_view text;
+        array_view<double> values;
+    };
+
+    event make_event(std::size_t i) {
+        return { i, std::string(i % 50, static_cast<char>('a' + i % 26)), std::vector<double>(i % 7, static_cast<double>(i)) };
+    }
+
+    class archive_test : public ::testing::Test {
+    protected:
+        void TearDown() override { std::filesystem::remove(path); }
+
+        std::string path = (std::filesystem::temp_directory_path()
+            / ("hope_archive_test_" + std::to_string(::getpid()) + "_"
+                + ::testing::UnitTest::GetInstance()->current_test_info()->name()))
+                               .string();
+    };
+
+    TEST_F(archive_test, random_access_to_every_record) {
+        constexpr std::size_t count = 20000; // spans several write chunks
+        {
+            archive_writer writer(path);
+            for (std::size_t i = 0; i < count; ++i) {
+                EXPECT_EQ(writer.append<varint_format>(make_event(i)), i);
+            }
+            EXPECT_EQ(writer.size(), count);
+            writer.finish();
+        }
+        const mapped_archive archive(path);
+        ASSERT_EQ(archive.size(), count);
+        for (const std::size_t i : { std::size_t{ 0 }, std::size_t{ 19999 }, std::size_t{ 7 }, std::size_t{ 12345 } }) {
+            EXPECT_EQ((archive.read<event, varint_format>(i)), make_event(i));
+        }
+        for (std::size_t i = 0; i < count; i += 97) {
+            event value;
+            archive.read<varint_format>(i, value);
+            EXPECT_EQ(value, make_event(i));
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(archive.record(i).data()) % archive_alignment, 0u);
+        }
+        EXPECT_THROW((void)archive.record(count), error);
+    }
+
+    TEST_F(archive_test, views_point_into_the_mapping) {
+        {
+            archive_writer writer(path);
+            (void)writer.append(make_event(33));
+            (void)writer.append_bytes(serialize(make_event(34)));
+        } // the destructor finishes the archive
+        const mapped_archive archive(path);
+        ASSERT_EQ(archive.size(), 2u);
+        const auto record = archive.record(0);
+        const auto view = archive.read<event_view>(0);
+        EXPECT_EQ(view.text, make_event(33).text);
+        EXPECT_GE(reinterpret_cast<const std::uint8_t*>(view.text.data()), record.data());
+        EXPECT_EQ(view.values.to_vector(), make_event(33).values);
+        EXPECT_EQ(archive.read<event>(1), make_event(34));
+    }
+
+    TEST_F(archive_test, empty_archive) {
+        archive_writer(path).finish();
+        const mapped_archive archive(path);
+        EXPECT_TRUE(archive.empty());
+        EXPECT_THROW((void)archive.record(0), error);
+    }
+
+    TEST_F(archive_test, finished_writer_refuses_records) {
+        archive_writer writer(path);
+        writer.finish();
+        EXPECT_THROW((void)writer.append(make_event(1)), error);
+    }
+
+    TEST_F(archive_test, moved_archive_keeps_the_mapping) {
+        {
+            archive_writer writer(path);
+            (void)writer.append(make_event(3));
+        }
+        mapped_archive first(path);
+        const mapped_archive second(std::move(first));
+        EXPECT_EQ(second.read<event>(0), make_event(3));
+    }
+
+    TEST_F(archive_test, damaged_files_are_rejected) {
+        {
+            archive_writer writer(path);
+            (void)writer.append(make_event(3));
+        }
+        const auto size = std::filesystem::file_size(path);
+        {
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(static_cast<std::streamoff>(size - 16)); // record count in the trailer
+            file.put(9);
+        }
+        EXPECT_THROW(mapped_archive{ path }, error);
+        std::filesystem::resize_file(path, 10);
+        EXPECT_THROW(mapped_archive{ path }, error);
+        std::filesystem::remove(path);
+        EXPECT_THROW(mapped_archive{ path }, error);
+    }
+
+}
@@ -0,0 +1,139 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/arena.h"
+#include "hope/serialization/incremental_reader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct leg {
+        std::int32_t quantity;
+        std::pmr::string venue;
+    };
+
+    struct pmr_message {
+        std::uint64_t id;
+        std::pmr::string text;
+        std::pmr::vector<leg> legs;
+        std::pmr::map<std::pmr::string, std::pmr::vector<std::int32_t>> tags;
+        std::optional<std::pmr::string> note;
+    };
+
+    struct message {
+        std::uint64_t id;
+        std::string text;
+        std::vector<std::tuple<std::int32_t, std::string>> legs;
+        std::map<std::string, std::vector<std::int32_t>> tags;
+        std::optional<std::string> note;
+    };
+
+    /**
+     * Counts what reaches the upstream allocator.
+     */
+    class counting_resource final : public std::pmr::memory_resource {
+    public:
+        std::size_t allocations{ 0 };
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++allocations;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    // long enough to leave the small string buffer
+    const message sample{ 9, std::string(40, 't'), { { 5, std::string(30, 'v') }, { -1, "" } },
+        { { std::string(20, 'k'), { 1, 2, 3 } } }, std::string(50, 'n') };
+
+    void expect_in(const pmr_message& value, std::pmr::memory_resource* resource) {
+        EXPECT_EQ(value.text.get_allocator().resource(), resource);
+        EXPECT_EQ(value.legs.get_allocator().resource(), resource);
+        for (const auto& item : value.legs) {
+            EXPECT_EQ(item.venue.get_allocator().resource(), resource);
+        }
+        EXPECT_EQ(value.tags.get_allocator().resource(), resource);
+        for (const auto& [key, values] : value.tags) {
+            EXPECT_EQ(key.get_allocator().resource(), resource);
+            EXPECT_EQ(values.get_allocator().resource(), resource);
+        }
+        ASSERT_TRUE(value.note.has_value());
+        EXPECT_EQ(value.note->get_allocator().resource(), resource);
+    }
+
+    TEST(arena, every_container_allocates_from_the_resource) {
+        const auto bytes = serialize(sample);
+        arena memory;
+        const auto value = deserialize<pmr_message>(bytes, &memory);
+        expect_in(value, &memory);
+        EXPECT_EQ(std::string_view(value.text), sample.text);
+        EXPECT_EQ(std::string_view(value.legs[0].venue), std::get<1>(sample.legs[0]));
+        EXPECT_EQ(value.tags.begin()->second, (std::pmr::vector<std::int32_t>{ 1, 2, 3 }));
+        EXPECT_EQ(std::string_view(*value.note), *sample.note);
+    }
+
+    TEST(arena, warm_arena_stays_off_the_upstream_allocator) {
+        const auto bytes = serialize(sample);
+        counting_resource upstream;
+        arena memory(64, &upstream);
+        for (int round = 0; round < 3; ++round) {
+            (void)deserialize<pmr_message>(bytes, &memory);
+            memory.reset();
+        }
+        const std::size_t warm = upstream.allocations;
+        for (int round = 0; round < 10; ++round) {
+            (void)deserialize<pmr_message>(bytes, &memory);
+            memory.reset();
+        }
+        EXPECT_EQ(upstream.allocations, warm);
+        EXPECT_GT(memory.capacity(), 0u);
+        memory.release();
+        EXPECT_EQ(memory.capacity(), 0u);
+    }
+
+    TEST(arena, incremental_reader_uses_the_resource) {
+        const auto bytes = serialize(sample);
+        arena memory;
+        pmr_message value;
+        incremental_reader<pmr_message> decoder(value, &memory);
+        for (std::size_t i = 0; i < bytes.size(); i += 3) {
+            (void)decoder.feed(std::span(bytes).subspan(i, std::min<std::size_t>(3, bytes.size() - i)));
+        }
+        ASSERT_TRUE(decoder.done());
+        expect_in(value, &memory);
+        EXPECT_EQ(std::string_view(value.legs[0].venue), std::get<1>(sample.legs[0]));
+    }
+
+    TEST(arena, pmr_and_std_containers_share_the_encoding) {
+        arena memory;
+        const auto value = deserialize<pmr_message>(serialize(sample), &memory);
+        EXPECT_EQ(serialize(value), serialize(sample));
+        const auto plain = deserialize<pmr_message>(serialize(sample));
+        EXPECT_EQ(plain.text.get_allocator().resource(), std::pmr::get_default_resource());
+    }
+
+}
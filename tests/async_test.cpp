@@ -0,0 +1,158 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/async.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct request {
+        std::uint32_t id;
+        std::string text;
+
+        bool operator==(const request&) const = default;
+    };
+
+    struct reply {
+        std::uint32_t id;
+        std::uint64_t length;
+
+        bool operator==(const reply&) const = default;
+    };
+
+    /**
+     * Connected socket pair, closed on destruction.
+     */
+    struct socket_pair {
+        socket_pair() {
+            if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                throw std::runtime_error("socketpair failed");
+            }
+        }
+
+        ~socket_pair() {
+            for (const int fd : fds) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+        }
+
+        void close(int index) {
+            ::close(fds[index]);
+            fds[index] = -1;
+        }
+
+        int fds[2];
+    };
+
+    task serve(event_loop& loop, int fd) {
+        async_stream<varint_format> connection(loop, fd);
+        for (request message;;) {
+            co_await connection.read(message);
+            if (connection.closed()) {
+                co_return;
+            }
+            co_await connection.write(reply{ message.id, message.text.size() });
+        }
+    }
+
+    task call(event_loop& loop, int fd, std::vector<request> requests, std::vector<reply>& replies) {
+        async_stream<varint_format> connection(loop, fd, nullptr, 7); // tiny reads split every message
+        for (const auto& message : requests) {
+            connection.queue(message);
+        }
+        co_await connection.flush();
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            reply message{};
+            co_await connection.read(message);
+            replies.push_back(message);
+        }
+        // a message larger than the socket buffer suspends the writer until the server drains it
+        const request large{ 99, std::string(4 << 20, 'x') };
+        co_await connection.write(large);
+        reply message{};
+        co_await connection.read(message);
+        replies.push_back(message);
+        ::shutdown(fd, SHUT_WR);
+    }
+
+    TEST(async, requests_and_replies_over_a_socket) {
+        socket_pair sockets;
+        event_loop loop;
+        std::vector<reply> replies;
+        loop.spawn(serve(loop, sockets.fds[0]));
+        loop.spawn(call(loop, sockets.fds[1], { { 1, "one" }, { 2, "" }, { 3, std::string(1000, 'y') } }, replies));
+        loop.run();
+        EXPECT_EQ(replies, (std::vector<reply>{ { 1, 3 }, { 2, 0 }, { 3, 1000 }, { 99, 4 << 20 } }));
+    }
+
+    task read_one(event_loop& loop, int fd, request& value, bool& closed) {
+        async_stream<varint_format> connection(loop, fd);
+        co_await connection.read(value);
+        closed = connection.closed();
+    }
+
+    TEST(async, close_at_a_message_boundary) {
+        socket_pair sockets;
+        sockets.close(1);
+        event_loop loop;
+        request value{ 5, "untouched" };
+        bool closed = false;
+        loop.spawn(read_one(loop, sockets.fds[0], value, closed));
+        loop.run();
+        EXPECT_TRUE(closed);
+        EXPECT_EQ(value, (request{ 5, "untouched" }));
+    }
+
+    TEST(async, close_in_the_middle_of_a_message_throws) {
+        socket_pair sockets;
+        const auto bytes = serialize<varint_format>(request{ 1, "truncated" });
+        ASSERT_EQ(::write(sockets.fds[1], bytes.data(), bytes.size() - 2), static_cast<::ssize_t>(bytes.size() - 2));
+        sockets.close(1);
+        event_loop loop;
+        request value{};
+        bool closed = false;
+        loop.spawn(read_one(loop, sockets.fds[0], value, closed));
+        EXPECT_THROW(loop.run(), error);
+        EXPECT_FALSE(closed);
+    }
+
+    TEST(async, stop_from_another_thread) {
+        socket_pair sockets;
+        event_loop loop;
+        request value{};
+        bool closed = false;
+        loop.spawn(read_one(loop, sockets.fds[0], value, closed)); // never gets any input
+        std::atomic<bool> returned{ false };
+        std::thread stopper([&] {
+            // a stop() that lands before run() starts is not remembered
+            while (!returned.load()) {
+                loop.stop();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        loop.run();
+        returned.store(true);
+        stopper.join();
+        EXPECT_FALSE(closed);
+    }
+
+}
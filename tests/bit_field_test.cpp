@@ -0,0 +1,119 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/bounded.h"
+#include "hope/serialization/incremental_reader.h"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+    enum class side : std::uint8_t { buy, sell };
+
+    enum class level : std::int8_t { low = -2, mid = 0, high = 3 };
+
+}
+
+template <>
+struct hope::serialization::enum_range<side> {
+    static constexpr side min = side::buy;
+    static constexpr side max = side::sell;
+};
+
+template <>
+struct hope::serialization::enum_range<level> {
+    static constexpr level min = level::low;
+    static constexpr level max = level::high;
+};
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::round_trip;
+
+    struct order {
+        bounded<std::uint32_t, 0, 1000> quantity;
+        side direction;
+        bool urgent;
+
+        bool operator==(const order&) const = default;
+    };
+
+    struct reading {
+        bounded<std::int32_t, -100, 100> celsius;
+        std::string probe;
+        level alarm;
+        bounded<std::uint64_t, 0, std::numeric_limits<std::uint64_t>::max()> counter;
+        std::array<bounded<std::uint8_t, 0, 4>, 5> digits;
+
+        bool operator==(const reading&) const = default;
+    };
+
+    TEST(bit_fields, neighbouring_fields_share_bytes) {
+        const order value{ 999, side::sell, true };
+        EXPECT_EQ(serialize<packed_format>(value).size(), 2u);
+        EXPECT_EQ(serialize(value).size(), 3u); // bools stay bytes without bool_encoding::bit
+        EXPECT_EQ(round_trip<packed_format>(value), value);
+        EXPECT_EQ(round_trip(value), value);
+    }
+
+    TEST(bit_fields, signed_ranges_and_wide_fields) {
+        const reading value{ -100, "t1", level::high, std::numeric_limits<std::uint64_t>::max(), { 0, 1, 2, 3, 4 } };
+        EXPECT_EQ(round_trip(value), value);
+        EXPECT_EQ(round_trip<packed_format>(value), value);
+        EXPECT_EQ(round_trip<tagged_format>(value), value);
+        constexpr format big{ .order = byte_order::big };
+        EXPECT_EQ(round_trip<big>(value), value);
+    }
+
+    TEST(bit_fields, sequences_are_packed_back_to_back) {
+        std::vector<bounded<std::uint16_t, 0, 7>> values;
+        for (std::uint16_t i = 0; i < 1000; ++i) {
+            values.emplace_back(static_cast<std::uint16_t>(i % 8));
+        }
+        const auto bytes = serialize(values);
+        EXPECT_EQ(bytes.size(), 8 + (1000 * 3 + 7) / 8);
+        EXPECT_EQ(round_trip(values), values);
+
+        std::vector<bool> flags;
+        for (int i = 0; i < 333; ++i) {
+            flags.push_back(i % 3 == 1);
+        }
+        EXPECT_EQ(serialize<packed_format>(flags).size(), 2 + (333 + 7) / 8);
+        EXPECT_EQ(round_trip<packed_format>(flags), flags);
+        const std::array<bool, 20> array{ true, false, true, true };
+        EXPECT_EQ(serialize<packed_format>(array).size(), 3u);
+        EXPECT_EQ(round_trip<packed_format>(array), array);
+    }
+
+    TEST(bit_fields, out_of_range_values_throw) {
+        EXPECT_THROW((void)serialize(order{ 1001, side::buy, false }), error);
+        EXPECT_THROW((void)serialize(static_cast<side>(2)), error);
+        EXPECT_THROW((void)serialize(std::vector<bounded<std::uint8_t, 0, 4>>{ 1, 5 }), error);
+        // three bits, all set: offset 7 is past the maximum of 4
+        EXPECT_THROW((void)(deserialize<bounded<std::uint8_t, 0, 4>>(test::bytes_of({ 0x07 }))), error);
+    }
+
+    TEST(bit_fields, incremental_reader_matches) {
+        const reading value{ 42, "probe", level::low, 123456789, { 4, 3, 2, 1, 0 } };
+        const auto bytes = serialize<packed_format>(value);
+        reading decoded{};
+        incremental_reader<reading, packed_format> decoder(decoded);
+        for (const auto byte : bytes) {
+            (void)decoder.feed(std::span(&byte, 1));
+        }
+        ASSERT_TRUE(decoder.done());
+        EXPECT_EQ(decoded, value);
+    }
+
+}
@@ -0,0 +1,106 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/buffer_pool.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct message {
+        std::uint64_t id;
+        std::string text;
+
+        bool operator==(const message&) const = default;
+    };
+
+    class buffer_pool_test : public ::testing::Test {
+    protected:
+        void SetUp() override { buffer_pool::trim(); }
+
+        void TearDown() override {
+            buffer_pool::set_limits({});
+            buffer_pool::trim();
+        }
+    };
+
+    TEST_F(buffer_pool_test, released_buffers_keep_their_capacity) {
+        const std::uint8_t* data = nullptr;
+        {
+            auto buffer = serialize_pooled<varint_format>(message{ 1, std::string(1000, 'x') });
+            EXPECT_EQ((deserialize<message, varint_format>(buffer.view())), (message{ 1, std::string(1000, 'x') }));
+            data = buffer->data();
+        }
+        EXPECT_EQ(buffer_pool::cached(), 1u);
+        auto buffer = buffer_pool::acquire();
+        EXPECT_EQ(buffer_pool::cached(), 0u);
+        EXPECT_EQ(buffer->size(), 0u);
+        EXPECT_GE(buffer->capacity(), 1000u);
+        EXPECT_EQ(buffer->data(), data);
+    }
+
+    TEST_F(buffer_pool_test, limits_bound_what_is_cached) {
+        buffer_pool::set_limits({ .max_buffers = 2, .max_capacity = 4096 });
+        {
+            std::vector<pooled_buffer> buffers;
+            for (int i = 0; i < 4; ++i) {
+                buffers.push_back(serialize_pooled(message{ 2, "small" }));
+            }
+        }
+        EXPECT_EQ(buffer_pool::cached(), 2u);
+        buffer_pool::trim();
+        {
+            auto large = serialize_pooled(message{ 3, std::string(10000, 'y') });
+        }
+        EXPECT_EQ(buffer_pool::cached(), 0u);
+        {
+            auto empty = buffer_pool::acquire(); // never allocated, nothing worth caching
+        }
+        EXPECT_EQ(buffer_pool::cached(), 0u);
+    }
+
+    TEST_F(buffer_pool_test, detached_and_moved_buffers) {
+        auto first = serialize_pooled(message{ 4, "detached" });
+        const output_buffer owned = first.detach();
+        EXPECT_EQ(deserialize<message>(owned.view()), (message{ 4, "detached" }));
+        first = pooled_buffer();
+        EXPECT_EQ(buffer_pool::cached(), 0u);
+
+        auto second = serialize_pooled(message{ 5, "moved" });
+        pooled_buffer third(std::move(second));
+        EXPECT_EQ(deserialize<message>(third.view()), (message{ 5, "moved" }));
+        third = serialize_pooled(message{ 6, "replaced" }); // the old buffer goes back to the pool
+        EXPECT_EQ(buffer_pool::cached(), 1u);
+    }
+
+    TEST_F(buffer_pool_test, every_thread_has_its_own_list) {
+        {
+            auto buffer = serialize_pooled(message{ 7, "main" });
+        }
+        std::size_t other_before = 1;
+        std::size_t other_after = 0;
+        std::thread worker([&] {
+            other_before = buffer_pool::cached();
+            {
+                auto buffer = serialize_pooled(message{ 8, "worker" });
+            }
+            other_after = buffer_pool::cached();
+        });
+        worker.join();
+        EXPECT_EQ(other_before, 0u);
+        EXPECT_EQ(other_after, 1u);
+        EXPECT_EQ(buffer_pool::cached(), 1u);
+    }
+
+}
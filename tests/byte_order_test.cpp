@@ -0,0 +1,77 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::bytes_of;
+    using test::round_trip;
+
+    constexpr format big_format{ .order = byte_order::big };
+    constexpr format little_format{ .order = byte_order::little };
+
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef __int128 int128;
+#endif
+
+    struct sample {
+        std::uint16_t channel;
+        std::uint32_t value;
+        double scale;
+        std::array<std::int64_t, 3> history;
+
+        bool operator==(const sample&) const = default;
+    };
+
+    TEST(byte_order, scalars_follow_the_format) {
+        EXPECT_EQ(serialize<big_format>(std::uint32_t{ 0x01020304 }), bytes_of({ 1, 2, 3, 4 }));
+        EXPECT_EQ(serialize<little_format>(std::uint32_t{ 0x01020304 }), bytes_of({ 4, 3, 2, 1 }));
+        EXPECT_EQ(serialize<big_format>(std::int16_t{ -2 }), bytes_of({ 0xff, 0xfe }));
+    }
+
+    TEST(byte_order, optionals_follow_the_format) {
+        EXPECT_EQ(serialize<big_format>(std::optional<std::uint32_t>(0x01020304)), bytes_of({ 1, 1, 2, 3, 4 }));
+        EXPECT_EQ(serialize<big_format>(std::optional<std::uint32_t>()), bytes_of({ 0 }));
+        EXPECT_EQ(round_trip<big_format>(std::optional<std::uint32_t>(0x01020304)), 0x01020304u);
+    }
+
+    TEST(byte_order, records_and_arrays_round_trip) {
+        const sample value{ 3, 0xdeadbeef, 1.5, { -1, 2, -3 } };
+        EXPECT_EQ(round_trip<big_format>(value), value);
+        EXPECT_EQ(round_trip<little_format>(value), value);
+        std::vector<std::uint32_t> values(100);
+        for (std::uint32_t i = 0; i < values.size(); ++i) {
+            values[i] = i * 0x01010101u;
+        }
+        EXPECT_EQ(round_trip<big_format>(values), values);
+        EXPECT_EQ(serialize<big_format>(std::vector<std::uint32_t>{ 0x01020304, 0x05060708 }),
+            bytes_of({ 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 3, 4, 5, 6, 7, 8 }));
+    }
+
+    TEST(byte_order, unportable_scalars_are_not_copied) {
+        static_assert(!detail::raw<long double, big_format>);
+        static_assert(!detail::raw<long double, little_format>);
+        static_assert(detail::raw<long double, format{}>);
+#ifdef __SIZEOF_INT128__
+        static_assert(detail::raw<int128, format{}>);
+        if constexpr (std::endian::native == std::endian::little) {
+            static_assert(!detail::raw<int128, big_format>);
+            static_assert(detail::raw<int128, little_format>);
+        }
+#endif
+        SUCCEED();
+    }
+
+}
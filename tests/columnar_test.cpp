@@ -0,0 +1,109 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::round_trip;
+
+    struct trade {
+        std::uint64_t timestamp;
+        std::uint32_t instrument;
+        double price;
+        bool buy;
+
+        bool operator==(const trade&) const = default;
+    };
+
+    struct pair32 {
+        std::uint32_t a;
+        std::uint32_t b;
+
+        bool operator==(const pair32&) const = default;
+    };
+
+    struct tick {
+        std::string venue;
+        std::optional<std::int64_t> size;
+        std::vector<std::int16_t> levels;
+
+        bool operator==(const tick&) const = default;
+    };
+
+    struct batch {
+        std::uint32_t id;
+        std::vector<trade> trades;
+        std::deque<tick> ticks;
+
+        bool operator==(const batch&) const = default;
+    };
+
+    std::vector<trade> trades(std::size_t count) {
+        std::vector<trade> values;
+        for (std::size_t i = 0; i < count; ++i) {
+            values.push_back({ 1700000000000 + i * 1000, static_cast<std::uint32_t>(i % 7), 100.0 + static_cast<double>(i) / 8, i % 3 == 0 });
+        }
+        return values;
+    }
+
+    TEST(columnar, fields_are_written_column_by_column) {
+        constexpr format columns{ .sequences = sequence_layout::columns };
+        const auto bytes = serialize<columns>(std::vector<pair32>{ { 1, 2 }, { 3, 4 } });
+        ASSERT_EQ(bytes.size(), 8 + 4 * sizeof(std::uint32_t));
+        std::vector<std::uint32_t> words(4);
+        std::memcpy(words.data(), bytes.data() + 8, 4 * sizeof(std::uint32_t));
+        EXPECT_EQ(words, (std::vector<std::uint32_t>{ 1, 3, 2, 4 }));
+    }
+
+    TEST(columnar, round_trip_across_block_boundaries) {
+        constexpr format packed_columns{ .integers = integer_encoding::varint, .sequences = sequence_layout::columns,
+            .bools = bool_encoding::bit };
+        for (const std::size_t count : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 63 }, std::size_t{ 257 }, std::size_t{ 5000 } }) {
+            const auto values = trades(count);
+            EXPECT_EQ(round_trip<columnar_format>(values), values);
+            EXPECT_EQ(round_trip<packed_columns>(values), values);
+        }
+    }
+
+    TEST(columnar, other_containers_and_nested_fields) {
+        const std::deque<tick> ticks{ { "X", 5, { 1, -2 } }, { "", std::nullopt, {} }, { "long venue name", -9, { 7 } } };
+        EXPECT_EQ(round_trip<columnar_format>(ticks), ticks);
+        const std::list<pair32> list{ { 1, 2 }, { 3, 4 }, { 5, 6 } };
+        EXPECT_EQ(round_trip<columnar_format>(list), list);
+        const batch value{ 9, trades(100), ticks };
+        EXPECT_EQ(round_trip<columnar_format>(value), value);
+    }
+
+    TEST(columnar, explicit_byte_order) {
+        constexpr format big_columns{ .sequences = sequence_layout::columns, .order = byte_order::big };
+        const auto values = trades(300);
+        EXPECT_EQ(round_trip<big_columns>(values), values);
+    }
+
+    TEST(columnar, bool_columns_are_bit_packed) {
+        constexpr format packed_columns{ .integers = integer_encoding::varint, .sequences = sequence_layout::columns,
+            .bools = bool_encoding::bit };
+        const auto values = trades(1000);
+        EXPECT_EQ(serialize<columnar_format>(values).size() - serialize<packed_columns>(values).size(), 1000 - 1000 / 8);
+    }
+
+    TEST(columnar, truncated_input_throws) {
+        auto bytes = serialize<columnar_format>(trades(300));
+        bytes.resize(bytes.size() - 3);
+        EXPECT_THROW((void)(deserialize<std::vector<trade>, columnar_format>(bytes)), error);
+    }
+
+}
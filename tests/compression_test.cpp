@@ -0,0 +1,147 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/compression.h"
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    /**
+     * Run-length codec standing in for LZ4, so envelopes are tested without the libraries: pairs of run
+     * length and byte.
+     */
+    struct run_length_codec {
+        static constexpr compression method = compression::lz4;
+
+        [[nodiscard]] std::size_t bound(std::size_t size) const noexcept { return 2 * size; }
+
+        [[nodiscard]] std::size_t compress(const std::uint8_t* in, std::size_t size, std::uint8_t* out, std::size_t capacity) {
+            std::size_t written = 0;
+            for (std::size_t i = 0; i < size;) {
+                std::size_t run = 1;
+                while (i + run < size && run < 255 && in[i + run] == in[i]) {
+                    ++run;
+                }
+                if (written + 2 > capacity) {
+                    return 0;
+                }
+                out[written++] = static_cast<std::uint8_t>(run);
+                out[written++] = in[i];
+                i += run;
+            }
+            return written;
+        }
+
+        void decompress(const std::uint8_t* in, std::size_t size, std::uint8_t* out, std::size_t original) {
+            std::size_t written = 0;
+            for (std::size_t i = 0; i + 1 < size; i += 2) {
+                if (in[i] > original - written) {
+                    throw error("corrupt run");
+                }
+                std::memset(out + written, in[i + 1], in[i]);
+                written += in[i];
+            }
+            if (size % 2 != 0 || written != original) {
+                throw error("corrupt run");
+            }
+        }
+    };
+
+    static_assert(frame_codec<run_length_codec>);
+
+    std::vector<std::uint8_t> repetitive(std::size_t size, std::uint8_t seed) {
+        std::vector<std::uint8_t> bytes(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            bytes[i] = static_cast<std::uint8_t>(seed + i / 100);
+        }
+        return bytes;
+    }
+
+    std::vector<std::uint8_t> copy(std::span<const std::uint8_t> bytes) { return { bytes.begin(), bytes.end() }; }
+
+    TEST(compression, large_frames_are_compressed) {
+        frame_compressor<run_length_codec> compressor;
+        const auto frame = repetitive(4000, 1);
+        output_buffer out;
+        compressor.write(out, frame);
+        EXPECT_LT(out.size(), frame.size());
+        EXPECT_EQ(frame_size(out.view()), out.size());
+        EXPECT_EQ(copy(compressor.decompress(out.view())), frame);
+    }
+
+    TEST(compression, small_and_incompressible_frames_are_stored) {
+        frame_compressor<run_length_codec> compressor;
+        const auto small = repetitive(100, 1);
+        output_buffer out;
+        compressor.write(out, small);
+        EXPECT_EQ(out.view()[1], static_cast<std::uint8_t>(compression::none));
+        const auto stored = compressor.decompress(out.view());
+        EXPECT_EQ(copy(stored), small);
+        EXPECT_EQ(stored.data(), out.data() + 2); // returned in place
+
+        std::vector<std::uint8_t> noise(1000);
+        for (std::size_t i = 0; i < noise.size(); ++i) {
+            noise[i] = static_cast<std::uint8_t>(i * 7);
+        }
+        out.clear();
+        compressor.write(out, noise);
+        EXPECT_EQ(copy(compressor.decompress(out.view())), noise);
+        EXPECT_GT(out.size(), noise.size());
+    }
+
+    TEST(compression, sending_keeps_the_last_decompressed_frame) {
+        frame_compressor<run_length_codec> compressor;
+        const auto request = repetitive(4000, 1);
+        const auto reply = repetitive(3000, 9);
+        output_buffer in;
+        compressor.write(in, request);
+        const auto received = compressor.decompress(in.view());
+        output_buffer out;
+        compressor.write(out, reply);
+        EXPECT_EQ(copy(received), request);
+        EXPECT_EQ(copy(compressor.decompress(out.view())), reply);
+    }
+
+    TEST(compression, flush_wraps_a_frame_writer) {
+        frame_compressor<run_length_codec> compressor;
+        frame_writer<varint_format> frames;
+        for (int i = 0; i < 100; ++i) {
+            frames.add(std::string(50, 'a'));
+        }
+        output_buffer out;
+        compressor.flush(frames, out);
+        EXPECT_TRUE(frames.empty());
+        const frame_view view(compressor.decompress(out.view()));
+        EXPECT_EQ(view.count(), 100u);
+        for (const auto message : view) {
+            EXPECT_EQ((deserialize<std::string, varint_format>(message)), std::string(50, 'a'));
+        }
+    }
+
+    TEST(compression, malformed_envelopes_throw) {
+        frame_compressor<run_length_codec> compressor;
+        // compressed envelope announcing more than a receiver will inflate
+        output_buffer out;
+        out.write(test::bytes_of({ 8, static_cast<int>(compression::lz4) }).data(), 2);
+        const std::size_t used = encode_varint(std::uint64_t{ max_decompressed_frame_size } + 1, out.prepare(max_varint_size));
+        out.commit(used);
+        out.write(test::bytes_of({ 1, 0 }).data(), 2);
+        EXPECT_THROW((void)compressor.decompress(out.view()), error);
+
+        EXPECT_THROW((void)compressor.decompress(test::bytes_of({ 3, static_cast<int>(compression::zstd), 1, 0 })), error);
+        EXPECT_THROW((void)compressor.decompress(test::bytes_of({ 5, 0 })), error);
+    }
+
+}
@@ -0,0 +1,167 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::round_trip;
+
+    struct point {
+        std::int32_t x;
+        std::int32_t y;
+
+        bool operator==(const point&) const = default;
+    };
+
+    struct order {
+        std::uint64_t id;
+        std::string symbol;
+        std::vector<point> fills;
+        std::optional<double> limit;
+        std::map<std::string, std::int32_t> tags;
+
+        bool operator==(const order&) const = default;
+    };
+
+    class account {
+    public:
+        HOPE_FIELDS(id_, owner_)
+
+        account() = default;
+        account(std::uint64_t id, std::string owner)
+            : id_(id)
+            , owner_(std::move(owner)) {}
+
+        bool operator==(const account&) const = default;
+
+    private:
+        std::uint64_t id_{};
+        std::string owner_;
+    };
+
+    class handle {
+    public:
+        handle() = default;
+        explicit handle(std::uint32_t id) noexcept
+            : id_(id) {}
+
+        bool operator==(const handle&) const = default;
+
+    private:
+        std::uint32_t id_{};
+        std::uint32_t generation_{};
+    };
+
+    class padded_handle {
+    public:
+        padded_handle() = default;
+
+    private:
+        std::uint8_t kind_{};
+        std::uint32_t id_{};
+    };
+
+    static_assert(!enable_bitwise<std::optional<std::uint32_t>>::value);
+    static_assert(!enable_bitwise<std::optional<point>>::value);
+    static_assert(enable_bitwise<handle>::value);
+    static_assert(!enable_bitwise<padded_handle>::value);
+
+    TEST(core, scalars) {
+        EXPECT_EQ(round_trip(std::int8_t{ -5 }), -5);
+        EXPECT_EQ(round_trip(std::uint16_t{ 0xbeef }), 0xbeef);
+        EXPECT_EQ(round_trip(std::int64_t{ -1234567890123 }), -1234567890123);
+        EXPECT_EQ(round_trip(3.25), 3.25);
+        EXPECT_EQ(round_trip(true), true);
+        EXPECT_EQ(serialize(std::uint32_t{ 1 }).size(), 4u);
+    }
+
+    TEST(core, strings_and_containers) {
+        EXPECT_EQ(round_trip(std::string("hello")), "hello");
+        EXPECT_EQ(round_trip(std::string()), "");
+        EXPECT_EQ(round_trip(std::vector<std::int32_t>{ 1, 2, 3 }), (std::vector<std::int32_t>{ 1, 2, 3 }));
+        EXPECT_EQ(round_trip(std::vector<std::string>{ "a", "", "ccc" }), (std::vector<std::string>{ "a", "", "ccc" }));
+        EXPECT_EQ(round_trip(std::deque<std::int16_t>{ 4, 5 }), (std::deque<std::int16_t>{ 4, 5 }));
+        EXPECT_EQ(round_trip(std::list<std::string>{ "x", "y" }), (std::list<std::string>{ "x", "y" }));
+        EXPECT_EQ(round_trip(std::vector<bool>{ true, false, true }), (std::vector<bool>{ true, false, true }));
+        EXPECT_EQ(round_trip(std::set<std::int32_t>{ 3, 1, 2 }), (std::set<std::int32_t>{ 1, 2, 3 }));
+        const std::unordered_map<std::string, std::int32_t> map{ { "one", 1 }, { "two", 2 } };
+        EXPECT_EQ(round_trip(map), map);
+    }
+
+    TEST(core, optionals_tuples_and_arrays) {
+        EXPECT_EQ(round_trip(std::optional<std::string>("x")), std::optional<std::string>("x"));
+        EXPECT_EQ(round_trip(std::optional<std::string>()), std::nullopt);
+        const auto tuple = std::make_tuple(std::int32_t{ 1 }, std::string("two"), 3.0);
+        EXPECT_EQ(round_trip(tuple), tuple);
+        const auto pair = std::make_pair(std::string("key"), std::int64_t{ -7 });
+        EXPECT_EQ(round_trip(pair), pair);
+        const std::array<std::string, 2> strings{ "a", "b" };
+        EXPECT_EQ(round_trip(strings), strings);
+        const std::array<point, 2> points{ point{ 1, 2 }, point{ 3, 4 } };
+        EXPECT_EQ(round_trip(points), points);
+    }
+
+    TEST(core, optionals_of_bitwise_values_are_flag_and_value) {
+        EXPECT_EQ(serialize(std::optional<std::uint32_t>()), test::bytes_of({ 0 }));
+        EXPECT_EQ(serialize(std::optional<std::uint32_t>(7)).size(), 5u);
+        EXPECT_EQ(round_trip(std::optional<std::uint32_t>(7)), 7u);
+        EXPECT_EQ(round_trip(std::optional<point>(point{ 1, 2 })), (point{ 1, 2 }));
+        EXPECT_EQ(round_trip(std::vector<std::optional<std::int16_t>>{ 1, std::nullopt, 3 }),
+            (std::vector<std::optional<std::int16_t>>{ 1, std::nullopt, 3 }));
+    }
+
+    TEST(core, opaque_classes_without_padding_are_copied) {
+        EXPECT_EQ(serialize(handle(5)).size(), sizeof(handle));
+        EXPECT_EQ(round_trip(handle(5)), handle(5));
+    }
+
+    TEST(core, records) {
+        const order value{ 42, "ABC", { { 1, 2 }, { 3, 4 } }, 9.5, { { "desk", 7 } } };
+        EXPECT_EQ(round_trip(value), value);
+        EXPECT_EQ(round_trip(account(7, "ann")), account(7, "ann"));
+        // plain aggregates are one memcpy
+        EXPECT_EQ(serialize(point{ 1, 2 }).size(), sizeof(point));
+    }
+
+    TEST(core, writer_and_reader_share_a_stream) {
+        output_buffer buffer;
+        writer out(buffer);
+        out.write(std::uint32_t{ 5 });
+        out.write(std::string("next"));
+        input_buffer input(buffer.view());
+        reader in(input);
+        EXPECT_EQ(in.read<std::uint32_t>(), 5u);
+        EXPECT_EQ(in.read<std::string>(), "next");
+        EXPECT_EQ(input.remaining(), 0u);
+    }
+
+    TEST(core, truncated_input_throws) {
+        auto bytes = serialize(order{ 1, "symbol", { { 1, 2 } }, std::nullopt, {} });
+        bytes.pop_back();
+        EXPECT_THROW((void)deserialize<order>(bytes), error);
+    }
+
+    TEST(core, hostile_length_prefix_throws) {
+        const auto bytes = serialize(std::uint64_t{ 1 } << 40);
+        EXPECT_THROW((void)deserialize<std::vector<std::uint64_t>>(bytes), error);
+    }
+
+}
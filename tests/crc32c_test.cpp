@@ -0,0 +1,192 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/crc32c.h"
+#include "hope/serialization/framing.h"
+#include "hope/serialization/gather_buffer.h"
+#include "hope/serialization/parallel.h"
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct record {
+        std::uint32_t id;
+        std::string name;
+        std::vector<double> values;
+
+        bool operator==(const record&) const = default;
+    };
+
+    /**
+     * Bit at a time reference the table and instruction kernels are checked against.
+     */
+    std::uint32_t reference_crc32c(std::span<const std::uint8_t> bytes) {
+        std::uint32_t crc = ~std::uint32_t{ 0 };
+        for (const auto byte : bytes) {
+            crc ^= byte;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82f63b78 & (0u - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    std::vector<std::uint8_t> noise(std::size_t size) {
+        std::vector<std::uint8_t> bytes(size);
+        std::uint64_t state = 0x9e3779b97f4a7c15;
+        for (auto& byte : bytes) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            byte = static_cast<std::uint8_t>(state);
+        }
+        return bytes;
+    }
+
+    /**
+     * Output stream whose write number fail_at throws, e.g. a socket that fails halfway through a frame.
+     */
+    struct failing_stream {
+        int fail_at;
+        int writes{ 0 };
+
+        void write(const void*, std::size_t) {
+            if (++writes == fail_at) {
+                throw std::runtime_error("write failed");
+            }
+        }
+    };
+
+    std::span<const std::uint8_t> bytes_of(std::string_view text) {
+        return { reinterpret_cast<const std::uint8_t*>(text.data()), text.size() };
+    }
+
+    TEST(crc32c, known_vectors) {
+        EXPECT_EQ(crc32c(std::span<const std::uint8_t>()), 0u);
+        EXPECT_EQ(crc32c(bytes_of("123456789")), 0xe3069283u);
+        EXPECT_EQ(crc32c(std::vector<std::uint8_t>(32, 0)), 0x8a9136aau);
+        EXPECT_EQ(crc32c(std::vector<std::uint8_t>(32, 0xff)), 0x62a8ab43u);
+        std::vector<std::uint8_t> ascending(32);
+        for (std::size_t i = 0; i < ascending.size(); ++i) {
+            ascending[i] = static_cast<std::uint8_t>(i);
+        }
+        EXPECT_EQ(crc32c(ascending), 0x46dd794eu);
+    }
+
+    TEST(crc32c, every_length_and_alignment_matches_the_reference) {
+        const auto bytes = noise(100000);
+        for (std::size_t size = 0; size < 64; ++size) {
+            for (std::size_t offset = 0; offset < 8; ++offset) {
+                const auto part = std::span(bytes).subspan(offset, size);
+                EXPECT_EQ(crc32c(part), reference_crc32c(part));
+            }
+        }
+        // around the point where three interleaved streams take over
+        for (const std::size_t size : { std::size_t{ 12287 }, std::size_t{ 12288 }, std::size_t{ 12289 }, std::size_t{ 40000 },
+                 std::size_t{ 99993 } }) {
+            const auto part = std::span(bytes).subspan(3, size);
+            EXPECT_EQ(crc32c(part), reference_crc32c(part));
+        }
+    }
+
+    TEST(crc32c, continuation_and_combination) {
+        const auto bytes = noise(30000);
+        const std::uint32_t whole = crc32c(bytes);
+        for (const std::size_t split : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 4095 }, std::size_t{ 12288 }, std::size_t{ 30000 } }) {
+            const auto first = std::span(bytes).first(split);
+            const auto second = std::span(bytes).subspan(split);
+            EXPECT_EQ(crc32c(second, crc32c(first)), whole);
+            EXPECT_EQ(crc32c_combine(crc32c(first), crc32c(second), second.size()), whole);
+        }
+        static_assert(crc32c_combine(0x12345678, 0, 0) == 0x12345678);
+    }
+
+    TEST(crc32c, gather_output_is_checksummed_in_place) {
+        const record value{ 1, "gathered", std::vector<double>(5000, 0.25) };
+        gather_buffer gather;
+        writer<gather_buffer>(gather).write(value);
+        ASSERT_LT(gather.copied(), gather.size()); // the values are referenced, not copied
+        EXPECT_EQ(crc32c(gather.segments()), crc32c(serialize(value)));
+    }
+
+    TEST(crc32c, parallel_checksums_match) {
+        work_stealing_pool pool(3);
+        std::vector<record> records;
+        for (std::uint32_t i = 0; i < 3000; ++i) {
+            records.push_back({ i, std::to_string(i), std::vector<double>(i % 5, i) });
+        }
+        output_buffer out;
+        out.write("head", 4);
+        std::uint32_t checksum = 0;
+        serialize_parallel<varint_format>(records, out, pool, 256, &checksum);
+        EXPECT_EQ(checksum, crc32c(out.view().subspan(4)));
+
+        const auto bytes = noise(5 << 20);
+        EXPECT_EQ(crc32c(bytes, pool), crc32c(bytes));
+        EXPECT_EQ(crc32c(std::span(bytes).first(1000), pool, 64), crc32c(std::span(bytes).first(1000)));
+        EXPECT_EQ(crc32c(std::span<const std::uint8_t>(), pool), 0u);
+    }
+
+    TEST(crc32c, frame_trailers_catch_corruption) {
+        frame_writer<varint_format> frame(frame_integrity::crc32c);
+        EXPECT_EQ(frame.integrity(), frame_integrity::crc32c);
+        frame.add(record{ 1, "one", { 1.0 } });
+        frame.add(record{ 2, "two", {} });
+        output_buffer out;
+        frame.flush(out);
+        auto bytes = std::vector<std::uint8_t>(out.view().begin(), out.view().end());
+        EXPECT_EQ(frame_size(bytes), bytes.size());
+
+        std::vector<record> records;
+        for (const auto message : frame_view(bytes, frame_integrity::crc32c)) {
+            records.push_back(deserialize<record, varint_format>(message));
+        }
+        EXPECT_EQ(records, (std::vector<record>{ { 1, "one", { 1.0 } }, { 2, "two", {} } }));
+
+        for (const std::size_t position : { std::size_t{ 1 }, bytes.size() / 2, bytes.size() - 1 }) {
+            auto damaged = bytes;
+            damaged[position] ^= 0x10;
+            EXPECT_THROW(frame_view(damaged, frame_integrity::crc32c), error) << "byte " << position;
+        }
+        EXPECT_THROW(frame_view(test::bytes_of({ 2, 0, 0 }), frame_integrity::crc32c), error);
+    }
+
+    TEST(crc32c, failed_flush_leaves_no_trailer_behind) {
+        const std::vector<record> sent{ { 1, "one", { 1.0 } }, { 2, "two", {} } };
+        for (const int fail_at : { 1, 2 }) {
+            frame_writer<varint_format> frame(frame_integrity::crc32c);
+            for (const auto& message : sent) {
+                frame.add(message);
+            }
+            const std::size_t body_size = frame.body_size();
+            failing_stream broken{ fail_at };
+            EXPECT_THROW(frame.flush(broken), std::runtime_error);
+            EXPECT_EQ(frame.count(), sent.size());
+            EXPECT_EQ(frame.body_size(), body_size);
+
+            output_buffer out;
+            frame.flush(out);
+            EXPECT_TRUE(frame.empty());
+            EXPECT_EQ(frame_size(out.view()), out.size());
+            std::vector<record> records;
+            for (const auto message : frame_view(out.view(), frame_integrity::crc32c)) {
+                records.push_back(deserialize<record, varint_format>(message));
+            }
+            EXPECT_EQ(records, sent) << "write " << fail_at << " failed";
+        }
+    }
+
+}
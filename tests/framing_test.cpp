@@ -0,0 +1,117 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/framing.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct faulty {
+        bool fail;
+    };
+
+}
+
+template <>
+struct hope::serialization::serializer<faulty> {
+    template <typename Writer>
+    static void write(Writer& writer, const faulty& value) {
+        writer.write(std::uint64_t{ 0xfeedface });
+        if (value.fail) {
+            throw std::runtime_error("faulty");
+        }
+    }
+};
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct event {
+        std::uint32_t id;
+        std::string text;
+
+        bool operator==(const event&) const = default;
+    };
+
+    std::vector<event> read_frame(std::span<const std::uint8_t> bytes) {
+        std::vector<event> events;
+        for (const auto message : frame_view(bytes)) {
+            events.push_back(deserialize<event, varint_format>(message));
+        }
+        return events;
+    }
+
+    TEST(framing, round_trip) {
+        const std::vector<event> events{ { 1, "one" }, { 2, "" }, { 300, std::string(200, 'x') } };
+        frame_writer<varint_format> frame;
+        for (const auto& value : events) {
+            frame.add(value);
+        }
+        EXPECT_EQ(frame.count(), 3u);
+        output_buffer out;
+        frame.flush(out);
+        EXPECT_TRUE(frame.empty());
+        EXPECT_EQ(frame_size(out.view()), out.size());
+        EXPECT_EQ(frame_view(out.view()).size(), out.size());
+        EXPECT_EQ(read_frame(out.view()), events);
+    }
+
+    TEST(framing, empty_frame_writes_nothing) {
+        frame_writer<varint_format> frame;
+        output_buffer out;
+        frame.flush(out);
+        EXPECT_EQ(out.size(), 0u);
+    }
+
+    TEST(framing, failed_add_leaves_the_frame_as_it_was) {
+        frame_writer<varint_format> frame;
+        frame.add(event{ 1, "one" });
+        const auto body = frame.body_size();
+        EXPECT_THROW(frame.add(faulty{ true }), std::runtime_error);
+        EXPECT_EQ(frame.count(), 1u);
+        EXPECT_EQ(frame.body_size(), body);
+        frame.add(event{ 2, "two" });
+        output_buffer out;
+        frame.flush(out);
+        EXPECT_EQ(read_frame(out.view()), (std::vector<event>{ { 1, "one" }, { 2, "two" } }));
+    }
+
+    TEST(framing, frame_size_waits_for_the_prefix) {
+        frame_writer<varint_format> frame;
+        frame.add(event{ 7, std::string(300, 'a') });
+        output_buffer out;
+        frame.flush(out);
+        EXPECT_EQ(frame_size(out.view().first(1)), 0u);
+        EXPECT_EQ(frame_size(out.view().first(2)), out.size());
+    }
+
+    TEST(framing, frame_size_rejects_hostile_lengths) {
+        EXPECT_THROW((void)frame_size(test::bytes_of({ 0x80, 0x80, 0x80, 0x80, 0x80, 0x04 })), error);
+        EXPECT_THROW((void)frame_size(test::bytes_of({ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff })), error);
+        EXPECT_EQ(frame_size(test::bytes_of({ 0x10 }), 16), 17u);
+        EXPECT_THROW((void)frame_size(test::bytes_of({ 0x11 }), 16), error);
+    }
+
+    TEST(framing, malformed_frames_throw) {
+        frame_writer<varint_format> frame;
+        frame.add(event{ 1, "one" });
+        frame.add(event{ 2, "two" });
+        output_buffer out;
+        frame.flush(out);
+        auto bytes = std::vector<std::uint8_t>(out.view().begin(), out.view().end());
+        EXPECT_THROW(frame_view(std::span(bytes).first(bytes.size() - 1)), error);
+        bytes[2] = 0x7f; // first message length beyond the frame
+        EXPECT_THROW(frame_view{ bytes }, error);
+    }
+
+}
@@ -0,0 +1,170 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/gather_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct point {
+        std::int32_t x;
+        std::int32_t y;
+
+        bool operator==(const point&) const = default;
+    };
+
+    struct upload {
+        std::uint32_t id;
+        std::string name;
+        std::vector<std::uint8_t> payload;
+        std::vector<point> track;
+        std::string note;
+
+        bool operator==(const upload&) const = default;
+    };
+
+    upload sample_upload() {
+        upload value{ 7, std::string(5000, 'n'), std::vector<std::uint8_t>(6000), std::vector<point>(1000), "short" };
+        for (std::size_t i = 0; i < value.payload.size(); ++i) {
+            value.payload[i] = static_cast<std::uint8_t>(i * 31);
+        }
+        for (std::size_t i = 0; i < value.track.size(); ++i) {
+            value.track[i] = { static_cast<std::int32_t>(i), -static_cast<std::int32_t>(i) };
+        }
+        return value;
+    }
+
+    std::vector<std::uint8_t> flatten(std::span<const segment> segments) {
+        std::vector<std::uint8_t> bytes;
+        for (const auto& part : segments) {
+            const auto* data = static_cast<const std::uint8_t*>(part.iov_base);
+            bytes.insert(bytes.end(), data, data + part.iov_len);
+        }
+        return bytes;
+    }
+
+    bool points_into(const segment& part, const void* data) { return part.iov_base == data; }
+
+    template <format Format = format{}, typename T>
+    std::vector<std::uint8_t> gather(const T& value, std::size_t threshold = gather_buffer::default_reference_threshold) {
+        gather_buffer out(threshold);
+        writer<gather_buffer, Format>(out).write(value);
+        const auto bytes = flatten(out.segments());
+        EXPECT_EQ(out.size(), bytes.size());
+        return bytes;
+    }
+
+    TEST(gather_buffer, segments_concatenate_to_the_serialized_bytes) {
+        const auto value = sample_upload();
+        EXPECT_EQ(gather(value), serialize(value));
+        EXPECT_EQ(gather<varint_format>(value), serialize<varint_format>(value));
+        EXPECT_EQ(gather(value, 1), serialize(value));
+        EXPECT_EQ(gather(value.payload), serialize(value.payload));
+        EXPECT_EQ(gather(value.track), serialize(value.track));
+
+        const std::span<const std::uint8_t> bytes(value.payload);
+        EXPECT_EQ(gather(bytes), serialize(bytes));
+    }
+
+    TEST(gather_buffer, large_blobs_are_referenced_in_place) {
+        const auto value = sample_upload();
+        gather_buffer out;
+        writer<gather_buffer>(out).write(value);
+        const auto segments = out.segments();
+        // id and name length | name | payload length | payload | track length | track | note
+        ASSERT_EQ(segments.size(), 7u);
+        EXPECT_TRUE(points_into(segments[1], value.name.data()));
+        EXPECT_TRUE(points_into(segments[3], value.payload.data()));
+        EXPECT_TRUE(points_into(segments[5], value.track.data()));
+        EXPECT_EQ(out.copied(), serialize(value).size() - value.name.size() - value.payload.size()
+                - value.track.size() * sizeof(point));
+    }
+
+    TEST(gather_buffer, threshold_is_inclusive) {
+        constexpr std::size_t threshold = 64;
+        for (const std::size_t size : { threshold - 1, threshold, threshold + 1 }) {
+            const std::string text(size, 'x');
+            gather_buffer out(threshold);
+            writer<gather_buffer>(out).write(text);
+            const auto segments = out.segments();
+            EXPECT_EQ(flatten(segments), serialize(text)) << size;
+            if (size < threshold) {
+                ASSERT_EQ(segments.size(), 1u);
+                EXPECT_EQ(out.copied(), sizeof(std::uint64_t) + size);
+            } else {
+                ASSERT_EQ(segments.size(), 2u);
+                EXPECT_TRUE(points_into(segments[1], text.data())) << size;
+                EXPECT_EQ(out.copied(), sizeof(std::uint64_t));
+            }
+        }
+    }
+
+    TEST(gather_buffer, zero_size_writes_add_no_segments) {
+        gather_buffer out(0);
+        out.write_reference(nullptr, 0);
+        EXPECT_TRUE(out.segments().empty());
+        EXPECT_EQ(out.size(), 0u);
+
+        // every blob qualifies for referencing, empty ones must still not become empty segments
+        const upload empty{ 1, "", {}, {}, "" };
+        writer<gather_buffer>(out).write(empty);
+        const auto segments = out.segments();
+        EXPECT_EQ(flatten(segments), serialize(empty));
+        for (const auto& part : segments) {
+            EXPECT_NE(part.iov_len, 0u);
+        }
+    }
+
+    TEST(gather_buffer, clear_allows_reuse) {
+        const auto first = sample_upload();
+        upload second = first;
+        second.name = "renamed";
+        second.payload.resize(10);
+
+        gather_buffer out;
+        writer<gather_buffer>(out).write(first);
+        ASSERT_EQ(flatten(out.segments()), serialize(first));
+        out.clear();
+        EXPECT_EQ(out.size(), 0u);
+        EXPECT_EQ(out.copied(), 0u);
+        EXPECT_TRUE(out.segments().empty());
+
+        writer<gather_buffer>(out).write(second);
+        EXPECT_EQ(flatten(out.segments()), serialize(second));
+        EXPECT_EQ(out.size(), serialize(second).size());
+    }
+
+    TEST(gather_buffer, earlier_segments_survive_chunk_growth) {
+        const std::string blob(32, 'b');
+        gather_buffer out(16);
+        writer<gather_buffer> encoder(out);
+        encoder.write(std::uint32_t{ 0xa1b2c3d4 });
+        encoder.write(blob);
+        // small writes after the reference keep appending to the chunk until it has moved several times
+        std::vector<std::uint8_t> expected = serialize(std::uint32_t{ 0xa1b2c3d4 });
+        const auto blob_bytes = serialize(blob);
+        expected.insert(expected.end(), blob_bytes.begin(), blob_bytes.end());
+        for (std::uint32_t i = 0; i < 100000; ++i) {
+            encoder.write(i);
+            const auto word = serialize(i);
+            expected.insert(expected.end(), word.begin(), word.end());
+        }
+        const auto segments = out.segments();
+        ASSERT_EQ(segments.size(), 3u);
+        EXPECT_TRUE(points_into(segments[1], blob.data()));
+        EXPECT_EQ(flatten(segments), expected);
+    }
+
+}
@@ -0,0 +1,153 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/incremental_reader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct sample {
+        std::int32_t x;
+        std::string label;
+
+        bool operator==(const sample&) const = default;
+    };
+
+    struct message {
+        std::uint64_t id;
+        std::string text;
+        std::vector<std::uint32_t> values;
+        std::vector<sample> samples;
+        std::map<std::string, std::int32_t> tags;
+        std::optional<double> price;
+
+        bool operator==(const message&) const = default;
+    };
+
+    /**
+     * Feeds bytes to an incremental_reader in chunks of chunk bytes and checks it used all of them.
+     */
+    template <format Format, typename T>
+    [[nodiscard]] T decode_in_chunks(std::span<const std::uint8_t> bytes, std::size_t chunk) {
+        T value{};
+        incremental_reader<T, Format> decoder(value);
+        std::size_t used = 0;
+        while (!decoder.done()) {
+            EXPECT_LT(used, bytes.size());
+            if (used == bytes.size()) {
+                break;
+            }
+            used += decoder.feed(bytes.subspan(used, std::min(chunk, bytes.size() - used)));
+        }
+        EXPECT_EQ(used, bytes.size());
+        EXPECT_EQ(decoder.consumed(), bytes.size());
+        return value;
+    }
+
+    message sample_message() {
+        message value{ 42, "hello", {}, { { 1, "one" }, { -2, "two" } }, { { "desk", 7 } }, 9.5 };
+        for (std::uint32_t i = 0; i < 3000; ++i) {
+            value.values.push_back(i * 2654435761u);
+        }
+        return value;
+    }
+
+    TEST(incremental, matches_the_eager_reader) {
+        const auto value = sample_message();
+        const auto fixed = serialize(value);
+        const auto varint = serialize<varint_format>(value);
+        const auto columns = serialize<columnar_format>(value);
+        for (const std::size_t chunk : { std::size_t{ 1 }, std::size_t{ 7 }, std::size_t{ 4096 }, fixed.size() }) {
+            EXPECT_EQ((decode_in_chunks<format{}, message>(fixed, chunk)), value);
+            EXPECT_EQ((decode_in_chunks<varint_format, message>(varint, chunk)), value);
+            EXPECT_EQ((decode_in_chunks<columnar_format, message>(columns, chunk)), value);
+        }
+    }
+
+    TEST(incremental, long_sequences_grow_in_steps) {
+        std::vector<std::uint64_t> values(100000);
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            values[i] = i * i;
+        }
+        const auto varint = serialize<varint_format>(values);
+        EXPECT_EQ((decode_in_chunks<varint_format, std::vector<std::uint64_t>>(varint, 1000)), values);
+        const std::vector<sample> samples(5000, sample{ 3, "x" });
+        const auto columns = serialize<columnar_format>(samples);
+        EXPECT_EQ((decode_in_chunks<columnar_format, std::vector<sample>>(columns, 333)), samples);
+    }
+
+    TEST(incremental, existing_elements_are_replaced) {
+        std::vector<std::string> target{ "a", "b", "c", "d" };
+        const auto bytes = serialize(std::vector<std::string>{ "x", "y" });
+        incremental_reader<std::vector<std::string>> decoder(target);
+        for (const auto byte : bytes) {
+            (void)decoder.feed(std::span(&byte, 1));
+        }
+        ASSERT_TRUE(decoder.done());
+        EXPECT_EQ(target, (std::vector<std::string>{ "x", "y" }));
+    }
+
+    TEST(incremental, hostile_length_prefix_throws) {
+        // about 2^42 elements: must be refused before anything is allocated
+        const auto prefix = test::bytes_of({ 0x80, 0x80, 0x80, 0x80, 0x80, 0x04 });
+        std::vector<std::uint64_t> values;
+        incremental_reader<std::vector<std::uint64_t>, varint_format> decoder(values);
+        EXPECT_THROW((void)decoder.feed(prefix), error);
+
+        std::map<std::string, std::string> map;
+        incremental_reader<std::map<std::string, std::string>, varint_format> map_decoder(map);
+        EXPECT_THROW((void)map_decoder.feed(prefix), error);
+
+        std::vector<sample> samples;
+        incremental_reader<std::vector<sample>, columnar_format> column_decoder(samples);
+        EXPECT_THROW((void)column_decoder.feed(prefix), error);
+    }
+
+    TEST(incremental, prefix_below_the_limit_allocates_with_the_input) {
+        // 16 MiB announced, nothing sent yet: only the first step is allocated
+        std::vector<std::uint32_t> values;
+        incremental_reader<std::vector<std::uint32_t>, fixed_format> decoder(values);
+        const auto fixed_prefix = serialize(std::uint64_t{ 1 } << 22);
+        EXPECT_EQ(decoder.feed(fixed_prefix), fixed_prefix.size());
+        EXPECT_FALSE(decoder.done());
+        EXPECT_LE(values.capacity(), std::size_t{ 1 } << 16);
+
+        // 256 MiB of characters is over the default limit
+        const auto prefix = test::bytes_of({ 0x80, 0x80, 0x80, 0x80, 0x01 });
+        std::string text;
+        incremental_reader<std::string, varint_format> text_decoder(text);
+        EXPECT_THROW((void)text_decoder.feed(prefix), error);
+    }
+
+    TEST(incremental, limit_is_configurable) {
+        const std::vector<std::uint32_t> small(10, 5);
+        const auto bytes = serialize(small);
+        std::vector<std::uint32_t> values;
+        incremental_reader<std::vector<std::uint32_t>> tight(values, nullptr, 16);
+        EXPECT_THROW((void)tight.feed(bytes), error);
+        incremental_reader<std::vector<std::uint32_t>> loose(values, nullptr, bytes.size());
+        EXPECT_EQ(loose.feed(bytes), bytes.size());
+        EXPECT_EQ(values, small);
+
+        const std::vector<std::string> strings(10, "abc");
+        const auto string_bytes = serialize<varint_format>(strings);
+        std::vector<std::string> decoded;
+        incremental_reader<std::vector<std::string>, varint_format> whole(decoded, nullptr, string_bytes.size() - 1);
+        EXPECT_THROW((void)whole.feed(string_bytes), error);
+    }
+
+}
@@ -0,0 +1,122 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/lazy.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct padded {
+        std::uint8_t kind;
+        std::uint32_t id;
+    };
+
+    struct nested_padded {
+        std::uint16_t version;
+        padded inner;
+        std::uint8_t flags;
+        std::uint64_t stamp;
+    };
+
+    struct fused {
+        std::uint8_t kind;
+        std::uint32_t id;
+        std::uint16_t port;
+        padded inner;
+        std::string name;
+    };
+
+    struct quote {
+        std::uint64_t id;
+        std::string symbol;
+        std::vector<std::int32_t> levels;
+        std::optional<double> price;
+        padded source;
+    };
+
+    static_assert(detail::raw<padded, format{}>);
+    static_assert(detail::raw<nested_padded, format{}>);
+    static_assert(!detail::raw<fused, format{}>);
+    static_assert(sizeof(padded) > 5, "the tests below rely on padding after kind");
+
+    TEST(lazy, padded_raw_record) {
+        const auto bytes = serialize(padded{ 7, 0x11223344 });
+        ASSERT_EQ(bytes.size(), sizeof(padded));
+        const lazy_view<padded> view(bytes);
+        EXPECT_EQ(view.get<0>(), 7);
+        EXPECT_EQ(view.get<1>(), 0x11223344u);
+        EXPECT_EQ(view.field_bytes<1>().size(), sizeof(std::uint32_t));
+    }
+
+    TEST(lazy, nested_raw_record) {
+        const nested_padded value{ 3, { 9, 0xa1b2c3d4 }, 0x5a, 0x0102030405060708 };
+        const auto bytes = serialize(value);
+        const lazy_view<nested_padded> view(bytes);
+        EXPECT_EQ(view.get<0>(), 3);
+        EXPECT_EQ(view.get<1>().get<0>(), 9);
+        EXPECT_EQ(view.get<1>().get<1>(), 0xa1b2c3d4u);
+        EXPECT_EQ(view.decode<1>().id, 0xa1b2c3d4u);
+        EXPECT_EQ(view.get<2>(), 0x5a);
+        EXPECT_EQ(view.get<3>(), 0x0102030405060708u);
+    }
+
+    TEST(lazy, fused_fields_are_back_to_back) {
+        const fused value{ 1, 0xdeadbeef, 8080, { 2, 0x01020304 }, "gateway" };
+        const auto bytes = serialize(value);
+        const lazy_view<fused> view(bytes);
+        EXPECT_EQ(view.get<1>(), 0xdeadbeefu);
+        EXPECT_EQ(view.get<2>(), 8080);
+        EXPECT_EQ(view.get<3>().get<1>(), 0x01020304u);
+        EXPECT_EQ(view.get<4>(), "gateway");
+        EXPECT_EQ(view.get<0>(), 1);
+    }
+
+    TEST(lazy, record_with_dynamic_fields) {
+        const quote value{ 42, "ABC", { 1, -2, 3 }, 9.5, { 4, 77 } };
+        const auto bytes = serialize<varint_format>(value);
+        const lazy_view<quote, varint_format> view(bytes);
+        EXPECT_EQ(view.get<4>().get<1>(), 77u);
+        EXPECT_EQ(view.get<1>(), "ABC");
+        EXPECT_EQ(view.get<2>(), (std::vector<std::int32_t>{ 1, -2, 3 }));
+        EXPECT_EQ(view.get<3>(), 9.5);
+        EXPECT_EQ(view.get<0>(), 42u);
+    }
+
+    TEST(lazy, explicit_byte_order) {
+        constexpr format big{ .order = byte_order::big };
+        const nested_padded value{ 3, { 9, 0xa1b2c3d4 }, 0x5a, 0x0102030405060708 };
+        const auto bytes = serialize<big>(value);
+        const lazy_view<nested_padded, big> view(bytes);
+        EXPECT_EQ(view.get<1>().get<1>(), 0xa1b2c3d4u);
+        EXPECT_EQ(view.get<3>(), 0x0102030405060708u);
+    }
+
+    TEST(lazy, tagged_record) {
+        const quote value{ 42, "ABC", {}, std::nullopt, { 4, 77 } };
+        const auto bytes = serialize<tagged_format>(value);
+        const lazy_view<quote, tagged_format> view(bytes);
+        EXPECT_FALSE(view.has<3>());
+        EXPECT_EQ(view.get<3>(), std::nullopt);
+        EXPECT_EQ(view.get<4>().get<1>(), 77u);
+        EXPECT_EQ(view.get<1>(), "ABC");
+    }
+
+    TEST(lazy, truncated_raw_record_throws) {
+        auto bytes = serialize(padded{ 7, 1 });
+        bytes.pop_back();
+        const lazy_view<padded> view(bytes);
+        EXPECT_THROW((void)view.get<0>(), error);
+    }
+
+}
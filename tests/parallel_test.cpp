@@ -0,0 +1,142 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/parallel.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct sample {
+        std::uint64_t time;
+        double value;
+        std::string tag;
+
+        bool operator==(const sample&) const = default;
+    };
+
+    std::vector<sample> samples(std::size_t count) {
+        std::vector<sample> values;
+        for (std::size_t i = 0; i < count; ++i) {
+            values.push_back({ i * 10, static_cast<double>(i) / 3, std::string(i % 11, 's') });
+        }
+        return values;
+    }
+
+    TEST(parallel, parallel_for_runs_every_index_once) {
+        work_stealing_pool pool(4);
+        EXPECT_EQ(pool.size(), 4u);
+        std::vector<std::atomic<int>> calls(10000);
+        pool.parallel_for(calls.size(), [&](std::size_t i) { calls[i].fetch_add(1); });
+        for (const auto& count : calls) {
+            EXPECT_EQ(count.load(), 1);
+        }
+        pool.parallel_for(0, [](std::size_t) { FAIL(); });
+    }
+
+    TEST(parallel, nested_parallel_for_does_not_deadlock) {
+        work_stealing_pool pool(2);
+        std::atomic<std::size_t> total{ 0 };
+        pool.parallel_for(8, [&](std::size_t) { pool.parallel_for(100, [&](std::size_t i) { total.fetch_add(i); }); });
+        EXPECT_EQ(total.load(), 8u * 4950);
+    }
+
+    TEST(parallel, exceptions_reach_the_caller_after_the_batch) {
+        work_stealing_pool pool(3);
+        std::atomic<int> calls{ 0 };
+        EXPECT_THROW(pool.parallel_for(100,
+                         [&](std::size_t i) {
+                             calls.fetch_add(1);
+                             if (i % 10 == 3) {
+                                 throw std::runtime_error("job failed");
+                             }
+                         }),
+            std::runtime_error);
+        EXPECT_EQ(calls.load(), 100);
+    }
+
+    TEST(parallel, vectors_round_trip_in_chunks) {
+        work_stealing_pool pool(4);
+        for (const std::size_t count : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 999 }, std::size_t{ 1000 }, std::size_t{ 12345 } }) {
+            const auto values = samples(count);
+            output_buffer out;
+            serialize_parallel<varint_format>(values, out, pool, 1000);
+            std::vector<sample> decoded{ { 1, 2, "stale" } };
+            deserialize_parallel<varint_format>(out.view(), decoded, pool);
+            EXPECT_EQ(decoded, values);
+        }
+        std::vector<std::uint32_t> numbers(100000);
+        for (std::size_t i = 0; i < numbers.size(); ++i) {
+            numbers[i] = static_cast<std::uint32_t>(i * 2654435761u);
+        }
+        output_buffer out;
+        serialize_parallel(numbers, out, pool, 4096);
+        std::vector<std::uint32_t> decoded;
+        deserialize_parallel(out.view(), decoded, pool);
+        EXPECT_EQ(decoded, numbers);
+    }
+
+    TEST(parallel, other_containers_round_trip_in_chunks) {
+        work_stealing_pool pool(3);
+        std::map<std::uint32_t, std::string> map;
+        std::set<std::int64_t> set;
+        std::deque<sample> deque;
+        for (std::uint32_t i = 0; i < 5000; ++i) {
+            map.emplace(i * 7, std::to_string(i));
+            set.insert(-static_cast<std::int64_t>(i) * 3);
+            deque.push_back({ i, 0.5, "d" });
+        }
+        output_buffer out;
+        serialize_parallel(map, out, pool, 300);
+        std::map<std::uint32_t, std::string> decoded_map;
+        deserialize_parallel(out.view(), decoded_map, pool);
+        EXPECT_EQ(decoded_map, map);
+
+        out.clear();
+        serialize_parallel<varint_format>(set, out, pool, 700);
+        std::set<std::int64_t> decoded_set{ 1 };
+        deserialize_parallel<varint_format>(out.view(), decoded_set, pool);
+        EXPECT_EQ(decoded_set, set);
+
+        out.clear();
+        serialize_parallel(deque, out, pool, 512);
+        std::deque<sample> decoded_deque;
+        deserialize_parallel(out.view(), decoded_deque, pool);
+        EXPECT_EQ(decoded_deque, deque);
+    }
+
+    TEST(parallel, damaged_chunk_index_throws) {
+        work_stealing_pool pool(2);
+        output_buffer out;
+        serialize_parallel(samples(500), out, pool, 100);
+        const auto bytes = std::vector<std::uint8_t>(out.view().begin(), out.view().end());
+        std::vector<sample> decoded;
+
+        auto truncated = bytes;
+        truncated.pop_back();
+        EXPECT_THROW(deserialize_parallel(truncated, decoded, pool), error);
+
+        auto trailing = bytes;
+        trailing.push_back(0);
+        EXPECT_THROW(deserialize_parallel(trailing, decoded, pool), error);
+
+        auto miscounted = bytes;
+        miscounted[0] = 0xff; // element count no longer matches the chunks
+        EXPECT_THROW(deserialize_parallel(miscounted, decoded, pool), error);
+    }
+
+}
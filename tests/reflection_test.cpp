@@ -0,0 +1,278 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::round_trip;
+
+    struct nested {
+        std::string name;
+        std::vector<std::int32_t> values;
+
+        bool operator==(const nested&) const = default;
+    };
+
+    struct outer {
+        std::uint8_t kind;
+        nested inner;
+        std::vector<nested> children;
+
+        bool operator==(const outer&) const = default;
+    };
+
+    struct widest {
+        std::string f0;
+        std::string f1;
+        std::string f2;
+        std::string f3;
+        std::string f4;
+        std::string f5;
+        std::string f6;
+        std::string f7;
+        std::string f8;
+        std::string f9;
+        std::string f10;
+        std::string f11;
+        std::string f12;
+        std::string f13;
+        std::string f14;
+        std::string f15;
+        std::string f16;
+        std::string f17;
+        std::string f18;
+        std::string f19;
+        std::string f20;
+        std::string f21;
+        std::string f22;
+        std::string f23;
+        std::string f24;
+        std::string f25;
+        std::string f26;
+        std::string f27;
+        std::string f28;
+        std::string f29;
+        std::string f30;
+        std::string f31;
+        std::string f32;
+        std::string f33;
+        std::string f34;
+        std::string f35;
+        std::string f36;
+        std::string f37;
+        std::string f38;
+        std::string f39;
+        std::string f40;
+        std::string f41;
+        std::string f42;
+        std::string f43;
+        std::string f44;
+        std::string f45;
+        std::string f46;
+        std::string f47;
+        std::string f48;
+        std::string f49;
+        std::string f50;
+        std::string f51;
+        std::string f52;
+        std::string f53;
+        std::string f54;
+        std::string f55;
+        std::string f56;
+        std::string f57;
+        std::string f58;
+        std::string f59;
+        std::string f60;
+        std::string f61;
+        std::string f62;
+        std::string f63;
+
+        bool operator==(const widest&) const = default;
+    };
+
+    struct too_wide {
+        std::uint16_t f0;
+        std::uint16_t f1;
+        std::uint16_t f2;
+        std::uint16_t f3;
+        std::uint16_t f4;
+        std::uint16_t f5;
+        std::uint16_t f6;
+        std::uint16_t f7;
+        std::uint16_t f8;
+        std::uint16_t f9;
+        std::uint16_t f10;
+        std::uint16_t f11;
+        std::uint16_t f12;
+        std::uint16_t f13;
+        std::uint16_t f14;
+        std::uint16_t f15;
+        std::uint16_t f16;
+        std::uint16_t f17;
+        std::uint16_t f18;
+        std::uint16_t f19;
+        std::uint16_t f20;
+        std::uint16_t f21;
+        std::uint16_t f22;
+        std::uint16_t f23;
+        std::uint16_t f24;
+        std::uint16_t f25;
+        std::uint16_t f26;
+        std::uint16_t f27;
+        std::uint16_t f28;
+        std::uint16_t f29;
+        std::uint16_t f30;
+        std::uint16_t f31;
+        std::uint16_t f32;
+        std::uint16_t f33;
+        std::uint16_t f34;
+        std::uint16_t f35;
+        std::uint16_t f36;
+        std::uint16_t f37;
+        std::uint16_t f38;
+        std::uint16_t f39;
+        std::uint16_t f40;
+        std::uint16_t f41;
+        std::uint16_t f42;
+        std::uint16_t f43;
+        std::uint16_t f44;
+        std::uint16_t f45;
+        std::uint16_t f46;
+        std::uint16_t f47;
+        std::uint16_t f48;
+        std::uint16_t f49;
+        std::uint16_t f50;
+        std::uint16_t f51;
+        std::uint16_t f52;
+        std::uint16_t f53;
+        std::uint16_t f54;
+        std::uint16_t f55;
+        std::uint16_t f56;
+        std::uint16_t f57;
+        std::uint16_t f58;
+        std::uint16_t f59;
+        std::uint16_t f60;
+        std::uint16_t f61;
+        std::uint16_t f62;
+        std::uint16_t f63;
+        std::uint16_t f64;
+    };
+
+    struct too_wide_listed {
+        HOPE_FIELDS(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17, f18, f19, f20, f21, f22, f23, f24, f25, f26, f27, f28, f29, f30, f31, f32, f33, f34, f35, f36, f37, f38, f39, f40, f41, f42, f43, f44, f45, f46, f47, f48, f49, f50, f51, f52, f53, f54, f55, f56, f57, f58, f59, f60, f61, f62, f63, f64)
+        std::uint16_t f0;
+        std::uint16_t f1;
+        std::uint16_t f2;
+        std::uint16_t f3;
+        std::uint16_t f4;
+        std::uint16_t f5;
+        std::uint16_t f6;
+        std::uint16_t f7;
+        std::uint16_t f8;
+        std::uint16_t f9;
+        std::uint16_t f10;
+        std::uint16_t f11;
+        std::uint16_t f12;
+        std::uint16_t f13;
+        std::uint16_t f14;
+        std::uint16_t f15;
+        std::uint16_t f16;
+        std::uint16_t f17;
+        std::uint16_t f18;
+        std::uint16_t f19;
+        std::uint16_t f20;
+        std::uint16_t f21;
+        std::uint16_t f22;
+        std::uint16_t f23;
+        std::uint16_t f24;
+        std::uint16_t f25;
+        std::uint16_t f26;
+        std::uint16_t f27;
+        std::uint16_t f28;
+        std::uint16_t f29;
+        std::uint16_t f30;
+        std::uint16_t f31;
+        std::uint16_t f32;
+        std::uint16_t f33;
+        std::uint16_t f34;
+        std::uint16_t f35;
+        std::uint16_t f36;
+        std::uint16_t f37;
+        std::uint16_t f38;
+        std::uint16_t f39;
+        std::uint16_t f40;
+        std::uint16_t f41;
+        std::uint16_t f42;
+        std::uint16_t f43;
+        std::uint16_t f44;
+        std::uint16_t f45;
+        std::uint16_t f46;
+        std::uint16_t f47;
+        std::uint16_t f48;
+        std::uint16_t f49;
+        std::uint16_t f50;
+        std::uint16_t f51;
+        std::uint16_t f52;
+        std::uint16_t f53;
+        std::uint16_t f54;
+        std::uint16_t f55;
+        std::uint16_t f56;
+        std::uint16_t f57;
+        std::uint16_t f58;
+        std::uint16_t f59;
+        std::uint16_t f60;
+        std::uint16_t f61;
+        std::uint16_t f62;
+        std::uint16_t f63;
+        std::uint16_t f64;
+
+        bool operator==(const too_wide_listed&) const = default;
+    };
+
+    struct buffer_record {
+        char text[100];
+        std::uint32_t length;
+    };
+
+    static_assert(detail::aggregate_arity<widest>() == 64);
+    static_assert(detail::aggregate_arity<too_wide>() == detail::max_aggregate_fields + 1);
+    static_assert(detail::field_count_v<outer> == 3);
+
+    TEST(reflection, nested_aggregates) {
+        const outer value{ 1, { "a", { 1, 2 } }, { { "b", {} }, { "c", { 3 } } } };
+        EXPECT_EQ(round_trip(value), value);
+        EXPECT_EQ(round_trip<varint_format>(value), value);
+    }
+
+    TEST(reflection, aggregates_up_to_the_limit) {
+        widest value{};
+        value.f0 = "first";
+        value.f63 = "last";
+        EXPECT_EQ(round_trip(value), value);
+    }
+
+    TEST(reflection, wider_records_list_their_fields) {
+        too_wide_listed value{};
+        value.f64 = 64;
+        EXPECT_EQ(round_trip<varint_format>(value), value);
+    }
+
+    TEST(reflection, bitwise_records_with_arrays_are_copied) {
+        buffer_record value{ "text", 4 };
+        const auto bytes = serialize(value);
+        EXPECT_EQ(bytes.size(), sizeof(buffer_record));
+        const auto decoded = deserialize<buffer_record>(bytes);
+        EXPECT_EQ(std::string(decoded.text), "text");
+        EXPECT_EQ(decoded.length, 4u);
+    }
+
+}
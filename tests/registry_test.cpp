@@ -0,0 +1,135 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/registry.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct login {
+        HOPE_MESSAGE_ID(1)
+        std::string user;
+    };
+
+    struct quote {
+        HOPE_MESSAGE_ID(7)
+        std::uint64_t instrument;
+        double price;
+    };
+
+    struct trade {
+        HOPE_MESSAGE_ID(3)
+        std::uint64_t instrument;
+        std::int64_t quantity;
+    };
+
+    struct heartbeat {
+        HOPE_MESSAGE_ID(100000)
+    };
+
+    struct audit {
+        HOPE_MESSAGE_ID(0xdeadbeef)
+        std::vector<std::string> lines;
+    };
+
+    /**
+     * A type that cannot be changed, registered from the outside.
+     */
+    struct legacy {
+        std::int32_t code;
+    };
+
+    template <typename... Handlers>
+    struct overloaded : Handlers... {
+        using Handlers::operator()...;
+    };
+
+    template <typename... Handlers>
+    overloaded(Handlers...) -> overloaded<Handlers...>;
+
+}
+
+template <>
+struct hope::serialization::message_id<legacy> {
+    static constexpr std::uint32_t value = 12;
+};
+
+namespace {
+
+    using namespace hope::serialization;
+
+    using dense = message_registry<varint_format, login, quote, trade, legacy>;
+    using sparse = message_registry<varint_format, login, heartbeat, audit, quote>;
+
+    static_assert(dense::registered<quote>);
+    static_assert(!dense::registered<audit>);
+    static_assert(dense::index_of(7) == 1);
+    static_assert(dense::index_of(12) == 3);
+    static_assert(dense::index_of(2) == dense::npos);
+    static_assert(sparse::index_of(0xdeadbeef) == 2);
+    static_assert(sparse::index_of(100000) == 1);
+    static_assert(!sparse::contains(3));
+
+    template <typename Registry>
+    std::vector<std::string> receive(std::span<const std::uint8_t> bytes) {
+        std::vector<std::string> seen;
+        input_buffer input(bytes);
+        while (input.remaining() != 0) {
+            seen.push_back(Registry::dispatch(input,
+                overloaded{
+                    [](login&& m) { return "login " + m.user; },
+                    [](quote&& m) { return "quote " + std::to_string(m.instrument) + " " + std::to_string(m.price); },
+                    [](trade&& m) { return "trade " + std::to_string(m.quantity); },
+                    [](legacy&& m) { return "legacy " + std::to_string(m.code); },
+                    [](heartbeat&&) { return std::string("heartbeat"); },
+                    [](audit&& m) { return "audit " + std::to_string(m.lines.size()); },
+                }));
+        }
+        return seen;
+    }
+
+    TEST(registry, dense_ids_dispatch_to_their_types) {
+        output_buffer out;
+        dense::write(out, quote{ 42, 1.5 });
+        dense::write(out, login{ "ann" });
+        dense::write(out, legacy{ -3 });
+        dense::write(out, trade{ 42, -10 });
+        EXPECT_EQ(receive<dense>(out.view()),
+            (std::vector<std::string>{ "quote 42 1.500000", "login ann", "legacy -3", "trade -10" }));
+    }
+
+    TEST(registry, sparse_ids_dispatch_through_the_hash) {
+        output_buffer out;
+        sparse::write(out, audit{ { "a", "b" } });
+        sparse::write(out, heartbeat{});
+        sparse::write(out, login{ "bob" });
+        EXPECT_EQ(receive<sparse>(out.view()), (std::vector<std::string>{ "audit 2", "heartbeat", "login bob" }));
+        for (std::uint32_t id = 0; id < 5000; ++id) {
+            EXPECT_EQ(sparse::contains(id), id == 1 || id == 7);
+        }
+    }
+
+    TEST(registry, messages_start_with_their_varint_id) {
+        output_buffer out;
+        sparse::write(out, heartbeat{});
+        ASSERT_GE(out.size(), 3u);
+        EXPECT_EQ(std::vector<std::uint8_t>(out.data(), out.data() + 3), test::bytes_of({ 0xa0, 0x8d, 0x06 }));
+    }
+
+    TEST(registry, unknown_ids_throw) {
+        output_buffer out;
+        sparse::write(out, audit{ {} });
+        input_buffer input(out.view());
+        EXPECT_THROW((void)dense::dispatch(input, [](auto&&) {}), error);
+    }
+
+}
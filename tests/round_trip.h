@@ -0,0 +1,33 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#pragma once
+
+#include "hope/serialization/serialization.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace hope::serialization::test {
+
+    /**
+     * Encodes value, checks serialized_size against the encoding and decodes it again.
+     */
+    template <format Format = format{}, typename T>
+    [[nodiscard]] T round_trip(const T& value) {
+        const auto bytes = serialize<Format>(value);
+        EXPECT_EQ(bytes.size(), serialized_size<Format>(value));
+        return deserialize<T, Format>(bytes);
+    }
+
+    [[nodiscard]] inline std::vector<std::uint8_t> bytes_of(std::initializer_list<int> values) {
+        std::vector<std::uint8_t> bytes;
+        for (const int value : values) {
+            bytes.push_back(static_cast<std::uint8_t>(value));
+        }
+        return bytes;
+    }
+
+}
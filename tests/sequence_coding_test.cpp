@@ -0,0 +1,101 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/sequence_coding.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::round_trip;
+
+    struct telemetry {
+        delta_of_delta<std::vector<std::uint64_t>> timestamps;
+        delta<std::vector<std::uint32_t>> sequence_numbers;
+        frame_of_reference<std::vector<std::int16_t>> temperatures;
+        std::string source;
+
+        bool operator==(const telemetry&) const = default;
+    };
+
+    template <typename T>
+    std::vector<T> pattern(std::size_t count, T start, T step) {
+        std::vector<T> values;
+        T value = start;
+        for (std::size_t i = 0; i < count; ++i) {
+            values.push_back(value);
+            value = static_cast<T>(value + step + static_cast<T>(i % 5 == 0 ? 1 : 0));
+        }
+        return values;
+    }
+
+    template <sequence_coding Coding, typename T>
+    void expect_round_trip(const std::vector<T>& values) {
+        const coded_sequence<std::vector<T>, Coding> coded(values);
+        EXPECT_EQ(static_cast<const std::vector<T>&>(round_trip(coded)), values);
+        EXPECT_EQ(static_cast<const std::vector<T>&>(round_trip<varint_format>(coded)), values);
+    }
+
+    template <typename T>
+    void expect_all_codings(const std::vector<T>& values) {
+        expect_round_trip<sequence_coding::delta>(values);
+        expect_round_trip<sequence_coding::delta_of_delta>(values);
+        expect_round_trip<sequence_coding::frame_of_reference>(values);
+    }
+
+    TEST(sequence_coding, round_trip_across_blocks) {
+        for (const std::size_t count : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 2 }, std::size_t{ 127 },
+                 std::size_t{ 129 }, std::size_t{ 1000 } }) {
+            expect_all_codings(pattern<std::uint64_t>(count, 1700000000000, 1000));
+            expect_all_codings(pattern<std::int32_t>(count, -500, 3));
+            expect_all_codings(pattern<std::uint8_t>(count, 250, 7)); // wraps around
+            expect_all_codings(pattern<std::int16_t>(count, 0, -11));
+        }
+    }
+
+    TEST(sequence_coding, extreme_values) {
+        constexpr auto low = std::numeric_limits<std::int64_t>::min();
+        constexpr auto high = std::numeric_limits<std::int64_t>::max();
+        expect_all_codings(std::vector<std::int64_t>{ low, high, low, 0, high, -1, 1 });
+        expect_all_codings(std::vector<std::uint64_t>{ 0, ~std::uint64_t{ 0 }, 1, ~std::uint64_t{ 0 } - 1 });
+        expect_all_codings(std::vector<std::uint32_t>(300, 0xffffffff));
+    }
+
+    TEST(sequence_coding, steady_sequences_cost_a_few_bits) {
+        const delta_of_delta<std::vector<std::uint64_t>> timestamps(pattern<std::uint64_t>(1024, 1700000000000, 1000));
+        EXPECT_LT(serialize(timestamps).size(), 1024 / 2);
+        const delta<std::vector<std::uint32_t>> ids(pattern<std::uint32_t>(1024, 100, 1));
+        EXPECT_LT(serialize(ids).size(), 1024 / 2);
+        std::vector<std::int16_t> clustered(1024);
+        for (std::size_t i = 0; i < clustered.size(); ++i) {
+            clustered[i] = static_cast<std::int16_t>(2000 + (i * 37) % 16);
+        }
+        EXPECT_LT(serialize(frame_of_reference<std::vector<std::int16_t>>(clustered)).size(), clustered.size());
+    }
+
+    TEST(sequence_coding, coded_fields_of_records) {
+        const telemetry value{ pattern<std::uint64_t>(300, 5, 10), pattern<std::uint32_t>(300, 0, 1),
+            pattern<std::int16_t>(300, -40, 0), "probe" };
+        EXPECT_EQ(round_trip(value), value);
+        EXPECT_EQ(round_trip<varint_format>(value), value);
+        EXPECT_EQ(round_trip<tagged_format>(value), value);
+    }
+
+    TEST(sequence_coding, malformed_input_throws) {
+        auto bytes = serialize(delta<std::vector<std::uint32_t>>(pattern<std::uint32_t>(500, 0, 3)));
+        bytes.resize(bytes.size() / 2);
+        EXPECT_THROW((void)deserialize<delta<std::vector<std::uint32_t>>>(bytes), error);
+        const auto hostile = serialize(std::uint64_t{ 1 } << 40);
+        EXPECT_THROW((void)deserialize<delta<std::vector<std::uint32_t>>>(hostile), error);
+    }
+
+}
@@ -0,0 +1,167 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/session.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::round_trip;
+
+    struct venue {
+        std::string name;
+        std::int32_t lane;
+
+        bool operator==(const venue&) const = default;
+    };
+
+    struct order_v1 {
+        std::uint64_t id;
+        std::string symbol;
+        std::int32_t quantity;
+
+        bool operator==(const order_v1&) const = default;
+    };
+
+    struct order_v2 {
+        std::uint64_t id;
+        std::string symbol;
+        std::int32_t quantity;
+        std::optional<double> limit;
+        std::vector<venue> venues;
+
+        bool operator==(const order_v2&) const = default;
+    };
+
+    struct order_v3 {
+        HOPE_FIELD_IDS(1, 2, 4, 5) // quantity was retired
+        std::uint64_t id;
+        std::string symbol;
+        std::optional<double> limit;
+        std::vector<venue> venues;
+
+        bool operator==(const order_v3&) const = default;
+    };
+
+    struct order_retyped {
+        std::uint64_t id;
+        std::string symbol;
+        std::string quantity;
+    };
+
+    const order_v2 sample{ 42, "ABC", 100, 9.5, { { "X", 1 }, { "Y", 2 } } };
+
+    TEST(tagged, round_trip) {
+        EXPECT_EQ(round_trip<tagged_format>(sample), sample);
+        constexpr format fixed_tagged{ .layout = struct_layout::tagged };
+        EXPECT_EQ(round_trip<fixed_tagged>(sample), sample);
+        EXPECT_EQ(round_trip<tagged_format>(order_v2{}), order_v2{});
+    }
+
+    TEST(tagged, readers_skip_fields_they_do_not_know) {
+        const auto bytes = serialize<tagged_format>(sample);
+        EXPECT_EQ((deserialize<order_v1, tagged_format>(bytes)), (order_v1{ 42, "ABC", 100 }));
+    }
+
+    TEST(tagged, missing_fields_are_reset) {
+        const auto bytes = serialize<tagged_format>(order_v1{ 7, "Z", 3 });
+        order_v2 target = sample;
+        input_buffer input(bytes);
+        reader<input_buffer, tagged_format>(input).read(target);
+        EXPECT_EQ(target, (order_v2{ 7, "Z", 3, std::nullopt, {} }));
+    }
+
+    TEST(tagged, retired_ids_stay_unused) {
+        const auto bytes = serialize<tagged_format>(sample);
+        const auto v3 = deserialize<order_v3, tagged_format>(bytes);
+        EXPECT_EQ(v3, (order_v3{ 42, "ABC", 9.5, sample.venues }));
+        const auto back = deserialize<order_v2, tagged_format>(serialize<tagged_format>(v3));
+        EXPECT_EQ(back, (order_v2{ 42, "ABC", 0, 9.5, sample.venues }));
+    }
+
+    TEST(tagged, empty_optionals_are_left_out) {
+        order_v2 without = sample;
+        without.limit.reset();
+        const auto with_size = serialize<tagged_format>(sample).size();
+        const auto without_size = serialize<tagged_format>(without).size();
+        EXPECT_EQ(with_size - without_size, 1 + sizeof(double)); // key and value
+        EXPECT_EQ(serialized_size<tagged_format>(without), without_size);
+    }
+
+    TEST(tagged, changed_wire_type_throws) {
+        const auto bytes = serialize<tagged_format>(sample);
+        EXPECT_THROW((void)(deserialize<order_retyped, tagged_format>(bytes)), error);
+    }
+
+    TEST(tagged, truncated_input_throws) {
+        auto bytes = serialize<tagged_format>(sample);
+        bytes.pop_back(); // the closing key
+        EXPECT_THROW((void)(deserialize<order_v2, tagged_format>(bytes)), error);
+    }
+
+    /**
+     * Exchanges hellos between two in-memory peers.
+     */
+    std::pair<session<>, session<>> connect(std::uint64_t first_version, std::uint64_t second_version) {
+        output_buffer first_out;
+        output_buffer second_out;
+        send_hello(first_out, first_version);
+        send_hello(second_out, second_version);
+        input_buffer first_in(second_out.view());
+        input_buffer second_in(first_out.view());
+        return { session<>(first_version, receive_hello(first_in)), session<>(second_version, receive_hello(second_in)) };
+    }
+
+    TEST(session, matching_versions_use_the_frozen_layout) {
+        const auto [first, second] = connect(3, 3);
+        EXPECT_EQ(first.layout(), struct_layout::frozen);
+        EXPECT_EQ(second.layout(), struct_layout::frozen);
+        output_buffer wire;
+        first.write(wire, sample);
+        EXPECT_EQ(wire.size(), serialized_size<varint_format>(sample));
+        order_v2 received;
+        input_buffer input(wire.view());
+        second.read(input, received);
+        EXPECT_EQ(received, sample);
+    }
+
+    TEST(session, different_versions_use_the_tagged_layout) {
+        const auto [first, second] = connect(3, 4);
+        EXPECT_EQ(first.layout(), struct_layout::tagged);
+        EXPECT_EQ(second.layout(), struct_layout::tagged);
+        output_buffer wire;
+        first.write(wire, sample);
+        order_v1 received;
+        input_buffer input(wire.view());
+        second.read(input, received);
+        EXPECT_EQ(received, (order_v1{ 42, "ABC", 100 }));
+    }
+
+    TEST(session, handshake) {
+        output_buffer peer;
+        send_hello(peer, 9);
+        input_buffer input(peer.view());
+        output_buffer out;
+        const auto agreed = handshake(out, input, 9);
+        EXPECT_EQ(agreed.layout(), struct_layout::frozen);
+        input_buffer sent(out.view());
+        EXPECT_EQ(receive_hello(sent), 9u);
+    }
+
+    TEST(session, garbage_hello_throws) {
+        const auto bytes = test::bytes_of({ 'N', 'O', 'P', 'E', 1, 0, 0, 0, 0, 0, 0, 0, 0 });
+        input_buffer input(bytes);
+        EXPECT_THROW((void)receive_hello(input), error);
+    }
+
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::bytes_of;
+
+    struct position {
+        std::int32_t x;
+        std::int32_t y;
+
+        bool operator==(const position&) const = default;
+    };
+
+    struct message {
+        std::uint64_t id;
+        std::string name;
+        std::vector<std::int64_t> values;
+        std::optional<position> at;
+        std::map<std::string, std::vector<std::uint32_t>> groups;
+        bool active;
+
+        bool operator==(const message&) const = default;
+    };
+
+    message sample() {
+        std::vector<std::int64_t> values;
+        for (std::int64_t i = -300; i < 300; i += 7) {
+            values.push_back(i * i * (i % 2 == 0 ? 1 : -1000));
+        }
+        return { 1234567, "validated", values, position{ -5, 70000 },
+            { { "a", { 1, 200, 70000 } }, { "", {} }, { "c", std::vector<std::uint32_t>(40, 127) } }, true };
+    }
+
+    template <format Format>
+    void expect_validated_round_trip(const message& value) {
+        const auto bytes = serialize<Format>(value);
+        EXPECT_NO_THROW((validate<message, Format>(bytes)));
+        EXPECT_EQ((deserialize_unchecked<message, Format>(bytes)), value);
+        message decoded{};
+        deserialize_unchecked<Format>(bytes, decoded);
+        EXPECT_EQ(decoded, value);
+    }
+
+    template <format Format>
+    void expect_truncations_rejected(const message& value) {
+        const auto bytes = serialize<Format>(value);
+        for (std::size_t size = 0; size < bytes.size(); ++size) {
+            EXPECT_THROW((validate<message, Format>(std::span(bytes).first(size))), error) << "prefix of " << size << " bytes";
+        }
+    }
+
+    TEST(validate, accepted_input_decodes_unchecked) {
+        expect_validated_round_trip<format{}>(sample());
+        expect_validated_round_trip<varint_format>(sample());
+        expect_validated_round_trip<packed_format>(sample());
+        expect_validated_round_trip<tagged_format>(sample());
+        expect_validated_round_trip<varint_format>(message{});
+    }
+
+    TEST(validate, every_truncation_is_rejected) {
+        expect_truncations_rejected<format{}>(sample());
+        expect_truncations_rejected<varint_format>(sample());
+        expect_truncations_rejected<tagged_format>(sample());
+    }
+
+    TEST(validate, malformed_input_is_rejected) {
+        // a length prefix far beyond the input
+        auto bytes = serialize<varint_format>(std::string("abc"));
+        bytes[0] = 0x7f;
+        EXPECT_THROW((validate<std::string, varint_format>(bytes)), error);
+        // a varint longer than any 64 bit value
+        EXPECT_THROW((validate<std::uint64_t, varint_format>(bytes_of({ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01 }))), error);
+        // an element count no input of this size could hold
+        EXPECT_THROW((validate<std::vector<std::uint64_t>, varint_format>(bytes_of({ 0xff, 0xff, 0x03, 1, 2, 3 }))), error);
+    }
+
+    TEST(validate, skip_varints_matches_decoding) {
+        std::vector<std::uint64_t> values;
+        for (std::uint64_t i = 0; i < 1000; ++i) {
+            values.push_back(i % 37 == 0 ? std::numeric_limits<std::uint64_t>::max() >> (i % 64) : i % 100);
+        }
+        const auto bytes = serialize<varint_format>(values);
+        const auto* data = bytes.data() + 2; // the element count takes two bytes
+        const auto* end = bytes.data() + bytes.size();
+        EXPECT_EQ(skip_varints<std::uint64_t>(data, end, values.size()), bytes.size() - 2);
+        EXPECT_EQ(skip_varints<std::uint64_t>(data, end - 1, values.size()), 0u);
+        EXPECT_EQ(skip_varints<std::uint64_t>(data, end, 0), 0u);
+        for (const std::size_t count : { std::size_t{ 1 }, std::size_t{ 15 }, std::size_t{ 16 }, std::size_t{ 17 }, std::size_t{ 500 } }) {
+            std::size_t expected = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                expected += serialize<varint_format>(values[i]).size();
+            }
+            EXPECT_EQ(skip_varints<std::uint64_t>(data, end, count), expected);
+        }
+        const auto overlong = bytes_of({ 1, 2, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 });
+        EXPECT_EQ(skip_varints<std::uint64_t>(overlong.data(), overlong.data() + overlong.size(), 3), 0u);
+        EXPECT_EQ(skip_varints<std::uint64_t>(overlong.data(), overlong.data() + overlong.size(), 2), 2u);
+    }
+
+}
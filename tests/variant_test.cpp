@@ -0,0 +1,219 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/incremental_reader.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace {
+
+    struct circle;
+    struct square;
+    struct label;
+
+    struct shape {
+        HOPE_SUBTYPES(circle, square, label)
+        virtual ~shape() = default;
+        std::uint32_t color{};
+    };
+
+    struct circle : shape {
+        HOPE_SUBTYPE()
+        HOPE_FIELDS(color, radius)
+        double radius{};
+    };
+
+    struct square : shape {
+        HOPE_SUBTYPE()
+        HOPE_FIELDS(color, side, corners)
+        double side{};
+        std::vector<std::int32_t> corners;
+    };
+
+    struct label : shape {
+        HOPE_SUBTYPE()
+        HOPE_FIELDS(color, text)
+        std::string text;
+    };
+
+    /**
+     * One distinct alternative per index, to build variants with many choices.
+     */
+    template <std::size_t I>
+    struct choice {
+        std::uint8_t value;
+
+        bool operator==(const choice&) const = default;
+    };
+
+    template <std::size_t... I>
+    std::variant<choice<I>...> make_wide(std::index_sequence<I...>);
+
+    using wide = decltype(make_wide(std::make_index_sequence<300>{}));
+
+    using namespace hope::serialization;
+    using test::bytes_of;
+    using test::round_trip;
+
+    using event = std::variant<std::monostate, std::int64_t, std::string, std::vector<std::uint16_t>>;
+
+    struct envelope {
+        std::uint32_t id;
+        event payload;
+
+        bool operator==(const envelope&) const = default;
+    };
+
+    std::string describe(const shape* value) {
+        if (value == nullptr) {
+            return "null";
+        }
+        switch (value->hope_subtype()) {
+        case 0:
+            return "circle " + std::to_string(value->color) + " " + std::to_string(static_cast<const circle*>(value)->radius);
+        case 1:
+            return "square " + std::to_string(value->color) + " " + std::to_string(static_cast<const square*>(value)->corners.size());
+        default:
+            return "label " + std::to_string(value->color) + " " + static_cast<const label*>(value)->text;
+        }
+    }
+
+    template <typename Pointers>
+    std::vector<std::string> describe_all(const Pointers& values) {
+        std::vector<std::string> described;
+        for (const auto& value : values) {
+            described.push_back(describe(value.get()));
+        }
+        return described;
+    }
+
+    std::vector<std::unique_ptr<shape>> drawing() {
+        std::vector<std::unique_ptr<shape>> shapes;
+        auto round = std::make_unique<circle>();
+        round->color = 1;
+        round->radius = 2.5;
+        shapes.push_back(std::move(round));
+        shapes.push_back(nullptr);
+        auto box = std::make_unique<square>();
+        box->color = 2;
+        box->corners = { 1, -1, 1, -1 };
+        shapes.push_back(std::move(box));
+        auto text = std::make_unique<label>();
+        text->color = 3;
+        text->text = "north";
+        shapes.push_back(std::move(text));
+        return shapes;
+    }
+
+    TEST(variant, alternatives_round_trip) {
+        for (const event& value : { event{}, event{ std::int64_t{ -7 } }, event{ std::string("text") },
+                 event{ std::vector<std::uint16_t>{ 1, 2, 3 } } }) {
+            EXPECT_EQ(round_trip(value), value);
+            EXPECT_EQ(round_trip<varint_format>(value), value);
+            const envelope wrapped{ 5, value };
+            EXPECT_EQ(round_trip<tagged_format>(wrapped), wrapped);
+            EXPECT_EQ(round_trip<packed_format>(wrapped), wrapped);
+        }
+    }
+
+    TEST(variant, tags_are_compact) {
+        EXPECT_EQ(serialize(event{ std::string("ab") })[0], 2);
+        EXPECT_EQ(serialize(event{ std::int64_t{ 1 } }).size(), 1 + sizeof(std::int64_t));
+        EXPECT_EQ(serialize(wide{ choice<0>{ 9 } }).size(), 3u);
+        EXPECT_EQ(serialize<varint_format>(wide{ choice<5>{ 9 } }).size(), 2u);
+        EXPECT_EQ(serialize<varint_format>(wide{ choice<299>{ 9 } }).size(), 3u);
+        const wide last{ std::in_place_index<299>, choice<299>{ 42 } };
+        EXPECT_EQ(round_trip(last), last);
+        EXPECT_EQ(round_trip<varint_format>(last), last);
+    }
+
+    TEST(variant, held_alternative_is_decoded_in_place) {
+        const auto bytes = serialize(event{ std::vector<std::uint16_t>{ 4, 5 } });
+        event target{ std::vector<std::uint16_t>(100, 0) };
+        const auto* storage = std::get<3>(target).data();
+        deserialize(bytes, target);
+        EXPECT_EQ(std::get<3>(target), (std::vector<std::uint16_t>{ 4, 5 }));
+        EXPECT_EQ(std::get<3>(target).data(), storage);
+        deserialize(serialize(event{ std::int64_t{ 3 } }), target);
+        EXPECT_EQ(target, event{ std::int64_t{ 3 } });
+    }
+
+    TEST(variant, unknown_tags_throw) {
+        EXPECT_THROW((void)deserialize<event>(bytes_of({ 4 })), error);
+        EXPECT_THROW((validate<event>(bytes_of({ 4 }))), error);
+        EXPECT_THROW((void)deserialize<std::unique_ptr<shape>>(bytes_of({ 4 })), error);
+        EXPECT_THROW((void)(deserialize<wide, varint_format>(bytes_of({ 0xac, 0x02, 0 }))), error);
+    }
+
+    TEST(variant, class_hierarchies_round_trip) {
+        const auto shapes = drawing();
+        const auto expected = describe_all(shapes);
+        EXPECT_EQ(describe_all(round_trip(shapes)), expected);
+        EXPECT_EQ(describe_all(round_trip<varint_format>(shapes)), expected);
+        EXPECT_EQ(describe_all(round_trip<tagged_format>(shapes)), expected);
+
+        std::vector<std::shared_ptr<shape>> shared;
+        for (auto& value : drawing()) {
+            shared.emplace_back(std::move(value));
+        }
+        EXPECT_EQ(describe_all(round_trip(shared)), expected);
+        EXPECT_NO_THROW(validate<std::vector<std::unique_ptr<shape>>>(serialize(shapes)));
+    }
+
+    TEST(variant, null_and_subtype_tags) {
+        EXPECT_EQ(serialize(std::unique_ptr<shape>{}), bytes_of({ 0 }));
+        EXPECT_EQ(serialize(std::unique_ptr<shape>{ std::make_unique<label>() })[0], 3);
+        auto target = deserialize<std::unique_ptr<shape>>(serialize(std::unique_ptr<shape>{}));
+        EXPECT_EQ(target, nullptr);
+    }
+
+    TEST(variant, owned_object_of_the_same_class_is_decoded_in_place) {
+        auto text = std::make_unique<label>();
+        text->text = "replaced";
+        const auto bytes = serialize(std::unique_ptr<shape>(std::move(text)));
+
+        std::unique_ptr<shape> target = std::make_unique<label>();
+        const shape* object = target.get();
+        deserialize(bytes, target);
+        EXPECT_EQ(target.get(), object);
+        EXPECT_EQ(describe(target.get()), "label 0 replaced");
+
+        target = std::make_unique<circle>();
+        deserialize(bytes, target);
+        EXPECT_EQ(describe(target.get()), "label 0 replaced");
+    }
+
+    TEST(variant, incremental_reader_matches) {
+        const envelope value{ 77, std::vector<std::uint16_t>(300, 9) };
+        const auto bytes = serialize<varint_format>(value);
+        envelope decoded{};
+        incremental_reader<envelope, varint_format> decoder(decoded);
+        for (const auto byte : bytes) {
+            (void)decoder.feed(std::span(&byte, 1));
+        }
+        ASSERT_TRUE(decoder.done());
+        EXPECT_EQ(decoded, value);
+
+        const auto shapes = drawing();
+        const auto shape_bytes = serialize(shapes);
+        std::vector<std::unique_ptr<shape>> decoded_shapes;
+        incremental_reader<std::vector<std::unique_ptr<shape>>> shape_decoder(decoded_shapes);
+        for (const auto byte : shape_bytes) {
+            (void)shape_decoder.feed(std::span(&byte, 1));
+        }
+        ASSERT_TRUE(shape_decoder.done());
+        EXPECT_EQ(describe_all(decoded_shapes), describe_all(shapes));
+    }
+
+}
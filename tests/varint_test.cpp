@@ -0,0 +1,75 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+    using test::bytes_of;
+    using test::round_trip;
+
+    enum class side : std::uint32_t { buy = 1, sell = 300 };
+
+    struct quote {
+        std::uint64_t id;
+        std::int32_t price;
+        side direction;
+        std::optional<std::uint64_t> parent;
+
+        bool operator==(const quote&) const = default;
+    };
+
+    TEST(varint, integers_are_leb128_and_zigzag) {
+        EXPECT_EQ(serialize<varint_format>(std::uint32_t{ 1 }), bytes_of({ 1 }));
+        EXPECT_EQ(serialize<varint_format>(std::uint32_t{ 300 }), bytes_of({ 0xac, 0x02 }));
+        EXPECT_EQ(serialize<varint_format>(std::int32_t{ -1 }), bytes_of({ 1 }));
+        EXPECT_EQ(serialize<varint_format>(std::int32_t{ 1 }), bytes_of({ 2 }));
+        EXPECT_EQ(serialize<varint_format>(side::sell), bytes_of({ 0xac, 0x02 }));
+        EXPECT_EQ(serialize<varint_format>(std::numeric_limits<std::uint64_t>::max()).size(), max_varint_size);
+        EXPECT_EQ(round_trip<varint_format>(std::numeric_limits<std::int64_t>::min()), std::numeric_limits<std::int64_t>::min());
+        EXPECT_EQ(round_trip<varint_format>(std::numeric_limits<std::uint64_t>::max()), std::numeric_limits<std::uint64_t>::max());
+    }
+
+    TEST(varint, optionals_are_a_flag_and_a_varint) {
+        EXPECT_EQ(serialize<varint_format>(std::optional<std::uint64_t>(5)), bytes_of({ 1, 5 }));
+        EXPECT_EQ(serialize<varint_format>(std::optional<std::uint64_t>()), bytes_of({ 0 }));
+        EXPECT_EQ(serialized_size<varint_format>(std::optional<std::uint64_t>(300)), 3u);
+        const quote value{ 7, -3, side::buy, 6 };
+        EXPECT_EQ(serialize<varint_format>(value).size(), 5u);
+        EXPECT_EQ(round_trip<varint_format>(value), value);
+    }
+
+    TEST(varint, stream_vbyte_blocks_round_trip) {
+        for (const std::size_t size : { 0, 1, 3, 63, 64, 65, 1000 }) {
+            std::vector<std::uint32_t> values(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                values[i] = static_cast<std::uint32_t>(i * i * 7919 >> (i % 24));
+            }
+            EXPECT_EQ(round_trip<varint_format>(values), values);
+            std::vector<std::int32_t> signed_values(values.begin(), values.end());
+            for (std::size_t i = 0; i < size; i += 2) {
+                signed_values[i] = -signed_values[i];
+            }
+            EXPECT_EQ(round_trip<varint_format>(signed_values), signed_values);
+        }
+        // small values take about a byte and a quarter each
+        EXPECT_LT(serialize<varint_format>(std::vector<std::uint32_t>(1000, 5)).size(), 1300u);
+    }
+
+    TEST(varint, malformed_varints_throw) {
+        EXPECT_THROW((void)(deserialize<std::uint32_t, varint_format>(bytes_of({ 0x80, 0x80 }))), error);
+        const auto overlong = bytes_of({ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f });
+        EXPECT_THROW((void)(deserialize<std::uint64_t, varint_format>(overlong)), error);
+    }
+
+}
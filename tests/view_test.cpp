@@ -0,0 +1,89 @@
+/* Copyright (c) 2024 Gleb Bezborodov
+ * Distributed under the MIT license, see LICENSE for details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "round_trip.h"
+
+#include "hope/serialization/view.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+    using namespace hope::serialization;
+
+    struct order {
+        std::uint64_t id;
+        std::string symbol;
+        std::vector<std::uint8_t> payload;
+        std::vector<double> prices;
+    };
+
+    struct order_view {
+        std::uint64_t id;
+        std::string_view symbol;
+        std::span<const std::uint8_t> payload;
+        array_view<double> prices;
+    };
+
+    const order sample{ 7, "ABCD", { 1, 2, 3 }, { 1.5, -2.25, 1e10 } };
+
+    bool inside(const void* pointer, std::span<const std::uint8_t> bytes) {
+        const auto* byte = static_cast<const std::uint8_t*>(pointer);
+        return byte >= bytes.data() && byte < bytes.data() + bytes.size();
+    }
+
+    TEST(view, views_point_into_the_input) {
+        const auto bytes = serialize(sample);
+        const auto view = deserialize<order_view>(bytes);
+        EXPECT_EQ(view.id, 7u);
+        EXPECT_EQ(view.symbol, "ABCD");
+        EXPECT_TRUE(inside(view.symbol.data(), bytes));
+        EXPECT_EQ(std::vector<std::uint8_t>(view.payload.begin(), view.payload.end()), sample.payload);
+        EXPECT_TRUE(inside(view.payload.data(), bytes));
+        ASSERT_EQ(view.prices.size(), 3u);
+        EXPECT_EQ(view.prices[1], -2.25);
+        EXPECT_EQ(view.prices.back(), 1e10);
+        EXPECT_EQ(view.prices.to_vector(), sample.prices);
+        EXPECT_TRUE(inside(view.prices.bytes().data(), bytes));
+    }
+
+    TEST(view, views_and_owning_types_share_the_encoding) {
+        const auto bytes = serialize(sample);
+        const auto view = deserialize<order_view>(bytes);
+        EXPECT_EQ(serialize(view), bytes);
+        EXPECT_EQ(serialized_size(view), bytes.size());
+        const auto varint = serialize<varint_format>(sample);
+        EXPECT_EQ((deserialize<order_view, varint_format>(varint).symbol), "ABCD");
+    }
+
+    TEST(view, array_view_needs_no_alignment) {
+        // one leading byte puts the doubles off their alignment
+        const auto bytes = serialize(std::make_tuple(std::uint8_t{ 1 }, std::vector<double>{ 0.5, 4.0 }));
+        const auto [flag, values] = deserialize<std::tuple<std::uint8_t, array_view<double>>>(bytes);
+        EXPECT_EQ(flag, 1);
+        EXPECT_EQ(values.to_vector(), (std::vector<double>{ 0.5, 4.0 }));
+        std::vector<double> total;
+        for (const double value : values) {
+            total.push_back(value);
+        }
+        EXPECT_EQ(total, (std::vector<double>{ 0.5, 4.0 }));
+        if (reinterpret_cast<std::uintptr_t>(values.bytes().data()) % alignof(double) != 0) {
+            EXPECT_THROW((void)values.aligned_span(), error);
+            EXPECT_THROW((void)(deserialize<std::tuple<std::uint8_t, std::span<const double>>>(bytes)), error);
+        }
+    }
+
+    TEST(view, truncated_input_throws) {
+        auto bytes = serialize(sample);
+        bytes.resize(bytes.size() - 1);
+        EXPECT_THROW((void)deserialize<order_view>(bytes), error);
+    }
+
+}